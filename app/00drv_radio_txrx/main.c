@@ -32,6 +32,8 @@ mr_gpio_t pin3 = { .port = 1, .pin = 5 };
 
 //=========================== defines =========================================
 
+#define TXRX_CHANNEL (MARI_N_BLE_REGULAR_CHANNELS)  // first advertising channel, where beacons are sent
+
 typedef struct {
     uint64_t asn;
 } txrx_vars_t;
@@ -40,7 +42,7 @@ typedef struct {
 
 txrx_vars_t txrx_vars = { 0 };
 
-extern schedule_t schedule_only_beacons, schedule_huge;
+extern const schedule_t schedule_only_beacons, schedule_huge;
 
 //=========================== prototypes ======================================
 
@@ -58,9 +60,9 @@ int main(void) {
     mr_gpio_init(&pin1, MR_GPIO_OUT);
 
     mr_radio_init(&isr_radio_start_frame, &isr_radio_end_frame, MR_RADIO_BLE_2MBit);
-    mr_radio_set_channel(MARI_FIXED_SCAN_CHANNEL);
+    mr_radio_set_channel(TXRX_CHANNEL);
 
-    printf("MARI_FIXED_SCAN_CHANNEL = %d\n", MARI_FIXED_SCAN_CHANNEL);
+    printf("TXRX_CHANNEL = %d\n", TXRX_CHANNEL);
 
     mr_timer_hf_set_periodic_us(MARI_TIMER_DEV, 0, 5000, send_beacon_prepare);  // 5 ms
 
@@ -0,0 +1,97 @@
+#ifndef __BASELINE_H
+#define __BASELINE_H
+
+/**
+ * @ingroup     app_bench
+ * @brief       Reference cycle counts of the mari hot paths
+ *
+ * Median number of cycles per call, with the measurement overhead removed,
+ * as printed by the benchmark with `-b` on the host, or when built with
+ * BENCH_PRINT_BASELINE on the target. The "reference" entry is the reference
+ * kernel the other entries are scaled to. Update an entry only when a slowdown
+ * is expected, and say why in the commit message.
+ *
+ * @{
+ * @file
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+
+//=========================== defines ==========================================
+
+#define BENCH_ALL_SCHEDULES (0)  ///< The code does not depend on the schedule
+
+typedef struct {
+    const char *name;
+    uint8_t     schedule_id;  ///< Id of the active schedule, or BENCH_ALL_SCHEDULES
+    uint32_t    cycles;
+} bench_baseline_t;
+
+//=========================== variables ========================================
+
+// clang-format off
+#if defined(NRF5340_XXAA) && defined(NRF_NETWORK)
+// nRF5340 network core, 64 MHz, DWT->CYCCNT
+// TODO: no entries yet, the benchmark fails with NO BASELINE until the ones printed with BENCH_PRINT_BASELINE on the board are added
+static const bench_baseline_t bench_baseline[] = {
+    { NULL, 0, 0 },
+};
+#elif defined(NRF52840_XXAA) || defined(NRF52833_XXAA)
+// nRF52, 64 MHz, DWT->CYCCNT
+// TODO: no entries yet, the benchmark fails with NO BASELINE until the ones printed with BENCH_PRINT_BASELINE on the board are added
+static const bench_baseline_t bench_baseline[] = {
+    { NULL, 0, 0 },
+};
+#elif defined(__x86_64__)
+// host, x86-64 at -O2, rdtsc (reference cycles)
+static const bench_baseline_t bench_baseline[] = {
+    { "reference", 0, 910 },
+    { "scheduler_tick_gateway", 6, 67 },
+    { "scheduler_tick_gateway", 4, 56 },
+    { "scheduler_tick_gateway", 3, 68 },
+    { "scheduler_tick_gateway", 1, 56 },
+    { "scheduler_tick_node", 6, 71 },
+    { "scheduler_tick_node", 4, 67 },
+    { "scheduler_tick_node", 3, 73 },
+    { "scheduler_tick_node", 1, 75 },
+    { "queue_next_packet_beacon", 6, 212 },
+    { "queue_next_packet_beacon", 4, 161 },
+    { "queue_next_packet_beacon", 3, 170 },
+    { "queue_next_packet_beacon", 1, 222 },
+    { "queue_next_packet_downlink", 0, 79 },
+    { "queue_next_packet_aggregated", 0, 480 },
+    { "queue_next_packet_uplink", 0, 83 },
+    { "build_packet_beacon", 6, 175 },
+    { "build_packet_beacon", 4, 181 },
+    { "build_packet_beacon", 3, 146 },
+    { "build_packet_beacon", 1, 189 },
+    { "bloom_gateway_compute", 6, 388 },
+    { "bloom_gateway_compute", 4, 1035 },
+    { "bloom_gateway_compute", 3, 1538 },
+    { "bloom_gateway_compute", 1, 2297 },
+    { "bloom_gateway_update", 0, 289 },
+    { "bloom_node_contains", 6, 58 },
+    { "bloom_node_contains", 4, 40 },
+    { "bloom_node_contains", 3, 44 },
+    { "bloom_node_contains", 1, 53 },
+    { "handle_packet", 6, 69 },
+    { "handle_packet", 4, 82 },
+    { "handle_packet", 3, 80 },
+    { "handle_packet", 1, 59 },
+    { "scan_add", 0, 195 },
+    { "scan_select", 0, 155 },
+    { "hdlc_encode", 0, 1738 },
+    { "hdlc_decode", 0, 3399 },
+    { NULL, 0, 0 },
+};
+#else
+static const bench_baseline_t bench_baseline[] = {
+    { NULL, 0, 0 },
+};
+#endif
+// clang-format on
+
+#endif  // __BASELINE_H
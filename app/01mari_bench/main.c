@@ -0,0 +1,543 @@
+/**
+ * @file
+ * @ingroup     app_bench
+ *
+ * @brief       Cycles per call of the code that runs inside a mari slot
+ *
+ * Each function is called BENCH_N_SAMPLES times, and the median number of
+ * cycles per call is compared with the stored baseline (see baseline.h). The
+ * median is scaled by how fast a reference kernel ran just before, compared
+ * to the baseline, so that a machine or a moment that is faster or slower as
+ * a whole is not taken for a change of the code. The functions that depend
+ * on the schedule are measured with each available schedule, on a gateway and
+ * a node where all the uplink cells are assigned.
+ *
+ * Cycles are read from DWT->CYCCNT on the target, and with rdtsc on x86 hosts.
+ *
+ * Usage on the host: 01mari_bench [-b] [-t tolerance], see _usage below.
+ *
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <nrf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif !defined(DWT)
+#include <time.h>
+#endif
+#if defined(__linux__) || defined(__APPLE__)
+#include <unistd.h>
+#define BENCH_HAS_ARGS
+#endif
+
+#include "mr_device.h"
+#include "mr_timer_hf.h"
+#include "mari.h"
+#include "mac.h"
+#include "association.h"
+#include "scheduler.h"
+#include "queue.h"
+#include "bloom.h"
+#include "scan.h"
+#include "packet.h"
+#include "context.h"
+#include "hdlc.h"
+#include "baseline.h"
+
+//=========================== defines ==========================================
+
+#define BENCH_N_SAMPLES            (101)
+#define BENCH_ASN_START            ((1ULL << 40) + 12345)         ///< Large enough for 64-bit divisions to be as slow as they get
+#define BENCH_NET_ID               (MARI_NET_ID_DEFAULT)
+#define BENCH_NODE_ID_BASE         (0x0000000000001000ULL)
+#define BENCH_N_SCAN_GATEWAYS      (MARI_MAX_SCAN_LIST_SIZE + 2)  ///< More gateways than scan entries, so that entries get replaced
+#define BENCH_TOLERANCE_CYCLES     (16)                           ///< Slack on top of the tolerance, for the shortest calls
+#define BENCH_N_AGGREGATED         (8)                            ///< Small data packets packed into one downlink packet
+#define BENCH_N_ROUNDS             (5)                            ///< Times each function is measured, the lowest scaled median is kept
+#define BENCH_N_CONFIRM            (2)                            ///< Times a regression is measured again before it is reported
+#define BENCH_REFERENCE            "reference"                    ///< Name of the reference kernel in the baseline
+#define BENCH_REFERENCE_TABLE_SIZE (1024)                         ///< Words of the table the reference kernel scatters into
+
+// the cycle count is deterministic on the target, while caches, frequency scaling and the OS make the host noisy
+#if defined(DWT)
+#define BENCH_TOLERANCE_PERCENT (5)
+#else
+#define BENCH_TOLERANCE_PERCENT (50)
+#endif
+
+typedef void (*bench_function_t)(void);
+
+typedef struct {
+    const char      *name;
+    bool             per_schedule;  ///< Measured with each schedule, or once
+    bool             on_node;       ///< Run by the node instance instead of the gateway one
+    bench_function_t setup;         ///< Called before each call, not measured
+    bench_function_t run;           ///< Code being measured
+} bench_t;
+
+typedef struct {
+    const schedule_t *schedule;
+    const char       *name;
+} bench_schedule_t;
+
+typedef struct {
+    mari_ctx_t      gateway;
+    mari_ctx_t      node;
+    uint64_t        asn;
+    uint64_t        last_node_id;    ///< Node in the last uplink cell, the slowest one to look up
+    uint8_t         packet[MARI_PACKET_MAX_SIZE];
+    uint8_t         packet_len;
+    mr_membership_t membership;      ///< Membership in the beacons of the gateway
+    uint8_t         hdlc_frame[MARI_PACKET_MAX_SIZE * 2 + 6];
+    size_t          hdlc_frame_len;
+    uint32_t        scan_ts;
+    size_t          scan_gateway;
+    uint32_t        samples[BENCH_N_SAMPLES];
+    uint32_t        overhead;        ///< Cycles measured around an empty call
+    uint32_t        reference;       ///< Cycles of the reference kernel the medians are scaled to
+    uint32_t        reference_hash;  ///< Result of the reference kernel, so that it is not optimized out
+    uint32_t        reference_table[BENCH_REFERENCE_TABLE_SIZE];
+    size_t          regressions;
+    size_t          missing;         ///< Functions without a baseline, which cannot be checked
+} bench_vars_t;
+
+//=========================== variables ========================================
+
+extern const schedule_t schedule_tiny, schedule_medium, schedule_big, schedule_huge;
+
+static const bench_schedule_t _schedules[] = {
+    { &schedule_tiny, "tiny" },
+    { &schedule_medium, "medium" },
+    { &schedule_big, "big" },
+    { &schedule_huge, "huge" },
+};
+
+static bench_vars_t _bench_vars = { 0 };
+
+//=========================== prototypes =======================================
+
+static void _run_empty(void);
+static void _run_reference(void);
+static void _run_scheduler_tick(void);
+static void _setup_queue_next_packet_downlink(void);
+static void _run_queue_next_packet_beacon(void);
+static void _run_queue_next_packet_downlink(void);
+static void _setup_queue_next_packet_aggregated(void);
+static void _run_queue_next_packet_uplink(void);
+static void _run_build_packet_beacon(void);
+static void _run_bloom_gateway_compute(void);
+static void _run_bloom_gateway_update(void);
+static void _run_bloom_node_contains(void);
+static void _setup_handle_packet(void);
+static void _run_handle_packet(void);
+static void _run_scan_add(void);
+static void _setup_scan_select(void);
+static void _run_scan_select(void);
+static void _run_hdlc_encode(void);
+static void _setup_hdlc_decode(void);
+static void _run_hdlc_decode(void);
+
+static const bench_t _benches[] = {
+    { "scheduler_tick_gateway", true, false, NULL, _run_scheduler_tick },
+    { "scheduler_tick_node", true, true, NULL, _run_scheduler_tick },
+    { "queue_next_packet_beacon", true, false, NULL, _run_queue_next_packet_beacon },
+    { "queue_next_packet_downlink", false, false, _setup_queue_next_packet_downlink, _run_queue_next_packet_downlink },
+    { "queue_next_packet_aggregated", false, false, _setup_queue_next_packet_aggregated, _run_queue_next_packet_downlink },
+    { "queue_next_packet_uplink", false, true, NULL, _run_queue_next_packet_uplink },
+    { "build_packet_beacon", true, false, NULL, _run_build_packet_beacon },
+    { "bloom_gateway_compute", true, false, NULL, _run_bloom_gateway_compute },
+    { "bloom_gateway_update", false, false, NULL, _run_bloom_gateway_update },
+    { "bloom_node_contains", true, true, NULL, _run_bloom_node_contains },
+    { "handle_packet", true, false, _setup_handle_packet, _run_handle_packet },
+    { "scan_add", false, true, NULL, _run_scan_add },
+    { "scan_select", false, true, _setup_scan_select, _run_scan_select },
+    { "hdlc_encode", false, false, NULL, _run_hdlc_encode },
+    { "hdlc_decode", false, false, _setup_hdlc_decode, _run_hdlc_decode },
+};
+
+static void     _cycles_init(void);
+static uint32_t _cycles_now(void);
+static void     _setup_instances(const schedule_t *schedule);
+static void     _measure(const bench_t *bench, uint32_t *min, uint32_t *median);
+static uint32_t _measure_scaled(const bench_t *bench, const schedule_t *schedule, uint32_t *min);
+static uint32_t _baseline(const char *name, uint8_t schedule_id);
+static void     _report(const bench_t *bench, const bench_schedule_t *schedule, uint32_t tolerance_percent, bool print_baseline);
+
+//=========================== callbacks ========================================
+
+static void _event_callback(mr_event_t event, mr_event_data_t event_data) {
+    (void)event;
+    (void)event_data;
+}
+
+//=========================== main =============================================
+
+#ifdef BENCH_HAS_ARGS
+static void _usage(const char *name) {
+    printf("Usage: %s [options]\n", name);
+    printf("  -b       print the results as baseline.h entries\n");
+    printf("  -t P     regression tolerance, in percent of the baseline (%u), 0 to disable the check\n", BENCH_TOLERANCE_PERCENT);
+    printf("  -h       this help\n");
+}
+
+int main(int argc, char **argv) {
+    uint32_t tolerance_percent = BENCH_TOLERANCE_PERCENT;
+    bool     print_baseline    = false;
+    int      opt;
+    while ((opt = getopt(argc, argv, "bt:h")) != -1) {
+        switch (opt) {
+            case 'b':
+                print_baseline = true;
+                break;
+            case 't':
+                tolerance_percent = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                _usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+#else
+int main(void) {
+#ifdef BENCH_PRINT_BASELINE
+    bool print_baseline = true;
+#else
+    bool print_baseline = false;
+#endif
+    uint32_t tolerance_percent = BENCH_TOLERANCE_PERCENT;
+#endif
+
+    mr_timer_hf_init(MARI_TIMER_DEV);
+    _cycles_init();
+
+    // cycles spent reading the counter and calling through a function pointer
+    bench_t  empty = { "empty", false, false, NULL, _run_empty };
+    uint32_t unused;
+    _measure(&empty, &_bench_vars.overhead, &unused);
+
+    // the medians are scaled to the reference kernel of the baseline, or of this run when printing a new baseline
+    _bench_vars.reference = print_baseline ? 0 : _baseline(BENCH_REFERENCE, BENCH_ALL_SCHEDULES);
+    if (_bench_vars.reference == 0) {
+        bench_t reference     = { BENCH_REFERENCE, false, false, NULL, _run_reference };
+        _bench_vars.reference = UINT32_MAX;
+        for (size_t i = 0; i < BENCH_N_ROUNDS; i++) {
+            uint32_t median;
+            _measure(&reference, &unused, &median);
+            _bench_vars.reference = median < _bench_vars.reference ? median : _bench_vars.reference;
+        }
+    }
+
+    if (print_baseline) {
+        printf("    { \"%s\", %u, %u },\n", BENCH_REFERENCE, BENCH_ALL_SCHEDULES, (unsigned)_bench_vars.reference);
+    } else {
+        printf("%-28s %-8s %8s %8s %8s\n", "function", "schedule", "min", "median", "baseline");
+    }
+    for (size_t i = 0; i < sizeof(_benches) / sizeof(_benches[0]); i++) {
+        const bench_t *bench       = &_benches[i];
+        size_t         n_schedules = bench->per_schedule ? sizeof(_schedules) / sizeof(_schedules[0]) : 1;
+        for (size_t j = 0; j < n_schedules; j++) {
+            _report(bench, &_schedules[j], tolerance_percent, print_baseline);
+        }
+    }
+    mari_ctx_select(NULL);
+
+    if (!print_baseline) {
+        printf("%u regression(s), tolerance %u%% + %u cycles, overhead %u cycles removed, medians scaled to a reference of %u cycles\n", (unsigned)_bench_vars.regressions, (unsigned)tolerance_percent, BENCH_TOLERANCE_CYCLES, (unsigned)_bench_vars.overhead, (unsigned)_bench_vars.reference);
+        if (_bench_vars.missing) {
+            printf("FAILED: %u function(s) without a baseline, print one with -b or BENCH_PRINT_BASELINE and add it to baseline.h\n", (unsigned)_bench_vars.missing);
+        }
+    }
+
+#ifdef BENCH_HAS_ARGS
+    return _bench_vars.regressions || _bench_vars.missing ? 1 : 0;
+#else
+    while (1) {
+        __WFE();
+    }
+#endif
+}
+
+//=========================== benchmarks =======================================
+
+static void _run_empty(void) {
+}
+
+static void _run_reference(void) {
+    // hashing and scattered accesses to a table, like the bloom filter and the scheduler do, but code that never changes
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < MARI_PACKET_MAX_SIZE; i++) {
+        hash = (hash ^ _bench_vars.packet[i]) * 16777619UL;
+        _bench_vars.reference_table[hash % BENCH_REFERENCE_TABLE_SIZE] += hash;
+    }
+    _bench_vars.reference_hash = hash;
+}
+
+static void _run_scheduler_tick(void) {
+    mr_scheduler_tick(_bench_vars.asn++);
+}
+
+static void _setup_queue_next_packet_downlink(void) {
+    // a full data packet for the node in the last uplink cell
+    uint8_t payload[MARI_PACKET_MAX_SIZE - sizeof(mr_packet_header_t)] = { 0 };
+    uint8_t packet[MARI_PACKET_MAX_SIZE];
+    uint8_t len = mr_build_packet_data(packet, _bench_vars.last_node_id, payload, sizeof(payload));
+    mr_queue_add(packet, len);
+}
+
+static void _setup_queue_next_packet_aggregated(void) {
+    // commands for different nodes, all packed into the next downlink packet
+    uint8_t payload[] = { 0x01, 0x02, 0x03, 0x04 };
+    uint8_t packet[MARI_PACKET_MAX_SIZE];
+    for (size_t i = 0; i < BENCH_N_AGGREGATED; i++) {
+        uint8_t len = mr_build_packet_data(packet, BENCH_NODE_ID_BASE + i, payload, sizeof(payload));
+        mr_queue_add(packet, len);
+    }
+}
+
+static void _run_queue_next_packet_beacon(void) {
+    mr_queue_next_packet(SLOT_TYPE_BEACON);
+}
+
+static void _run_queue_next_packet_downlink(void) {
+    mr_queue_next_packet(SLOT_TYPE_DOWNLINK);
+}
+
+static void _run_queue_next_packet_uplink(void) {
+    // no data queued, the node builds a keepalive
+    mr_queue_next_packet(SLOT_TYPE_UPLINK);
+}
+
+static void _run_build_packet_beacon(void) {
+    mr_build_packet_beacon(_bench_vars.packet, BENCH_NET_ID, _bench_vars.asn++, mr_scheduler_gateway_remaining_capacity(), mr_scheduler_get_active_schedule_id());
+}
+
+static void _run_bloom_gateway_compute(void) {
+    mr_bloom_gateway_compute();
+}
+
+static void _run_bloom_gateway_update(void) {
+    // a node leaves and another one joins
+    const mr_cell_assignment_t *assignment = mr_scheduler_get_cell_assignment(mr_scheduler_gateway_get_node_cell(_bench_vars.last_node_id));
+    uint8_t                     uplink_index = mr_scheduler_get_active_schedule_ptr()->max_nodes - 1;  // the last uplink cell
+    mr_bloom_gateway_remove(assignment->bloom_h1, assignment->bloom_h2, uplink_index);
+    mr_bloom_gateway_add(assignment->bloom_h1, assignment->bloom_h2, uplink_index);
+}
+
+static void _run_bloom_node_contains(void) {
+    // a member, so that all the hashes are checked
+    mr_bloom_node_contains(_bench_vars.last_node_id, mr_scheduler_node_get_uplink_index(), _bench_vars.membership.encoding, _bench_vars.membership.data, _bench_vars.membership.len);
+}
+
+static void _setup_handle_packet(void) {
+    // data from the node in the last uplink cell, as received by the gateway
+    uint8_t payload[]      = { 0x01, 0x02, 0x03, 0x04 };
+    _bench_vars.packet_len = mr_build_packet_data(_bench_vars.packet, mr_device_id(), payload, sizeof(payload));
+
+    mr_packet_header_t *header = (mr_packet_header_t *)_bench_vars.packet;
+    header->src                = _bench_vars.last_node_id;
+}
+
+static void _run_handle_packet(void) {
+    mr_handle_packet(_bench_vars.packet, _bench_vars.packet_len);
+}
+
+static void _run_scan_add(void) {
+    mr_beacon_packet_header_t beacon = {
+        .version    = MARI_PROTOCOL_VERSION,
+        .type       = MARI_PACKET_BEACON,
+        .network_id = BENCH_NET_ID,
+        .asn        = _bench_vars.asn++,
+        .src        = BENCH_NODE_ID_BASE - 1 - _bench_vars.scan_gateway,
+    };
+    _bench_vars.scan_gateway = (_bench_vars.scan_gateway + 1) % BENCH_N_SCAN_GATEWAYS;
+    _bench_vars.scan_ts      = _bench_vars.scan_ts + 1000;
+    // on the advertising channel of the beacon cells, as the gateways send them
+    uint8_t channel = MARI_N_BLE_REGULAR_CHANNELS + beacon.asn % MARI_N_BLE_ADVERTISING_CHANNELS;
+    mr_scan_add(beacon, -60 - (int8_t)_bench_vars.scan_gateway, channel, _bench_vars.scan_ts, beacon.asn);
+}
+
+static void _setup_scan_select(void) {
+    // a full scan list, with entries to be replaced
+    for (size_t i = 0; i < BENCH_N_SCAN_GATEWAYS; i++) {
+        _run_scan_add();
+    }
+}
+
+static void _run_scan_select(void) {
+    mr_channel_info_t best_channel_info;
+    mr_scan_select(&best_channel_info, _bench_vars.scan_ts - MARI_SCAN_OLD_US / 2, _bench_vars.scan_ts);
+}
+
+static void _run_hdlc_encode(void) {
+    _bench_vars.hdlc_frame_len = mr_hdlc_encode(_bench_vars.packet, MARI_PACKET_MAX_SIZE, _bench_vars.hdlc_frame);
+}
+
+static void _setup_hdlc_decode(void) {
+    _run_hdlc_encode();
+}
+
+static void _run_hdlc_decode(void) {
+    // what the UART interrupt does for a whole frame, then the decoding of the frame
+    for (size_t i = 0; i < _bench_vars.hdlc_frame_len; i++) {
+        mr_hdlc_rx_byte(_bench_vars.hdlc_frame[i]);
+    }
+    mr_hdlc_decode(_bench_vars.packet);
+}
+
+//=========================== private ==========================================
+
+static void _cycles_init(void) {
+#if defined(DWT)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+static inline uint32_t _cycles_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    // keep the measured code from being reordered around the counter read
+    _mm_lfence();
+    uint32_t cycles = (uint32_t)__rdtsc();
+    _mm_lfence();
+    return cycles;
+#elif defined(DWT)
+    return DWT->CYCCNT;
+#else
+    // no cycle counter, nanoseconds instead
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+}
+
+static void _setup_instances(const schedule_t *schedule) {
+    mari_ctx_t    *instances[] = { &_bench_vars.gateway, &_bench_vars.node };
+    mr_node_type_t types[]     = { MARI_GATEWAY, MARI_NODE };
+
+    // the same stack state a gateway and a node have in a full network, without starting the MAC
+    for (size_t i = 0; i < 2; i++) {
+        mari_ctx_init(instances[i]);
+        mari_ctx_select(instances[i]);
+        mari_set_node_type(types[i]);
+        mr_ctx->mari.app_event_callback = _event_callback;
+        mr_assoc_init(BENCH_NET_ID, _event_callback);
+        mr_scheduler_init(schedule);
+        mr_queue_init(_event_callback);
+    }
+
+    mari_ctx_select(&_bench_vars.gateway);
+    mr_bloom_gateway_init();
+    int16_t last_cell_index = -1;
+    for (uint64_t node_id = BENCH_NODE_ID_BASE;; node_id++) {
+        int16_t cell_index = mr_scheduler_gateway_assign_next_available_uplink_cell(node_id, BENCH_ASN_START);
+        if (cell_index < 0) {
+            break;
+        }
+        last_cell_index          = cell_index;
+        _bench_vars.last_node_id = node_id;
+    }
+    _bench_vars.membership.len = mr_bloom_gateway_copy(&_bench_vars.membership.encoding, _bench_vars.membership.data);
+
+    mari_ctx_select(&_bench_vars.node);
+    mr_scheduler_node_assign_myself_to_uplink(mr_scheduler_get_uplink_index(last_cell_index));
+    mr_assoc_set_state(JOIN_STATE_JOINED);
+
+    _bench_vars.asn          = BENCH_ASN_START;
+    _bench_vars.scan_ts      = 0;
+    _bench_vars.scan_gateway = 0;
+    _bench_vars.packet_len   = MARI_PACKET_MAX_SIZE;
+    for (size_t i = 0; i < MARI_PACKET_MAX_SIZE; i++) {
+        _bench_vars.packet[i] = i;  // includes the HDLC flag and escape bytes
+    }
+}
+
+static void _measure(const bench_t *bench, uint32_t *min, uint32_t *median) {
+    for (size_t i = 0; i < BENCH_N_SAMPLES; i++) {
+        if (bench->setup) {
+            bench->setup();
+        }
+        uint32_t start = _cycles_now();
+        bench->run();
+        uint32_t cycles = _cycles_now() - start;
+        cycles          = cycles > _bench_vars.overhead ? cycles - _bench_vars.overhead : 0;
+
+        // insertion sort, the samples are few
+        size_t j = i;
+        while (j > 0 && _bench_vars.samples[j - 1] > cycles) {
+            _bench_vars.samples[j] = _bench_vars.samples[j - 1];
+            j--;
+        }
+        _bench_vars.samples[j] = cycles;
+    }
+    *min    = _bench_vars.samples[0];
+    *median = _bench_vars.samples[BENCH_N_SAMPLES / 2];
+}
+
+// lowest median over BENCH_N_ROUNDS, each scaled by the reference kernel measured just before
+static uint32_t _measure_scaled(const bench_t *bench, const schedule_t *schedule, uint32_t *min) {
+    bench_t  reference = { BENCH_REFERENCE, false, false, NULL, _run_reference };
+    uint32_t scaled    = UINT32_MAX;
+    *min               = UINT32_MAX;
+    for (size_t i = 0; i < BENCH_N_ROUNDS; i++) {
+        uint32_t reference_median, round_min, round_median;
+        _setup_instances(schedule);
+        mari_ctx_select(bench->on_node ? &_bench_vars.node : &_bench_vars.gateway);
+        _measure(&reference, &round_min, &reference_median);
+        _measure(bench, &round_min, &round_median);
+
+        uint32_t round_scaled = reference_median ? (uint64_t)round_median * _bench_vars.reference / reference_median : round_median;
+        scaled                = round_scaled < scaled ? round_scaled : scaled;
+        *min                  = round_min < *min ? round_min : *min;
+    }
+    return scaled;
+}
+
+static uint32_t _baseline(const char *name, uint8_t schedule_id) {
+    for (size_t i = 0; bench_baseline[i].name != NULL; i++) {
+        if (bench_baseline[i].schedule_id == schedule_id && strcmp(bench_baseline[i].name, name) == 0) {
+            return bench_baseline[i].cycles;
+        }
+    }
+    return 0;
+}
+
+static void _report(const bench_t *bench, const bench_schedule_t *schedule, uint32_t tolerance_percent, bool print_baseline) {
+    uint8_t  schedule_id = bench->per_schedule ? schedule->schedule->id : BENCH_ALL_SCHEDULES;
+    uint32_t min;
+    uint32_t median = _measure_scaled(bench, schedule->schedule, &min);
+
+    if (print_baseline) {
+        printf("    { \"%s\", %u, %u },\n", bench->name, schedule_id, (unsigned)median);
+        return;
+    }
+
+    uint32_t    baseline = _baseline(bench->name, schedule_id);
+    uint64_t    limit    = (uint64_t)baseline * (100 + tolerance_percent) / 100 + BENCH_TOLERANCE_CYCLES;
+    const char *verdict  = "";
+    if (baseline == 0) {
+        // a function that is not checked must not look like one that passed
+        verdict = "NO BASELINE";
+        if (tolerance_percent) {
+            _bench_vars.missing++;
+        }
+    } else if (tolerance_percent && median > limit) {
+        // only a slowdown that shows again is a regression, not a busy moment of the machine
+        for (size_t i = 0; i < BENCH_N_CONFIRM && median > limit; i++) {
+            uint32_t confirm_min;
+            uint32_t confirm_median = _measure_scaled(bench, schedule->schedule, &confirm_min);
+            median                  = confirm_median < median ? confirm_median : median;
+        }
+        if (median > limit) {
+            verdict = "REGRESSION";
+            _bench_vars.regressions++;
+        }
+    }
+    printf("%-28s %-8s %8u %8u %8u %s\n", bench->name, bench->per_schedule ? schedule->name : "all", (unsigned)min, (unsigned)median, (unsigned)baseline, verdict);
+}
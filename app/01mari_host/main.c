@@ -0,0 +1,247 @@
+/**
+ * @file
+ * @ingroup     app
+ *
+ * @brief       Mari gateway running on the host, with scripted nodes
+ *
+ * The gateway runs the unmodified mari stack on top of the host drivers.
+ * Nodes are scripted: they send a join request in the shared uplink slots
+ * until they are given a cell, then send a keepalive (or, from time to time,
+ * a data packet) in their uplink cell, every slotframe.
+ *
+ * Usage: 01mari_host [seconds] [number of nodes]
+ *
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "mr_device.h"
+#include "mr_host.h"
+#include "mari.h"
+#include "mac.h"
+#include "packet.h"
+#include "scheduler.h"
+#include "models.h"
+
+//=========================== defines ==========================================
+
+#define HOST_APP_NET_ID           MARI_NET_ID_DEFAULT
+#define HOST_APP_GATEWAY_ID       0x00000000000000A1ULL
+#define HOST_APP_NODE_ID_BASE     0x0000000000001000ULL
+#define HOST_APP_DEFAULT_SECONDS  (10)
+#define HOST_APP_DEFAULT_N_NODES  (50)
+#define HOST_APP_DATA_EVERY       (10)  ///< Every this many uplinks, a node sends data instead of a keepalive
+#define HOST_APP_RSSI             (-60)
+#define HOST_APP_MAX_NODES        (MARI_MAX_NODES)
+
+typedef struct {
+    uint64_t id;
+    bool     joined;
+    int16_t  cell_index;   ///< Assigned uplink cell, -1 if none
+    uint64_t join_at_us;   ///< Virtual time at which the join response was sent
+    uint32_t uplinks;      ///< Number of packets sent in the assigned cell
+    uint8_t  frame[MARI_PACKET_MAX_SIZE];
+    uint8_t  frame_len;
+    uint32_t frame_id;     ///< Identifier given by the gateway radio when the frame starts
+} host_node_t;
+
+typedef struct {
+    host_node_t nodes[HOST_APP_MAX_NODES];
+    size_t      n_nodes;
+    size_t      next_join_idx;  ///< Round robin over the nodes trying to join
+
+    uint32_t beacons_sent;
+    uint32_t join_requests_sent;
+    uint32_t joined_events;
+    uint32_t left_events;
+    uint32_t keepalive_events;
+    uint32_t data_events;
+} host_app_vars_t;
+
+//=========================== variables ========================================
+
+extern const schedule_t schedule_huge;
+
+static mr_host_device_t _gateway_device = { 0 };
+static host_app_vars_t  _app_vars       = { 0 };
+
+//=========================== prototypes =======================================
+
+static void _medium_tx(mr_host_device_t *device, uint8_t frequency, const uint8_t *packet, uint8_t length);
+static void _medium_rx(mr_host_device_t *device, uint8_t frequency);
+static void _node_frame_start(mr_host_device_t *device, uintptr_t node_idx);
+static void _node_frame_end(mr_host_device_t *device, uintptr_t node_idx);
+
+static const mr_host_medium_t _medium = {
+    .tx = _medium_tx,
+    .rx = _medium_rx,
+};
+
+//=========================== callbacks ========================================
+
+static void mari_event_callback(mr_event_t event, mr_event_data_t event_data) {
+    switch (event) {
+        case MARI_NODE_JOINED:
+            _app_vars.joined_events++;
+            break;
+        case MARI_NODE_LEFT:
+            _app_vars.left_events++;
+            printf("Node %016llX left, reason: %u\n", (unsigned long long)event_data.data.node_info.node_id, event_data.tag);
+            break;
+        case MARI_KEEPALIVE:
+            _app_vars.keepalive_events++;
+            break;
+        case MARI_NEW_PACKET:
+            _app_vars.data_events++;
+            break;
+        case MARI_ERROR:
+            printf("Error, reason: %u\n", event_data.tag);
+            break;
+        default:
+            break;
+    }
+}
+
+//=========================== medium ===========================================
+
+static void _medium_tx(mr_host_device_t *device, uint8_t frequency, const uint8_t *packet, uint8_t length) {
+    (void)device;
+    (void)frequency;
+    (void)length;
+
+    const mr_packet_header_t *header = (const mr_packet_header_t *)packet;
+    if (header->type == MARI_PACKET_BEACON) {
+        _app_vars.beacons_sent++;
+        return;
+    }
+    if (header->type != MARI_PACKET_JOIN_RESPONSE || header->dst < HOST_APP_NODE_ID_BASE) {
+        return;
+    }
+
+    size_t idx = header->dst - HOST_APP_NODE_ID_BASE;
+    if (idx < _app_vars.n_nodes && !_app_vars.nodes[idx].joined) {
+        // the first byte after the header contains the cell_id
+        _app_vars.nodes[idx].joined     = true;
+        _app_vars.nodes[idx].cell_index = packet[sizeof(mr_packet_header_t)];
+        _app_vars.nodes[idx].join_at_us = mr_host_now_us();
+    }
+}
+
+static void _medium_rx(mr_host_device_t *device, uint8_t frequency) {
+    (void)frequency;
+
+    // the gateway listens from rx_offset, the node would start transmitting at tx_offset
+    const schedule_t *schedule   = mr_scheduler_get_active_schedule_ptr();
+    uint64_t          asn        = mr_mac_get_asn() - 1;  // the asn is incremented when the slot starts
+    size_t            cell_index = asn % schedule->n_cells;
+    const cell_t     *cell       = &schedule->cells[cell_index];
+
+    host_node_t *node = NULL;
+    if (cell->type == SLOT_TYPE_SHARED_UPLINK) {
+        // one join request per shared uplink slot, so that they never collide
+        for (size_t i = 0; i < _app_vars.n_nodes && node == NULL; i++) {
+            host_node_t *candidate   = &_app_vars.nodes[_app_vars.next_join_idx];
+            _app_vars.next_join_idx = (_app_vars.next_join_idx + 1) % _app_vars.n_nodes;
+            if (!candidate->joined) {
+                node            = candidate;
+                node->frame_len = mr_build_packet_join_request(node->frame, HOST_APP_GATEWAY_ID);
+                _app_vars.join_requests_sent++;
+            }
+        }
+    } else if (cell->type == SLOT_TYPE_UPLINK) {
+        for (size_t i = 0; i < _app_vars.n_nodes; i++) {
+            if (_app_vars.nodes[i].joined && _app_vars.nodes[i].cell_index == (int16_t)cell_index) {
+                node = &_app_vars.nodes[i];
+                break;
+            }
+        }
+        if (node && ++node->uplinks % HOST_APP_DATA_EVERY == 0) {
+            node->frame_len = mr_build_packet_data(node->frame, HOST_APP_GATEWAY_ID, (uint8_t *)&node->uplinks, sizeof(node->uplinks));
+        } else if (node) {
+            node->frame_len = mr_build_packet_keepalive(node->frame, HOST_APP_GATEWAY_ID);
+        }
+    }
+    if (node == NULL) {
+        return;
+    }
+
+    // packets are built on behalf of the gateway, so fix the source address
+    ((mr_packet_header_t *)node->frame)->src = node->id;
+
+    uint64_t  start_us = mr_host_now_us() + slot_durations.rx_guard + MR_HOST_RADIO_ADDRESS_DELAY_US;
+    uintptr_t node_idx = node - _app_vars.nodes;
+    mr_host_schedule_at(start_us, device, &_node_frame_start, node_idx);
+    mr_host_schedule_at(start_us + mr_host_radio_toa_us(node->frame_len), device, &_node_frame_end, node_idx);
+}
+
+static void _node_frame_start(mr_host_device_t *device, uintptr_t node_idx) {
+    (void)device;
+    host_node_t *node = &_app_vars.nodes[node_idx];
+    node->frame_id    = mr_host_radio_frame_start(node->frame, node->frame_len, HOST_APP_RSSI);
+}
+
+static void _node_frame_end(mr_host_device_t *device, uintptr_t node_idx) {
+    (void)device;
+    mr_host_radio_frame_end(_app_vars.nodes[node_idx].frame_id, true);
+}
+
+//=========================== main =============================================
+
+static double _wall_time_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    uint32_t seconds  = argc > 1 ? strtoul(argv[1], NULL, 0) : HOST_APP_DEFAULT_SECONDS;
+    size_t   n_nodes  = argc > 2 ? strtoul(argv[2], NULL, 0) : HOST_APP_DEFAULT_N_NODES;
+    _app_vars.n_nodes = n_nodes < HOST_APP_MAX_NODES ? n_nodes : HOST_APP_MAX_NODES;
+    for (size_t i = 0; i < _app_vars.n_nodes; i++) {
+        _app_vars.nodes[i].id         = HOST_APP_NODE_ID_BASE + i;
+        _app_vars.nodes[i].cell_index = -1;
+    }
+
+    mr_host_device_init(&_gateway_device, HOST_APP_GATEWAY_ID);
+    mr_host_device_select(&_gateway_device);
+    mr_host_set_medium(&_medium);
+
+    printf("Hello Mari Gateway %016llX (host), %zu scripted nodes, %u s\n", (unsigned long long)mr_device_id(), _app_vars.n_nodes, seconds);
+
+    double   wall_start = _wall_time_s();
+    uint64_t start_us   = mr_host_now_us();
+    mari_init(MARI_GATEWAY, HOST_APP_NET_ID, &schedule_huge, &mari_event_callback);
+
+    uint64_t end_us = start_us + seconds * 1000ULL * 1000ULL;
+    while (mr_host_now_us() < end_us && mr_host_step()) {
+        mari_event_loop();
+    }
+    double wall_s = _wall_time_s() - wall_start;
+
+    // report
+    uint64_t join_sum_us = 0, join_max_us = 0;
+    size_t   joined      = 0;
+    for (size_t i = 0; i < _app_vars.n_nodes; i++) {
+        if (!_app_vars.nodes[i].joined) {
+            continue;
+        }
+        uint64_t join_us = _app_vars.nodes[i].join_at_us - start_us;
+        join_sum_us += join_us;
+        join_max_us = join_us > join_max_us ? join_us : join_max_us;
+        joined++;
+    }
+    printf("ASN %llu, beacons sent %u, join requests sent %u\n", (unsigned long long)mr_mac_get_asn(), _app_vars.beacons_sent, _app_vars.join_requests_sent);
+    printf("Nodes joined %zu/%zu (gateway counts %zu), avg join time %llu ms, max %llu ms\n",
+           joined, _app_vars.n_nodes, mari_gateway_count_nodes(),
+           (unsigned long long)(joined ? join_sum_us / joined / 1000 : 0), (unsigned long long)(join_max_us / 1000));
+    printf("Events: joined %u, left %u, keepalive %u, data %u\n", _app_vars.joined_events, _app_vars.left_events, _app_vars.keepalive_events, _app_vars.data_events);
+    printf("Simulated %u s in %.3f s (%.0fx real time)\n", seconds, wall_s, wall_s > 0 ? seconds / wall_s : 0);
+
+    return joined == _app_vars.n_nodes && _app_vars.left_events == 0 ? 0 : 1;
+}
@@ -0,0 +1,511 @@
+/**
+ * @file
+ * @ingroup     app_schedgen
+ *
+ * @brief       Generator of mari schedules, emitting C tables like the ones of all_schedules.c
+ *
+ * The schedule is built from the number of nodes, the ratio of uplink,
+ * downlink and shared uplink cells, and the number of beacon cells:
+ * - the beacon cells come first, as the scheduler expects
+ * - the downlink cells are spread evenly over the slotframe, so that the
+ *   longest wait for a downlink cell is as short as it gets
+ * - each shared uplink cell is placed right before a downlink cell, so that
+ *   a join response can follow its join request (or spread on their own)
+ * - the channel offsets walk the channels with a stride that keeps the
+ *   channels of nearby cells far apart, and use every channel as often
+ *
+ * The schedule is checked before it is written, and the output carries
+ * static assertions against MARI_N_CELLS_MAX and MARI_MAX_NODES, so that a
+ * table that does not fit the build fails to compile. With -c, the same
+ * checks run on the schedules built into the library.
+ *
+ * Usage: 01mari_schedgen [options], see _usage below.
+ *
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mari.h"
+#include "models.h"
+#include "scheduler.h"
+
+//=========================== defines ==========================================
+
+#define SCHEDGEN_N_BEACONS_MIN (MARI_N_BLE_ADVERTISING_CHANNELS)  ///< The scheduler expects at least one beacon cell per advertising channel
+#define SCHEDGEN_NAME_MAX_LEN  (64)
+
+typedef enum {
+    SCHEDGEN_PLACEMENT_PAIR,    ///< Each shared uplink cell right before a downlink cell
+    SCHEDGEN_PLACEMENT_SPREAD,  ///< Shared uplink cells spread evenly, like the downlink cells
+} schedgen_placement_t;
+
+typedef struct {
+    uint8_t              id;
+    char                 name[SCHEDGEN_NAME_MAX_LEN];
+    uint32_t             n_uplink;  ///< Also the maximum number of nodes
+    uint32_t             n_downlink;
+    uint32_t             n_shared;
+    uint32_t             n_beacons;
+    uint8_t              backoff_n_min;
+    uint8_t              backoff_n_max;
+    schedgen_placement_t placement;
+} schedgen_config_t;
+
+// ratio of uplink, downlink and shared uplink cells of each preset
+typedef struct {
+    const char *name;
+    uint32_t    uplink;
+    uint32_t    downlink;
+    uint32_t    shared;
+} schedgen_preset_t;
+
+static const schedgen_preset_t _presets[] = {
+    { "balanced", 4, 1, 1 },    // close to the built-in schedules
+    { "latency", 2, 1, 1 },     // twice as many downlink and join opportunities
+    { "throughput", 8, 1, 1 },  // as many uplink cells as possible per slotframe
+};
+
+extern const schedule_t schedule_tiny, schedule_medium, schedule_big, schedule_huge;
+
+static const schedule_t *_builtin_schedules[] = {
+    &schedule_tiny,
+    &schedule_medium,
+    &schedule_big,
+    &schedule_huge,
+};
+
+static const char *_builtin_names[] = {
+    "schedule_tiny",
+    "schedule_medium",
+    "schedule_big",
+    "schedule_huge",
+};
+
+//=========================== prototypes =======================================
+
+static bool     _generate(const schedgen_config_t *config, schedule_t *schedule);
+static uint8_t  _channel_stride(void);
+static uint32_t _check(const schedule_t *schedule, const char *name);
+static void     _print_stats(const schedule_t *schedule, const char *name);
+static void     _write(FILE *out, const schedule_t *schedule, const char *name, int argc, char **argv);
+static bool     _parse_ratio(const char *arg, uint32_t *uplink, uint32_t *downlink, uint32_t *shared);
+
+//=========================== main =============================================
+
+static void _usage(const char *name) {
+    printf("Usage: %s -i ID -n NODES [options]\n", name);
+    printf("       %s -c\n", name);
+    printf("  -i ID       schedule id, different from the ids of the built-in schedules\n");
+    printf("  -n NODES    maximum number of nodes, one uplink cell each\n");
+    printf("  -O PRESET   ratio of uplink, downlink and shared uplink cells: balanced (4:1:1), latency (2:1:1) or throughput (8:1:1)\n");
+    printf("  -r U:D:S    ratio of uplink, downlink and shared uplink cells, instead of a preset\n");
+    printf("  -d N        number of downlink cells, instead of the ratio\n");
+    printf("  -s N        number of shared uplink cells, instead of the ratio\n");
+    printf("  -b N        number of beacon cells (%u), at least %u\n", SCHEDGEN_N_BEACONS_MIN, SCHEDGEN_N_BEACONS_MIN);
+    printf("  -p PLACE    placement of the shared uplink cells: pair (before a downlink cell, default) or spread\n");
+    printf("  -e MIN:MAX  backoff exponents (5:9)\n");
+    printf("  -N NAME     name of the C variable (schedule_<ID>)\n");
+    printf("  -o FILE     output file (stdout)\n");
+    printf("  -c          check the built-in schedules, and print their stats\n");
+    printf("  -h          this help\n");
+}
+
+int main(int argc, char **argv) {
+    schedgen_config_t config = {
+        .n_beacons     = SCHEDGEN_N_BEACONS_MIN,
+        .backoff_n_min = 5,
+        .backoff_n_max = 9,
+        .placement     = SCHEDGEN_PLACEMENT_PAIR,
+    };
+    uint32_t    ratio_uplink = 4, ratio_downlink = 1, ratio_shared = 1;
+    int32_t     n_downlink = -1, n_shared = -1;
+    int32_t     id         = -1;
+    const char *output     = NULL;
+    bool        check_only = false;
+    int         opt;
+    while ((opt = getopt(argc, argv, "i:n:O:r:d:s:b:p:e:N:o:ch")) != -1) {
+        switch (opt) {
+            case 'i':
+                id = strtol(optarg, NULL, 0);
+                break;
+            case 'n':
+                config.n_uplink = strtoul(optarg, NULL, 0);
+                break;
+            case 'O':
+            {
+                size_t i = 0;
+                while (i < sizeof(_presets) / sizeof(_presets[0]) && strcmp(_presets[i].name, optarg) != 0) {
+                    i++;
+                }
+                if (i == sizeof(_presets) / sizeof(_presets[0])) {
+                    fprintf(stderr, "Unknown preset: %s\n", optarg);
+                    return 1;
+                }
+                ratio_uplink   = _presets[i].uplink;
+                ratio_downlink = _presets[i].downlink;
+                ratio_shared   = _presets[i].shared;
+                break;
+            }
+            case 'r':
+                if (!_parse_ratio(optarg, &ratio_uplink, &ratio_downlink, &ratio_shared)) {
+                    fprintf(stderr, "Invalid ratio: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'd':
+                n_downlink = strtol(optarg, NULL, 0);
+                break;
+            case 's':
+                n_shared = strtol(optarg, NULL, 0);
+                break;
+            case 'b':
+                config.n_beacons = strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                if (strcmp(optarg, "pair") == 0) {
+                    config.placement = SCHEDGEN_PLACEMENT_PAIR;
+                } else if (strcmp(optarg, "spread") == 0) {
+                    config.placement = SCHEDGEN_PLACEMENT_SPREAD;
+                } else {
+                    fprintf(stderr, "Unknown placement: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'e':
+            {
+                uint32_t min, max;
+                if (sscanf(optarg, "%u:%u", &min, &max) != 2) {
+                    fprintf(stderr, "Invalid backoff exponents: %s\n", optarg);
+                    return 1;
+                }
+                config.backoff_n_min = min;
+                config.backoff_n_max = max;
+                break;
+            }
+            case 'N':
+                snprintf(config.name, sizeof(config.name), "%s", optarg);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'c':
+                check_only = true;
+                break;
+            default:
+                _usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (check_only) {
+        uint32_t errors = 0;
+        mr_scheduler_init(NULL);
+        for (size_t i = 0; i < sizeof(_builtin_schedules) / sizeof(_builtin_schedules[0]); i++) {
+            errors += _check(_builtin_schedules[i], _builtin_names[i]);
+            for (size_t j = 0; j < i; j++) {
+                if (_builtin_schedules[j]->id == _builtin_schedules[i]->id) {
+                    fprintf(stderr, "%s: same id as %s\n", _builtin_names[i], _builtin_names[j]);
+                    errors++;
+                }
+            }
+            if (mr_scheduler_set_schedule(_builtin_schedules[i]->id)) {
+                _print_stats(_builtin_schedules[i], _builtin_names[i]);
+            }
+        }
+        return errors ? 1 : 0;
+    }
+
+    if (id <= 0 || id > UINT8_MAX || config.n_uplink == 0) {
+        _usage(argv[0]);
+        return 1;
+    }
+    config.id = id;
+    for (size_t i = 0; i < sizeof(_builtin_schedules) / sizeof(_builtin_schedules[0]); i++) {
+        if (_builtin_schedules[i]->id == config.id) {
+            fprintf(stderr, "Id %u is the id of %s\n", config.id, _builtin_names[i]);
+            return 1;
+        }
+    }
+    if (config.name[0] == '\0') {
+        snprintf(config.name, sizeof(config.name), "schedule_%u", config.id);
+    }
+    // counts from the ratio, rounded up
+    config.n_downlink = n_downlink >= 0 ? (uint32_t)n_downlink : (config.n_uplink * ratio_downlink + ratio_uplink - 1) / ratio_uplink;
+    config.n_shared   = n_shared >= 0 ? (uint32_t)n_shared : (config.n_uplink * ratio_shared + ratio_uplink - 1) / ratio_uplink;
+
+    static schedule_t schedule;
+    if (!_generate(&config, &schedule) || _check(&schedule, config.name) != 0) {
+        return 1;
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (out == NULL) {
+        perror(output);
+        return 1;
+    }
+    _write(out, &schedule, config.name, argc, argv);
+    if (output) {
+        fclose(out);
+    }
+
+    mr_scheduler_init(&schedule);
+    _print_stats(&schedule, config.name);
+    return 0;
+}
+
+//=========================== private ==========================================
+
+static bool _generate(const schedgen_config_t *config, schedule_t *schedule) {
+    uint32_t n_regular = config->n_uplink + config->n_downlink + config->n_shared;
+    uint32_t n_cells   = config->n_beacons + n_regular;
+    if (n_cells > MARI_N_CELLS_MAX) {
+        fprintf(stderr, "%s: %u cells, more than MARI_N_CELLS_MAX (%u)\n", config->name, n_cells, MARI_N_CELLS_MAX);
+        return false;
+    }
+    if (config->n_downlink == 0 || config->n_shared == 0) {
+        fprintf(stderr, "%s: nodes need at least one downlink and one shared uplink cell to join\n", config->name);
+        return false;
+    }
+    if (config->placement == SCHEDGEN_PLACEMENT_PAIR && config->n_shared > config->n_downlink) {
+        fprintf(stderr, "%s: more shared uplink than downlink cells, use -p spread\n", config->name);
+        return false;
+    }
+
+    memset(schedule, 0, sizeof(schedule_t));
+    schedule->id            = config->id;
+    schedule->max_nodes     = config->n_uplink;
+    schedule->backoff_n_min = config->backoff_n_min;
+    schedule->backoff_n_max = config->backoff_n_max;
+    schedule->n_cells       = n_cells;
+
+    // regular cells are uplink unless placed below, a 0 type marks them
+    cell_t *regular = &schedule->cells[config->n_beacons];
+
+    // downlink cells in the middle of n_downlink equal parts of the regular cells
+    uint32_t downlinks[MARI_N_CELLS_MAX];
+    for (uint32_t k = 0; k < config->n_downlink; k++) {
+        downlinks[k]               = ((2 * k + 1) * n_regular) / (2 * config->n_downlink);
+        regular[downlinks[k]].type = SLOT_TYPE_DOWNLINK;
+    }
+
+    for (uint32_t k = 0; k < config->n_shared; k++) {
+        uint32_t position;
+        if (config->placement == SCHEDGEN_PLACEMENT_PAIR) {
+            // before one of n_shared evenly chosen downlink cells, never at the very beginning
+            uint32_t downlink = downlinks[(k * config->n_downlink) / config->n_shared];
+            position          = downlink > 0 ? downlink - 1 : 0;
+        } else {
+            // a quarter of a part before the downlink cells
+            position = ((4 * k + 1) * n_regular) / (4 * config->n_shared);
+        }
+        // next free cell, going around
+        while (regular[position].type != 0) {
+            position = position + 1 < n_regular ? position + 1 : 0;
+        }
+        regular[position].type = SLOT_TYPE_SHARED_UPLINK;
+    }
+
+    uint8_t stride = _channel_stride();
+    for (uint32_t i = 0; i < config->n_beacons; i++) {
+        // beacons use their own channel offsets and frequencies
+        schedule->cells[i].type           = SLOT_TYPE_BEACON;
+        schedule->cells[i].channel_offset = i;
+    }
+    for (uint32_t j = 0; j < n_regular; j++) {
+        if (regular[j].type == 0) {
+            regular[j].type = SLOT_TYPE_UPLINK;
+        }
+        regular[j].channel_offset = (j * stride) % MARI_N_BLE_REGULAR_CHANNELS;
+    }
+    return true;
+}
+
+static uint8_t _channel_stride(void) {
+    // the channel of a cell is (asn + channel_offset) % MARI_N_BLE_REGULAR_CHANNELS, so with offsets j * stride, the
+    // channels of cells k apart differ by k * (stride + 1): pick the stride that keeps the 3 closest cells far apart
+    uint8_t best_stride   = 1;
+    uint8_t best_distance = 0;
+    for (uint8_t stride = 1; stride < MARI_N_BLE_REGULAR_CHANNELS - 1; stride++) {
+        uint8_t distance = MARI_N_BLE_REGULAR_CHANNELS;
+        for (uint8_t k = 1; k <= 3; k++) {
+            uint8_t delta = (k * (stride + 1)) % MARI_N_BLE_REGULAR_CHANNELS;
+            if (delta > MARI_N_BLE_REGULAR_CHANNELS - delta) {
+                delta = MARI_N_BLE_REGULAR_CHANNELS - delta;
+            }
+            distance = delta < distance ? delta : distance;
+        }
+        if (distance > best_distance) {
+            best_stride   = stride;
+            best_distance = distance;
+        }
+    }
+    return best_stride;
+}
+
+static uint32_t _check(const schedule_t *schedule, const char *name) {
+    uint32_t errors                                    = 0;
+    uint32_t counts[UINT8_MAX + 1]                     = { 0 };
+    uint32_t channel_uses[MARI_N_BLE_REGULAR_CHANNELS] = { 0 };
+
+    if (schedule->n_cells == 0 || schedule->n_cells > MARI_N_CELLS_MAX) {
+        fprintf(stderr, "%s: %zu cells, MARI_N_CELLS_MAX is %u\n", name, schedule->n_cells, MARI_N_CELLS_MAX);
+        return 1;
+    }
+    for (size_t i = 0; i < schedule->n_cells; i++) {
+        const cell_t *cell = &schedule->cells[i];
+        counts[cell->type]++;
+        if (cell->type == SLOT_TYPE_BEACON) {
+            if (i != counts[SLOT_TYPE_BEACON] - 1) {
+                fprintf(stderr, "%s: beacon cell %zu after a regular cell, the beacon cells must come first\n", name, i);
+                errors++;
+            }
+        } else if (cell->type == SLOT_TYPE_UPLINK || cell->type == SLOT_TYPE_DOWNLINK || cell->type == SLOT_TYPE_SHARED_UPLINK) {
+            channel_uses[cell->channel_offset % MARI_N_BLE_REGULAR_CHANNELS]++;
+        } else {
+            fprintf(stderr, "%s: cell %zu has an unknown type '%c'\n", name, i, cell->type);
+            errors++;
+        }
+    }
+
+    if (counts[SLOT_TYPE_BEACON] < SCHEDGEN_N_BEACONS_MIN) {
+        fprintf(stderr, "%s: %u beacon cells, the scheduler expects at least %u\n", name, counts[SLOT_TYPE_BEACON], SCHEDGEN_N_BEACONS_MIN);
+        errors++;
+    }
+    if (counts[SLOT_TYPE_DOWNLINK] == 0 || counts[SLOT_TYPE_SHARED_UPLINK] == 0) {
+        fprintf(stderr, "%s: no downlink or no shared uplink cell, nodes cannot join\n", name);
+        errors++;
+    }
+    if (schedule->max_nodes != counts[SLOT_TYPE_UPLINK]) {
+        fprintf(stderr, "%s: max_nodes is %u, for %u uplink cells\n", name, schedule->max_nodes, counts[SLOT_TYPE_UPLINK]);
+        errors++;
+    }
+    if (schedule->max_nodes > MARI_MAX_NODES) {
+        fprintf(stderr, "%s: max_nodes is %u, MARI_MAX_NODES is %u\n", name, schedule->max_nodes, MARI_MAX_NODES);
+        errors++;
+    }
+    if (schedule->n_cells % MARI_N_BLE_REGULAR_CHANNELS == 0) {
+        // the channel of a cell moves by n_cells every slotframe
+        fprintf(stderr, "%s: %zu cells, a multiple of %u: each cell would stay on the same channel\n", name, schedule->n_cells, MARI_N_BLE_REGULAR_CHANNELS);
+        errors++;
+    }
+    uint32_t n_regular = schedule->n_cells - counts[SLOT_TYPE_BEACON];
+    uint32_t max_uses  = (n_regular + MARI_N_BLE_REGULAR_CHANNELS - 1) / MARI_N_BLE_REGULAR_CHANNELS;
+    for (uint8_t channel = 0; channel < MARI_N_BLE_REGULAR_CHANNELS; channel++) {
+        if (channel_uses[channel] > max_uses) {
+            fprintf(stderr, "%s: channel offset %u used by %u cells, at most %u for the channels to be used evenly\n", name, channel, channel_uses[channel], max_uses);
+            errors++;
+        }
+    }
+    if (schedule->backoff_n_min > schedule->backoff_n_max) {
+        fprintf(stderr, "%s: backoff_n_min %u above backoff_n_max %u\n", name, schedule->backoff_n_min, schedule->backoff_n_max);
+        errors++;
+    }
+    return errors;
+}
+
+static void _print_stats(const schedule_t *schedule, const char *name) {
+    // the active schedule of the scheduler gives the slot durations
+    uint32_t slotframe_us      = mr_scheduler_get_duration_us();
+    uint32_t n_uplink          = 0;
+    uint32_t max_wait_us[2]    = { 0 };  // longest time between two downlink, and two shared uplink cells
+    int32_t  first[2]          = { -1, -1 };
+    uint32_t since_first[2]    = { 0 };
+    uint32_t since_previous[2] = { 0 };
+
+    for (size_t i = 0; i < schedule->n_cells; i++) {
+        slot_type_t type = schedule->cells[i].type;
+        n_uplink += type == SLOT_TYPE_UPLINK;
+        for (uint8_t t = 0; t < 2; t++) {
+            if (type == (t == 0 ? SLOT_TYPE_DOWNLINK : SLOT_TYPE_SHARED_UPLINK)) {
+                if (first[t] < 0) {
+                    first[t] = i;
+                } else if (since_previous[t] > max_wait_us[t]) {
+                    max_wait_us[t] = since_previous[t];
+                }
+                since_previous[t] = 0;
+            }
+            if (first[t] >= 0) {
+                since_previous[t] += mr_scheduler_get_slot_duration_us(i);
+            }
+        }
+    }
+    for (uint8_t t = 0; t < 2; t++) {
+        // around the end of the slotframe
+        since_first[t] = 0;
+        for (int32_t i = 0; i < first[t]; i++) {
+            since_first[t] += mr_scheduler_get_slot_duration_us(i);
+        }
+        if (first[t] >= 0 && since_previous[t] + since_first[t] > max_wait_us[t]) {
+            max_wait_us[t] = since_previous[t] + since_first[t];
+        }
+    }
+
+    fprintf(stderr, "%s: id %u, %zu cells, %u nodes, slotframe %u.%02u ms, uplink %u.%02u kb/s per node, longest wait for a downlink cell %u.%02u ms, for a shared uplink cell %u.%02u ms\n",
+            name, schedule->id, schedule->n_cells, n_uplink,
+            slotframe_us / 1000, (slotframe_us % 1000) / 10,
+            // one frame of MARI_PACKET_MAX_SIZE bytes per slotframe
+            (MARI_PACKET_MAX_SIZE * 8 * 1000) / slotframe_us, ((MARI_PACKET_MAX_SIZE * 8 * 100000) / slotframe_us) % 100,
+            max_wait_us[0] / 1000, (max_wait_us[0] % 1000) / 10,
+            max_wait_us[1] / 1000, (max_wait_us[1] % 1000) / 10);
+}
+
+static void _write(FILE *out, const schedule_t *schedule, const char *name, int argc, char **argv) {
+    uint32_t n_beacons = 0;
+    while (n_beacons < schedule->n_cells && schedule->cells[n_beacons].type == SLOT_TYPE_BEACON) {
+        n_beacons++;
+    }
+
+    fprintf(out, "/**\n");
+    fprintf(out, " * @file\n");
+    fprintf(out, " * @ingroup     net_maclow\n");
+    fprintf(out, " *\n");
+    fprintf(out, " * @brief       Generated schedule, do not edit\n");
+    fprintf(out, " *\n");
+    fprintf(out, " * Generated with:");
+    for (int i = 0; i < argc; i++) {
+        fprintf(out, " %s", i == 0 ? "01mari_schedgen" : argv[i]);
+    }
+    fprintf(out, "\n */\n");
+    fprintf(out, "#include \"models.h\"\n");
+    fprintf(out, "#include \"mari.h\"\n\n");
+    fprintf(out, "_Static_assert(%zu <= MARI_N_CELLS_MAX, \"%s: more cells than MARI_N_CELLS_MAX\");\n", schedule->n_cells, name);
+    fprintf(out, "_Static_assert(%u <= MARI_MAX_NODES, \"%s: more nodes than MARI_MAX_NODES\");\n\n", schedule->max_nodes, name);
+
+    fprintf(out, "// clang-format off\n");
+    fprintf(out, "/* Schedule with %zu slots, supporting up to %u nodes */\n", schedule->n_cells, schedule->max_nodes);
+    fprintf(out, "const schedule_t %s = {\n", name);
+    fprintf(out, "    .id = %u,\n", schedule->id);
+    fprintf(out, "    .max_nodes = %u,\n", schedule->max_nodes);
+    fprintf(out, "    .backoff_n_min = %u,\n", schedule->backoff_n_min);
+    fprintf(out, "    .backoff_n_max = %u,\n", schedule->backoff_n_max);
+    fprintf(out, "    .n_cells = %zu,\n", schedule->n_cells);
+    fprintf(out, "    .cells = {\n");
+    fprintf(out, "        // Begin with beacon cells. They use their own channel offsets and frequencies.\n");
+    for (size_t i = 0; i < schedule->n_cells; i++) {
+        if (i == n_beacons) {
+            fprintf(out, "        // Continue with regular cells.\n");
+        }
+        fprintf(out, "        {'%c', %u}%s\n", schedule->cells[i].type, schedule->cells[i].channel_offset, i + 1 < schedule->n_cells ? "," : "");
+    }
+    fprintf(out, "    }\n");
+    fprintf(out, "};\n");
+    fprintf(out, "// clang-format on\n");
+}
+
+static bool _parse_ratio(const char *arg, uint32_t *uplink, uint32_t *downlink, uint32_t *shared) {
+    uint32_t u, d, s;
+    if (sscanf(arg, "%u:%u:%u", &u, &d, &s) != 3 || u == 0) {
+        return false;
+    }
+    *uplink   = u;
+    *downlink = d;
+    *shared   = s;
+    return true;
+}
@@ -21,7 +21,7 @@
 
 // make some schedules available for testing
 #include "test_schedules.c"
-extern schedule_t schedule_minuscule, schedule_only_beacons_optimized_scan;
+extern const schedule_t schedule_minuscule, schedule_only_beacons_optimized_scan;
 
 int main(void) {
     // initialize high frequency timer
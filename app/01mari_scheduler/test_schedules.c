@@ -9,11 +9,11 @@ schedule_t schedule_test_app = {
     .n_cells       = 5,
     .cells         = {
         // Only downlink slot_durations
-        { 'B', 0, NULL },
-        { 'S', 1, NULL },
-        { 'D', 2, NULL },
-        { 'U', 3, NULL },
-        { 'U', 4, NULL },
+        { 'B', 0 },
+        { 'S', 1 },
+        { 'D', 2 },
+        { 'U', 3 },
+        { 'U', 4 },
     }
 };
 
@@ -26,11 +26,11 @@ schedule_t schedule_all_uplink = {
     .n_cells       = 5,
     .cells         = {
         // Only downlink slot_durations
-        { 'U', 0, NULL },
-        { 'U', 1, NULL },
-        { 'U', 2, NULL },
-        { 'U', 3, NULL },
-        { 'U', 4, NULL },
+        { 'U', 0 },
+        { 'U', 1 },
+        { 'U', 2 },
+        { 'U', 3 },
+        { 'U', 4 },
     }
 };
 
@@ -43,10 +43,10 @@ schedule_t schedule_all_downlink = {
     .n_cells       = 5,
     .cells         = {
         // Only downlink slot_durations
-        { 'D', 0, NULL },
-        { 'D', 1, NULL },
-        { 'D', 2, NULL },
-        { 'D', 3, NULL },
-        { 'D', 4, NULL },
+        { 'D', 0 },
+        { 'D', 1 },
+        { 'D', 2 },
+        { 'D', 3 },
+        { 'D', 4 },
     }
 };
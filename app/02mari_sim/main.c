@@ -0,0 +1,628 @@
+/**
+ * @file
+ * @ingroup     app_sim
+ *
+ * @brief       Discrete-event simulator of a multi-gateway mari network
+ *
+ * Every gateway and node runs its own mari instance on its own emulated chip
+ * (see drv/mr_host.h), and they all share a simulated BLE medium. The mari
+ * instance of a device is selected each time the simulator switches to it.
+ *
+ * Usage: 02mari_sim [-h] [options], see _usage below.
+ *
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mr_host.h"
+#include "mari.h"
+#include "context.h"
+#include "packet.h"
+#include "models.h"
+#include "scheduler.h"
+#include "sim.h"
+
+//=========================== defines ==========================================
+
+#define SIM_NET_ID               MARI_NET_ID_DEFAULT
+#define SIM_GATEWAY_ID_BASE      0x00000000AAAA0000ULL
+#define SIM_NODE_ID_BASE         0x0000000000010000ULL
+#define SIM_PAYLOAD_TYPE         0x5A                ///< Payload type of the packets generated by the simulator
+#define SIM_EVENT_LOOP_PERIOD_US (500)               ///< Period of the gateway main loop
+#define SIM_DRAIN_US             (1000 * 1000)       ///< No traffic is generated in the last second, so all packets can be delivered
+#define SIM_N_EVENT_TAGS         (MARI_HANDOVER_FAILED + 1)
+#define SIM_BULK_START_US        (5 * 1000 * 1000)  ///< When the gateways start the bulk transfer, so that most nodes joined
+
+typedef struct __attribute__((packed)) {
+    uint8_t  type;
+    uint32_t seq;
+    uint64_t enqueued_us;
+} sim_payload_t;
+
+typedef struct {
+    uint32_t *values;
+    size_t    len;
+    size_t    size;
+} sim_samples_t;
+
+typedef struct {
+    sim_samples_t first_join_us;  ///< From power on to the first MARI_CONNECTED
+    sim_samples_t rejoin_us;      ///< From a MARI_DISCONNECTED to the next MARI_CONNECTED
+    sim_samples_t uplink_us;
+    sim_samples_t downlink_us;
+    uint64_t      uplink_sent;
+    uint64_t      downlink_sent;
+    uint32_t      next_seq;        ///< Sequence number of the next payload, unique in the whole simulation
+    uint8_t      *delivered;       ///< Bitmap of the payloads delivered, indexed by sequence number
+    uint64_t      duplicates;      ///< Payloads delivered more than once, when an ACK is lost
+    uint64_t      disconnects[SIM_N_EVENT_TAGS];
+    uint64_t      nodes_left;
+    uint64_t      gateway_full;
+    sim_samples_t bulk_us;           ///< From the start of the bulk transfer to the MARI_BULK_COMPLETE of a node
+    uint64_t      bulk_corrupted;    ///< Chunks whose data is not the one of the image
+    uint64_t      bulk_chunks_sent;  ///< By the gateways that completed their transfer
+    uint64_t      bulk_gateways_done;
+    uint64_t      bulk_gateways_aborted;  ///< Gateways that gave up their transfer, see MARI_BULK_MAX_RESENDS
+    uint8_t       bulk_chunk_size;
+} sim_stats_t;
+
+typedef struct {
+    sim_config_t  config;
+    sim_device_t *devices;
+    size_t        n_devices;
+    uint64_t      traffic_end_us;
+    uint8_t      *bulk_image;
+    sim_stats_t   stats;
+} sim_vars_t;
+
+//=========================== variables ========================================
+
+extern const schedule_t schedule_tiny, schedule_medium, schedule_big, schedule_huge;
+
+static sim_vars_t _sim_vars = {
+    .config = {
+        .n_gateways         = 4,
+        .n_nodes            = 100,
+        .duration_s         = 60,
+        .boot_spread_ms     = 1000,
+        .schedule           = &schedule_huge,
+        .seed               = 1,
+        .uplink_period_ms   = 1000,
+        .downlink_period_ms = 500,
+        .bulk_image_kb      = 0,
+        .area_m             = 40,
+        .tx_power_dbm       = 0,
+        .path_loss_d0_db    = 40,
+        .path_loss_exp      = 3,
+        .fading_sigma_db    = 4,
+        .sensitivity_dbm    = -92,
+        .noise_floor_dbm    = -100,
+        .capture_db         = 6,
+        .capture_window_us  = 8,
+        .speed_mps          = 0,
+    },
+};
+
+//=========================== prototypes =======================================
+
+static void _switch_device(mr_host_device_t *from, mr_host_device_t *to);
+static void _boot(mr_host_device_t *device, uintptr_t arg);
+static void _gateway_event_loop(mr_host_device_t *device, uintptr_t arg);
+static void _node_uplink(mr_host_device_t *device, uintptr_t arg);
+static void _gateway_downlink(mr_host_device_t *device, uintptr_t arg);
+static void _gateway_bulk_start(mr_host_device_t *device, uintptr_t arg);
+static void _samples_add(sim_samples_t *samples, uint64_t value);
+static uint32_t _payload_seq(void);
+static void _samples_print(const char *name, sim_samples_t *samples);
+static bool _parse_channels(const char *list, uint64_t *channels);
+
+//=========================== callbacks ========================================
+
+static sim_device_t *_current(void) {
+    return mr_host_device_current()->ctx;
+}
+
+static void _handle_data(sim_samples_t *latencies, const mari_packet_t *packet) {
+    if (packet->payload_len != sizeof(sim_payload_t) || packet->payload[0] != SIM_PAYLOAD_TYPE) {
+        return;
+    }
+    sim_payload_t payload;
+    memcpy(&payload, packet->payload, sizeof(sim_payload_t));
+    uint8_t *delivered = &_sim_vars.stats.delivered[payload.seq / 8];
+    if (*delivered & (1 << (payload.seq % 8))) {
+        _sim_vars.stats.duplicates++;
+        return;
+    }
+    *delivered |= 1 << (payload.seq % 8);
+    _samples_add(latencies, mr_host_now_us() - payload.enqueued_us);
+}
+
+static void _gateway_event_callback(mr_event_t event, mr_event_data_t event_data) {
+    switch (event) {
+        case MARI_NEW_PACKET:
+            _handle_data(&_sim_vars.stats.uplink_us, &event_data.data.new_packet);
+            break;
+        case MARI_NODE_LEFT:
+            _sim_vars.stats.nodes_left++;
+            break;
+        case MARI_ERROR:
+            if (event_data.tag == MARI_GATEWAY_FULL) {
+                _sim_vars.stats.gateway_full++;
+            }
+            break;
+        case MARI_BULK_COMPLETE:
+            _sim_vars.stats.bulk_chunks_sent += event_data.data.bulk.chunks_sent;
+            _sim_vars.stats.bulk_gateways_done++;
+            break;
+        case MARI_BULK_ABORTED:
+            _sim_vars.stats.bulk_gateways_aborted++;
+            break;
+        default:
+            break;
+    }
+}
+
+static void _node_event_callback(mr_event_t event, mr_event_data_t event_data) {
+    sim_device_t *node = _current();
+    uint64_t      now  = mr_host_now_us();
+
+    switch (event) {
+        case MARI_NEW_PACKET:
+            _handle_data(&_sim_vars.stats.downlink_us, &event_data.data.new_packet);
+            break;
+        case MARI_CONNECTED:
+            _samples_add(node->joined_once ? &_sim_vars.stats.rejoin_us : &_sim_vars.stats.first_join_us, now - node->searching_since_us);
+            node->joined_once = true;
+            node->connected   = true;
+            node->gateway_id  = event_data.data.gateway_info.gateway_id;
+            break;
+        case MARI_DISCONNECTED:
+            if (node->connected) {
+                node->connected          = false;
+                node->searching_since_us = now;
+            }
+            if (event_data.tag < SIM_N_EVENT_TAGS) {
+                _sim_vars.stats.disconnects[event_data.tag]++;
+            }
+            break;
+        case MARI_BULK_CHUNK:
+        {
+            const uint8_t *expected = _sim_vars.bulk_image + event_data.data.bulk.offset;
+            if (_sim_vars.bulk_image == NULL || memcmp(event_data.data.bulk.data, expected, event_data.data.bulk.len) != 0) {
+                _sim_vars.stats.bulk_corrupted++;
+            }
+            if (event_data.data.bulk.len > _sim_vars.stats.bulk_chunk_size) {
+                _sim_vars.stats.bulk_chunk_size = event_data.data.bulk.len;
+            }
+            break;
+        }
+        case MARI_BULK_COMPLETE:
+            if (!node->bulk_complete) {
+                node->bulk_complete = true;
+                _samples_add(&_sim_vars.stats.bulk_us, now - SIM_BULK_START_US);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+//=========================== events ===========================================
+
+static void _switch_device(mr_host_device_t *from, mr_host_device_t *to) {
+    (void)from;
+    sim_device_t *next = to->ctx;
+
+    // the simulator itself runs on the default device, which does not use mari
+    if (next != NULL) {
+        mari_ctx_select(next->mari);
+    }
+}
+
+static void _boot(mr_host_device_t *device, uintptr_t arg) {
+    (void)arg;
+    sim_device_t *sim_device       = device->ctx;
+    sim_device->booted             = true;
+    sim_device->searching_since_us = mr_host_now_us();
+
+    if (sim_device->node_type == MARI_GATEWAY) {
+        mr_host_schedule_at(mr_host_now_us() + SIM_EVENT_LOOP_PERIOD_US, device, &_gateway_event_loop, 0);
+        if (_sim_vars.config.downlink_period_ms) {
+            uint64_t phase_us = sim_random_u64() % (_sim_vars.config.downlink_period_ms * 1000ULL);
+            mr_host_schedule_at(mr_host_now_us() + phase_us, device, &_gateway_downlink, 0);
+        }
+        if (_sim_vars.bulk_image != NULL) {
+            uint64_t start_us = mr_host_now_us() > SIM_BULK_START_US ? mr_host_now_us() : SIM_BULK_START_US;
+            mr_host_schedule_at(start_us, device, &_gateway_bulk_start, 0);
+        }
+        mari_init(MARI_GATEWAY, SIM_NET_ID, _sim_vars.config.schedule, &_gateway_event_callback);
+    } else {
+        if (_sim_vars.config.uplink_period_ms) {
+            uint64_t phase_us = sim_random_u64() % (_sim_vars.config.uplink_period_ms * 1000ULL);
+            mr_host_schedule_at(mr_host_now_us() + phase_us, device, &_node_uplink, 0);
+        }
+        mari_init(MARI_NODE, SIM_NET_ID, _sim_vars.config.schedule, &_node_event_callback);
+    }
+}
+
+static void _gateway_event_loop(mr_host_device_t *device, uintptr_t arg) {
+    mari_event_loop();
+    mr_host_schedule_at(mr_host_now_us() + SIM_EVENT_LOOP_PERIOD_US, device, &_gateway_event_loop, arg);
+}
+
+static void _node_uplink(mr_host_device_t *device, uintptr_t arg) {
+    uint64_t now = mr_host_now_us();
+    if (now >= _sim_vars.traffic_end_us) {
+        return;
+    }
+    mr_host_schedule_at(now + _sim_vars.config.uplink_period_ms * 1000ULL, device, &_node_uplink, arg);
+
+    if (!mari_node_is_connected()) {
+        return;
+    }
+    sim_payload_t payload = { .type = SIM_PAYLOAD_TYPE, .seq = _payload_seq(), .enqueued_us = now };
+    mari_node_tx_payload((uint8_t *)&payload, sizeof(sim_payload_t));
+    _sim_vars.stats.uplink_sent++;
+}
+
+static void _gateway_downlink(mr_host_device_t *device, uintptr_t arg) {
+    uint64_t now = mr_host_now_us();
+    if (now >= _sim_vars.traffic_end_us) {
+        return;
+    }
+    mr_host_schedule_at(now + _sim_vars.config.downlink_period_ms * 1000ULL, device, &_gateway_downlink, arg);
+
+    uint64_t nodes[MARI_MAX_NODES];
+    size_t   n_nodes = mari_gateway_get_nodes(nodes);
+    if (n_nodes == 0) {
+        return;
+    }
+    sim_payload_t payload = { .type = SIM_PAYLOAD_TYPE, .seq = _payload_seq(), .enqueued_us = now };
+    uint8_t       packet[MARI_PACKET_MAX_SIZE];
+    size_t        length = mr_build_packet_data(packet, nodes[sim_random_u64() % n_nodes], (uint8_t *)&payload, sizeof(sim_payload_t));
+    mari_tx(packet, length);
+    _sim_vars.stats.downlink_sent++;
+}
+
+static void _gateway_bulk_start(mr_host_device_t *device, uintptr_t arg) {
+    (void)device;
+    (void)arg;
+    mari_gateway_bulk_start(_sim_vars.bulk_image, _sim_vars.config.bulk_image_kb * 1024);
+}
+
+//=========================== statistics =======================================
+
+static void _samples_add(sim_samples_t *samples, uint64_t value) {
+    if (samples->len == samples->size) {
+        samples->size   = samples->size ? samples->size * 2 : 1024;
+        samples->values = realloc(samples->values, samples->size * sizeof(uint32_t));
+        assert(samples->values);
+    }
+    samples->values[samples->len++] = value > UINT32_MAX ? UINT32_MAX : (uint32_t)value;
+}
+
+static uint32_t _payload_seq(void) {
+    sim_stats_t *stats = &_sim_vars.stats;
+    if (stats->next_seq % (1024 * 8) == 0) {
+        // grow the bitmap by 1 kB at a time, the new bits are cleared
+        stats->delivered = realloc(stats->delivered, stats->next_seq / 8 + 1024);
+        assert(stats->delivered);
+        memset(&stats->delivered[stats->next_seq / 8], 0, 1024);
+    }
+    return stats->next_seq++;
+}
+
+static bool _parse_channels(const char *list, uint64_t *channels) {
+    // comma separated channels or ranges of channels
+    *channels = 0;
+    while (*list) {
+        char         *end;
+        unsigned long first = strtoul(list, &end, 10);
+        unsigned long last  = first;
+        if (end == list) {
+            return false;
+        }
+        if (*end == '-') {
+            list = end + 1;
+            last = strtoul(list, &end, 10);
+            if (end == list) {
+                return false;
+            }
+        }
+        if (first > last || last >= 40 || (*end != ',' && *end != '\0')) {
+            return false;
+        }
+        for (unsigned long channel = first; channel <= last; channel++) {
+            *channels |= (uint64_t)1 << channel;
+        }
+        list = *end == ',' ? end + 1 : end;
+    }
+    return true;
+}
+
+static int _compare_u32(const void *a, const void *b) {
+    uint32_t va = *(const uint32_t *)a, vb = *(const uint32_t *)b;
+    return (va > vb) - (va < vb);
+}
+
+static void _samples_print(const char *name, sim_samples_t *samples) {
+    if (samples->len == 0) {
+        printf("  %-18s n=0\n", name);
+        return;
+    }
+    qsort(samples->values, samples->len, sizeof(uint32_t), _compare_u32);
+    double sum = 0;
+    for (size_t i = 0; i < samples->len; i++) {
+        sum += samples->values[i];
+    }
+    // values are in us, printed in ms
+#define _P(q) (samples->values[(size_t)((samples->len - 1) * (q))] / 1000.0)
+    printf("  %-18s n=%-7zu min %8.1f  p50 %8.1f  p90 %8.1f  p99 %8.1f  max %8.1f  mean %8.1f ms\n",
+           name, samples->len, _P(0), _P(0.5), _P(0.9), _P(0.99), _P(1), sum / samples->len / 1000.0);
+#undef _P
+}
+
+static void _report(double wall_s) {
+    const sim_config_t       *config = &_sim_vars.config;
+    const sim_medium_stats_t *medium = sim_medium_stats();
+    sim_stats_t              *stats  = &_sim_vars.stats;
+
+    size_t connected = 0;
+    for (size_t i = config->n_gateways; i < _sim_vars.n_devices; i++) {
+        connected += _sim_vars.devices[i].connected;
+    }
+
+    // packets that never left the queues, of gateways and nodes
+    // and data channels the gateways hop over at the end, and time with the receiver on
+    mr_queue_stats_t queues[2]    = { 0 };
+    uint64_t         rx_us[2]     = { 0 };
+    uint8_t          min_channels = MARI_N_BLE_REGULAR_CHANNELS;
+    uint8_t          max_channels = 0;
+    mari_ctx_t      *selected     = mari_ctx_current();
+    for (size_t i = 0; i < _sim_vars.n_devices; i++) {
+        mr_queue_stats_t  device_stats;
+        mr_queue_stats_t *total = &queues[i >= config->n_gateways];
+        mari_ctx_select(_sim_vars.devices[i].mari);
+        if (i < config->n_gateways) {
+            uint8_t n_channels = 0;
+            for (uint64_t map = mr_scheduler_get_channel_map(); map; map &= map - 1) {
+                n_channels++;
+            }
+            min_channels = n_channels < min_channels ? n_channels : min_channels;
+            max_channels = n_channels > max_channels ? n_channels : max_channels;
+        }
+        mari_get_queue_stats(&device_stats);
+        rx_us[i >= config->n_gateways] += _sim_vars.devices[i].device.radio.rx_us;
+        total->dropped_full += device_stats.dropped_full;
+        total->dropped_not_joined += device_stats.dropped_not_joined;
+        total->flushed += device_stats.flushed;
+        total->retried += device_stats.retried;
+        total->dropped_no_ack += device_stats.dropped_no_ack;
+        total->dropped_too_long += device_stats.dropped_too_long;
+        if (device_stats.high_watermark > total->high_watermark) {
+            total->high_watermark = device_stats.high_watermark;
+        }
+    }
+    mari_ctx_select(selected);
+
+    printf("Simulated %u s with %zu gateways and %zu nodes (schedule %u, area %.0f m, speed %.1f m/s, seed %llu) in %.1f s (%.1fx real time)\n",
+           config->duration_s, config->n_gateways, config->n_nodes, config->schedule->id, config->area_m, config->speed_mps,
+           (unsigned long long)config->seed, wall_s, wall_s > 0 ? config->duration_s / wall_s : 0);
+    printf("Medium: %llu frames, %llu receptions, %llu decoded, %llu lost to collisions\n",
+           (unsigned long long)medium->frames, (unsigned long long)medium->receptions,
+           (unsigned long long)medium->received, (unsigned long long)medium->collisions);
+    if (config->jammed_channels) {
+        printf("Jammed channels: %llu frames lost\n", (unsigned long long)medium->jammed);
+    }
+    printf("Data channels used by the gateways: %u to %u\n", min_channels, max_channels);
+    printf("Receiver on: gateways %.1f%%, nodes %.1f%% of the time\n",
+           config->n_gateways ? rx_us[0] / 1e4 / config->duration_s / config->n_gateways : 0,
+           config->n_nodes ? rx_us[1] / 1e4 / config->duration_s / config->n_nodes : 0);
+    printf("Nodes connected at the end: %zu/%zu\n", connected, config->n_nodes);
+    _samples_print("First join", &stats->first_join_us);
+    _samples_print("Rejoin", &stats->rejoin_us);
+    printf("Uplink: %zu/%llu delivered (PDR %.3f)\n", stats->uplink_us.len, (unsigned long long)stats->uplink_sent,
+           stats->uplink_sent ? (double)stats->uplink_us.len / stats->uplink_sent : 0);
+    _samples_print("Uplink latency", &stats->uplink_us);
+    printf("Downlink: %zu/%llu delivered (PDR %.3f)\n", stats->downlink_us.len, (unsigned long long)stats->downlink_sent,
+           stats->downlink_sent ? (double)stats->downlink_us.len / stats->downlink_sent : 0);
+    _samples_print("Downlink latency", &stats->downlink_us);
+    printf("Duplicates: %llu\n", (unsigned long long)stats->duplicates);
+    printf("Handovers: %llu (%.1f per minute), %llu failed\n",
+           (unsigned long long)stats->disconnects[MARI_HANDOVER], stats->disconnects[MARI_HANDOVER] * 60.0 / config->duration_s,
+           (unsigned long long)stats->disconnects[MARI_HANDOVER_FAILED]);
+    printf("Disconnects: out of sync %llu, timeout %llu, bloom %llu; nodes dropped by gateways %llu, gateway full %llu\n",
+           (unsigned long long)stats->disconnects[MARI_OUT_OF_SYNC], (unsigned long long)stats->disconnects[MARI_PEER_LOST_TIMEOUT],
+           (unsigned long long)stats->disconnects[MARI_PEER_LOST_BLOOM], (unsigned long long)stats->nodes_left,
+           (unsigned long long)stats->gateway_full);
+    for (size_t i = 0; i < 2; i++) {
+        printf("%s queues: dropped full %u, not joined %u, flushed %u, no ack %u, too long %u; retried %u; max depth %u\n", i ? "Node" : "Gateway",
+               queues[i].dropped_full, queues[i].dropped_not_joined, queues[i].flushed, queues[i].dropped_no_ack, queues[i].dropped_too_long, queues[i].retried,
+               queues[i].high_watermark);
+    }
+    if (config->bulk_image_kb) {
+        // chunks sent by the gateways that completed, against what they would send without any loss
+        uint32_t image_len = config->bulk_image_kb * 1024;
+        uint32_t n_chunks  = stats->bulk_chunk_size ? (image_len + stats->bulk_chunk_size - 1) / stats->bulk_chunk_size : 0;
+        printf("Bulk: %zu/%zu nodes have the %u kB image, %llu corrupted chunks; %llu/%zu gateways done, %llu aborted, sending %.2fx the %u chunks\n",
+               stats->bulk_us.len, config->n_nodes, config->bulk_image_kb, (unsigned long long)stats->bulk_corrupted,
+               (unsigned long long)stats->bulk_gateways_done, config->n_gateways, (unsigned long long)stats->bulk_gateways_aborted,
+               stats->bulk_gateways_done && n_chunks ? (double)stats->bulk_chunks_sent / stats->bulk_gateways_done / n_chunks : 0, n_chunks);
+        _samples_print("Bulk latency", &stats->bulk_us);
+    }
+}
+
+//=========================== main =============================================
+
+static void _usage(const char *name) {
+    const sim_config_t *config = &_sim_vars.config;
+    printf("Usage: %s [options]\n", name);
+    printf("  -g N     number of gateways (%zu)\n", config->n_gateways);
+    printf("  -n N     number of nodes (%zu)\n", config->n_nodes);
+    printf("  -t S     simulated duration, in seconds (%u)\n", config->duration_s);
+    printf("  -k NAME  schedule used by the gateways: tiny, medium, big or huge (huge)\n");
+    printf("  -a M     side of the square deployment area, in meters (%.0f)\n", config->area_m);
+    printf("  -v M/S   node speed, random waypoint mobility, 0 for static nodes (%.1f)\n", config->speed_mps);
+    printf("  -u MS    uplink period of each node, 0 to disable (%u)\n", config->uplink_period_ms);
+    printf("  -d MS    downlink period of each gateway, 0 to disable (%u)\n", config->downlink_period_ms);
+    printf("  -o KB    size of the image each gateway sends to its nodes in bulk, 0 to disable (%u)\n", config->bulk_image_kb);
+    printf("  -e EXP   path loss exponent (%.1f)\n", config->path_loss_exp);
+    printf("  -f DB    fading standard deviation (%.1f)\n", config->fading_sigma_db);
+    printf("  -c DB    capture threshold (%.1f)\n", config->capture_db);
+    printf("  -j LIST  BLE channels on which no frame can be decoded, e.g. 0-8,20 (none)\n");
+    printf("  -x PPM   crystal tolerance, each device deviates by up to this much (%u)\n", config->clock_ppm);
+    printf("  -b MS    devices power on at random times within this window (%u)\n", config->boot_spread_ms);
+    printf("  -s SEED  random seed (%llu)\n", (unsigned long long)config->seed);
+}
+
+static const schedule_t *_schedule_by_name(const char *name) {
+    if (strcmp(name, "tiny") == 0) {
+        return &schedule_tiny;
+    } else if (strcmp(name, "medium") == 0) {
+        return &schedule_medium;
+    } else if (strcmp(name, "big") == 0) {
+        return &schedule_big;
+    } else if (strcmp(name, "huge") == 0) {
+        return &schedule_huge;
+    }
+    return NULL;
+}
+
+static double _wall_time_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    sim_config_t *config = &_sim_vars.config;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "g:n:t:k:a:v:u:d:o:e:f:c:j:x:b:s:h")) != -1) {
+        switch (opt) {
+            case 'g':
+                config->n_gateways = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                config->n_nodes = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                config->duration_s = strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                config->schedule = _schedule_by_name(optarg);
+                break;
+            case 'a':
+                config->area_m = atof(optarg);
+                break;
+            case 'v':
+                config->speed_mps = atof(optarg);
+                break;
+            case 'u':
+                config->uplink_period_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                config->downlink_period_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 'o':
+                config->bulk_image_kb = strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                config->path_loss_exp = atof(optarg);
+                break;
+            case 'f':
+                config->fading_sigma_db = atof(optarg);
+                break;
+            case 'c':
+                config->capture_db = atof(optarg);
+                break;
+            case 'j':
+                if (!_parse_channels(optarg, &config->jammed_channels)) {
+                    _usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'x':
+                config->clock_ppm = strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                config->boot_spread_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                config->seed = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                _usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    _sim_vars.n_devices = config->n_gateways + config->n_nodes;
+    if (config->schedule == NULL || _sim_vars.n_devices == 0 || _sim_vars.n_devices > SIM_MAX_DEVICES) {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    sim_random_seed(config->seed);
+    sim_mobility_init(config);
+
+    if (config->bulk_image_kb) {
+        // a pattern that a shifted or misplaced chunk does not match
+        _sim_vars.bulk_image = malloc(config->bulk_image_kb * 1024);
+        assert(_sim_vars.bulk_image);
+        for (uint32_t i = 0; i < config->bulk_image_kb * 1024; i++) {
+            _sim_vars.bulk_image[i] = (uint8_t)(i * 131 + (i >> 8));
+        }
+    }
+
+    _sim_vars.devices = calloc(_sim_vars.n_devices, sizeof(sim_device_t));
+    assert(_sim_vars.devices);
+
+    // gateways on a grid, nodes spread uniformly
+    size_t grid = (size_t)ceil(sqrt(config->n_gateways));
+    for (size_t i = 0; i < _sim_vars.n_devices; i++) {
+        sim_device_t *sim_device = &_sim_vars.devices[i];
+        bool          is_gateway = i < config->n_gateways;
+        sim_position_t position;
+        if (is_gateway) {
+            double spacing = config->area_m / grid;
+            position       = (sim_position_t){ (i % grid + 0.5) * spacing, (i / grid + 0.5) * spacing };
+        } else {
+            position = (sim_position_t){ sim_random_uniform() * config->area_m, sim_random_uniform() * config->area_m };
+        }
+
+        mr_host_device_init(&sim_device->device, is_gateway ? SIM_GATEWAY_ID_BASE + i : SIM_NODE_ID_BASE + i);
+        if (config->clock_ppm) {
+            sim_device->device.clock_ppm = (int16_t)lround((2 * sim_random_uniform() - 1) * config->clock_ppm);
+        }
+        sim_device->device.ctx = sim_device;
+        sim_device->index      = i;
+        sim_device->node_type  = is_gateway ? MARI_GATEWAY : MARI_NODE;
+        sim_device->mari       = calloc(1, sizeof(mari_ctx_t));
+        assert(sim_device->mari);
+        sim_mobility_place(sim_device, position, !is_gateway);
+
+        uint64_t boot_us = config->boot_spread_ms ? sim_random_u64() % (config->boot_spread_ms * 1000ULL) : 0;
+        mr_host_schedule_at(boot_us, &sim_device->device, &_boot, 0);
+    }
+
+    sim_medium_init(config, _sim_vars.devices, _sim_vars.n_devices);
+    mr_host_set_switch_callback(&_switch_device);
+
+    uint64_t end_us          = config->duration_s * 1000ULL * 1000ULL;
+    _sim_vars.traffic_end_us = end_us > SIM_DRAIN_US ? end_us - SIM_DRAIN_US : 0;
+
+    double wall_start = _wall_time_s();
+    mr_host_run_until(end_us);
+    _report(_wall_time_s() - wall_start);
+
+    return 0;
+}
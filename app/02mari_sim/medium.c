@@ -0,0 +1,250 @@
+/**
+ * @file
+ * @ingroup     app_sim
+ *
+ * @brief       Simulated BLE medium: path loss, fading, collisions and capture
+ *
+ * Each transmitted frame is kept until it can no longer interfere. When the
+ * address of a frame reaches a listening device, the device locks on it,
+ * unless a stronger frame started within the capture window. At the end of
+ * the frame, the CRC is considered valid if the signal to interference ratio
+ * stayed above the capture threshold. Only frames on the same frequency
+ * interfere with each other.
+ *
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mr_host.h"
+#include "mr_radio.h"
+#include "sim.h"
+
+//=========================== defines ==========================================
+
+#define SIM_FRAME_MAX_DURATION_US (MR_HOST_RADIO_ADDRESS_DELAY_US + (MR_BLE_PAYLOAD_MAX_LENGTH + MR_HOST_RADIO_OVERHEAD_BYTES) * MR_HOST_RADIO_US_PER_BYTE)
+
+typedef struct {
+    sim_device_t *device;
+    uint32_t      lock_id;  ///< Identifier returned by mr_host_radio_frame_start
+    double        rssi;
+} sim_receiver_t;
+
+typedef struct {
+    bool            in_use;
+    uint64_t        seq;       ///< Unique frame number, also used to draw the fading
+    sim_device_t   *sender;
+    uint8_t         frequency;
+    uint64_t        start_us;  ///< EVENTS_ADDRESS
+    uint64_t        end_us;    ///< EVENTS_END
+    uint8_t         packet[MR_BLE_PAYLOAD_MAX_LENGTH];
+    uint8_t         length;
+    sim_receiver_t *receivers;
+    size_t          n_receivers;
+} sim_frame_t;
+
+typedef struct {
+    const sim_config_t *config;
+    sim_device_t       *devices;
+    size_t              n_devices;
+    sim_frame_t        *frames;  ///< Frames on the air, or that recently were
+    size_t              frames_size;
+    uint64_t            frame_seq;
+    sim_medium_stats_t  stats;
+} sim_medium_vars_t;
+
+//=========================== variables ========================================
+
+static sim_medium_vars_t _medium_vars = { 0 };
+
+//=========================== prototypes =======================================
+
+static void         _medium_tx(mr_host_device_t *device, uint8_t frequency, const uint8_t *packet, uint8_t length);
+static void         _frame_address(mr_host_device_t *device, uintptr_t frame_idx);
+static void         _frame_end(mr_host_device_t *device, uintptr_t frame_idx);
+static sim_frame_t *_frame_alloc(size_t *frame_idx);
+static double       _rssi(const sim_frame_t *frame, sim_device_t *receiver);
+static bool         _overlaps(const sim_frame_t *a, const sim_frame_t *b);
+
+static const mr_host_medium_t _medium = {
+    .tx = _medium_tx,
+};
+
+//=========================== public ===========================================
+
+void sim_medium_init(const sim_config_t *config, sim_device_t *devices, size_t n_devices) {
+    _medium_vars.config    = config;
+    _medium_vars.devices   = devices;
+    _medium_vars.n_devices = n_devices;
+    mr_host_set_medium(&_medium);
+}
+
+const sim_medium_stats_t *sim_medium_stats(void) {
+    return &_medium_vars.stats;
+}
+
+//=========================== private ==========================================
+
+static void _medium_tx(mr_host_device_t *device, uint8_t frequency, const uint8_t *packet, uint8_t length) {
+    size_t       frame_idx;
+    sim_frame_t *frame = _frame_alloc(&frame_idx);
+
+    frame->seq         = _medium_vars.frame_seq++;
+    frame->sender      = device->ctx;
+    frame->frequency   = frequency;
+    frame->start_us    = mr_host_now_us() + MR_HOST_RADIO_ADDRESS_DELAY_US;
+    frame->end_us      = frame->start_us + mr_host_radio_toa_us(length);
+    frame->length      = length;
+    frame->n_receivers = 0;
+    memcpy(frame->packet, packet, length);
+    _medium_vars.stats.frames++;
+
+    mr_host_schedule_at(frame->start_us, NULL, &_frame_address, frame_idx);
+    mr_host_schedule_at(frame->end_us, NULL, &_frame_end, frame_idx);
+}
+
+static void _frame_address(mr_host_device_t *device, uintptr_t frame_idx) {
+    const sim_config_t *config = _medium_vars.config;
+    sim_frame_t        *frame  = &_medium_vars.frames[frame_idx];
+
+    for (size_t i = 0; i < _medium_vars.n_devices; i++) {
+        sim_device_t *receiver = &_medium_vars.devices[i];
+        if (receiver == frame->sender || !mr_host_radio_is_listening(&receiver->device, frame->frequency)) {
+            continue;
+        }
+
+        double rssi = _rssi(frame, receiver);
+        if (rssi < config->sensitivity_dbm) {
+            continue;
+        }
+
+        // the receiver synchronizes on the strongest of the frames starting at about the same time
+        bool captured_by_other = false;
+        for (size_t j = 0; j < _medium_vars.frames_size && !captured_by_other; j++) {
+            sim_frame_t *other = &_medium_vars.frames[j];
+            if (!other->in_use || other == frame || other->frequency != frame->frequency || other->sender == receiver) {
+                continue;
+            }
+            uint64_t distance_us = other->start_us > frame->start_us ? other->start_us - frame->start_us : frame->start_us - other->start_us;
+            captured_by_other    = distance_us <= config->capture_window_us && _rssi(other, receiver) > rssi;
+        }
+        if (captured_by_other) {
+            continue;
+        }
+
+        // feed the frame to the receiver, as its own RADIO interrupt would
+        mr_host_device_select(&receiver->device);
+        uint32_t lock_id = mr_host_radio_frame_start(frame->packet, frame->length, (int8_t)fmax(rssi, INT8_MIN));
+        mr_host_device_select(device);
+        frame = &_medium_vars.frames[frame_idx];  // the receiver may have transmitted, and moved the frames around
+        if (lock_id == 0) {
+            continue;
+        }
+
+        if (frame->receivers == NULL) {
+            frame->receivers = malloc(_medium_vars.n_devices * sizeof(sim_receiver_t));
+            assert(frame->receivers);
+        }
+        frame->receivers[frame->n_receivers++] = (sim_receiver_t){ .device = receiver, .lock_id = lock_id, .rssi = rssi };
+        _medium_vars.stats.receptions++;
+    }
+}
+
+static bool _jammed(const sim_config_t *config, uint8_t frequency) {
+    for (uint8_t channel = 0; channel < 40; channel++) {
+        if (config->jammed_channels >> channel & 1 && frequency == mr_host_radio_channel_frequency(channel)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void _frame_end(mr_host_device_t *device, uintptr_t frame_idx) {
+    const sim_config_t *config = _medium_vars.config;
+    sim_frame_t        *frame  = &_medium_vars.frames[frame_idx];
+
+    for (size_t i = 0; i < frame->n_receivers; i++) {
+        sim_receiver_t *receiver = &frame->receivers[i];
+
+        // sum the power of all frames overlapping with this one
+        double interference_mw = 0;
+        for (size_t j = 0; j < _medium_vars.frames_size; j++) {
+            sim_frame_t *other = &_medium_vars.frames[j];
+            if (!other->in_use || other == frame || other->frequency != frame->frequency || !_overlaps(frame, other)) {
+                continue;
+            }
+            double other_rssi = _rssi(other, receiver->device);
+            if (other_rssi >= config->noise_floor_dbm) {
+                interference_mw += pow(10, other_rssi / 10);
+            }
+        }
+        bool crc_ok = interference_mw == 0 || receiver->rssi - 10 * log10(interference_mw) >= config->capture_db;
+        bool jammed = config->jammed_channels != 0 && _jammed(config, frame->frequency);
+        crc_ok      = crc_ok && !jammed;
+
+        if (crc_ok) {
+            _medium_vars.stats.received++;
+        } else if (jammed) {
+            _medium_vars.stats.jammed++;
+        } else {
+            _medium_vars.stats.collisions++;
+        }
+        mr_host_device_select(&receiver->device->device);
+        mr_host_radio_frame_end(receiver->lock_id, crc_ok);
+        mr_host_device_select(device);
+        frame = &_medium_vars.frames[frame_idx];
+    }
+    frame->n_receivers = 0;
+}
+
+static sim_frame_t *_frame_alloc(size_t *frame_idx) {
+    // frames are kept for as long as they can overlap with a frame still on the air
+    uint64_t now_us = mr_host_now_us();
+    for (size_t i = 0; i < _medium_vars.frames_size; i++) {
+        sim_frame_t *frame = &_medium_vars.frames[i];
+        if (frame->in_use && frame->end_us + SIM_FRAME_MAX_DURATION_US < now_us) {
+            frame->in_use = false;
+        }
+    }
+
+    for (size_t i = 0; i < _medium_vars.frames_size; i++) {
+        if (!_medium_vars.frames[i].in_use) {
+            _medium_vars.frames[i].in_use = true;
+            *frame_idx                    = i;
+            return &_medium_vars.frames[i];
+        }
+    }
+
+    size_t new_size     = _medium_vars.frames_size ? _medium_vars.frames_size * 2 : 64;
+    _medium_vars.frames = realloc(_medium_vars.frames, new_size * sizeof(sim_frame_t));
+    assert(_medium_vars.frames);
+    memset(&_medium_vars.frames[_medium_vars.frames_size], 0, (new_size - _medium_vars.frames_size) * sizeof(sim_frame_t));
+    *frame_idx                = _medium_vars.frames_size;
+    _medium_vars.frames_size  = new_size;
+    sim_frame_t *frame        = &_medium_vars.frames[*frame_idx];
+    frame->in_use             = true;
+    return frame;
+}
+
+static double _rssi(const sim_frame_t *frame, sim_device_t *receiver) {
+    const sim_config_t *config = _medium_vars.config;
+    uint64_t            now_us = mr_host_now_us();
+
+    sim_position_t a        = sim_mobility_position(frame->sender, now_us);
+    sim_position_t b        = sim_mobility_position(receiver, now_us);
+    double         distance = fmax(hypot(a.x - b.x, a.y - b.y), 1.0);
+
+    // log-distance path loss, with a fading drawn once per frame and receiver
+    double path_loss = config->path_loss_d0_db + 10 * config->path_loss_exp * log10(distance);
+    double fading    = config->fading_sigma_db * sim_random_gaussian(frame->seq * _medium_vars.n_devices + receiver->index);
+    return config->tx_power_dbm - path_loss + fading;
+}
+
+static bool _overlaps(const sim_frame_t *a, const sim_frame_t *b) {
+    return a->start_us < b->end_us && b->start_us < a->end_us;
+}
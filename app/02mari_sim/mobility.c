@@ -0,0 +1,59 @@
+/**
+ * @file
+ * @ingroup     app_sim
+ *
+ * @brief       Random waypoint mobility
+ *
+ * A moving device goes in a straight line, at constant speed, to a waypoint
+ * drawn uniformly in the deployment area, then draws the next one. Positions
+ * are only computed when needed, by interpolating between waypoints.
+ *
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <math.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+//=========================== variables ========================================
+
+static const sim_config_t *_config = NULL;
+
+//=========================== public ===========================================
+
+void sim_mobility_init(const sim_config_t *config) {
+    _config = config;
+}
+
+void sim_mobility_place(sim_device_t *device, sim_position_t position, bool moving) {
+    sim_mobility_t *mobility = &device->mobility;
+    mobility->from           = position;
+    mobility->to             = position;
+    mobility->from_us        = 0;
+    // static devices never reach their waypoint
+    mobility->arrive_us = moving && _config->speed_mps > 0 ? 0 : UINT64_MAX;
+}
+
+sim_position_t sim_mobility_position(sim_device_t *device, uint64_t now_us) {
+    sim_mobility_t *mobility = &device->mobility;
+    if (mobility->arrive_us == UINT64_MAX) {
+        return mobility->from;
+    }
+
+    while (now_us >= mobility->arrive_us) {
+        // reached the waypoint, draw the next one
+        mobility->from      = mobility->to;
+        mobility->from_us   = mobility->arrive_us;
+        mobility->to        = (sim_position_t){ sim_random_uniform() * _config->area_m, sim_random_uniform() * _config->area_m };
+        double distance_m   = hypot(mobility->to.x - mobility->from.x, mobility->to.y - mobility->from.y);
+        mobility->arrive_us = mobility->from_us + (uint64_t)(distance_m / _config->speed_mps * 1e6) + 1;
+    }
+
+    double progress = (double)(now_us - mobility->from_us) / (mobility->arrive_us - mobility->from_us);
+    return (sim_position_t){
+        mobility->from.x + (mobility->to.x - mobility->from.x) * progress,
+        mobility->from.y + (mobility->to.y - mobility->from.y) * progress,
+    };
+}
@@ -0,0 +1,56 @@
+/**
+ * @file
+ * @ingroup     app_sim
+ *
+ * @brief       Reproducible random numbers for the simulator
+ *
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <math.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+//=========================== variables ========================================
+
+static uint64_t _random_seed  = 0;
+static uint64_t _random_state = 0;
+
+//=========================== prototypes =======================================
+
+static uint64_t _splitmix64(uint64_t *state);
+
+//=========================== public ===========================================
+
+void sim_random_seed(uint64_t seed) {
+    _random_seed  = seed;
+    _random_state = seed;
+}
+
+uint64_t sim_random_u64(void) {
+    return _splitmix64(&_random_state);
+}
+
+double sim_random_uniform(void) {
+    // 53 random bits, in [0, 1)
+    return (sim_random_u64() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double sim_random_gaussian(uint64_t key) {
+    // derived from the key only, so that the same value is drawn each time for the same key
+    uint64_t state = key ^ (_random_seed * 0x9E3779B97F4A7C15ULL);
+    double   u1    = ((_splitmix64(&state) >> 11) + 1) * (1.0 / 9007199254740993.0);
+    double   u2    = (_splitmix64(&state) >> 11) * (1.0 / 9007199254740992.0);
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+//=========================== private ==========================================
+
+static uint64_t _splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z          = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z          = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
@@ -0,0 +1,112 @@
+#ifndef __SIM_H
+#define __SIM_H
+
+/**
+ * @defgroup    app_sim     Mari network simulator
+ * @ingroup     app
+ * @brief       Many gateways and nodes running the mari stack over a simulated BLE medium
+ *
+ * @{
+ * @file
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "mr_host.h"
+#include "models.h"
+#include "mari.h"
+
+//=========================== defines ==========================================
+
+#define SIM_MAX_DEVICES (4096)
+
+typedef struct {
+    // network
+    size_t            n_gateways;
+    size_t            n_nodes;
+    uint32_t          duration_s;
+    uint32_t          boot_spread_ms;  ///< Devices are powered on at random times in [0, boot_spread_ms]
+    const schedule_t *schedule;        ///< Schedule used by the gateways
+    uint64_t          seed;
+
+    // traffic
+    uint32_t uplink_period_ms;    ///< Each joined node sends a data packet with this period, 0 to disable
+    uint32_t downlink_period_ms;  ///< Each gateway sends a data packet to one of its nodes with this period, 0 to disable
+    uint32_t bulk_image_kb;       ///< Each gateway sends an image of this size to all its nodes, 0 to disable
+
+    // radio
+    double area_m;           ///< Side of the square where devices are deployed
+    double tx_power_dbm;     ///< Transmit power of all devices
+    double path_loss_d0_db;  ///< Path loss at 1 m
+    double path_loss_exp;    ///< Path loss exponent
+    double fading_sigma_db;  ///< Standard deviation of the log-normal fading, drawn per frame and receiver
+    double sensitivity_dbm;  ///< Frames received below this power are not detected
+    double noise_floor_dbm;  ///< Frames received below this power do not interfere
+    double capture_db;       ///< Minimum signal to interference ratio to decode a frame
+    uint32_t capture_window_us;  ///< Frames starting this close to each other compete for the receiver lock
+    uint64_t jammed_channels;    ///< Bit set for each BLE channel on which no frame can be decoded
+    uint16_t clock_ppm;          ///< The crystal of each device deviates by up to this much, drawn uniformly
+
+    // mobility
+    double speed_mps;  ///< Node speed, 0 for static nodes (random waypoint model)
+} sim_config_t;
+
+typedef struct {
+    double x;
+    double y;
+} sim_position_t;
+
+typedef struct {
+    sim_position_t from;      ///< Position at `from_us`
+    sim_position_t to;        ///< Current waypoint
+    uint64_t       from_us;   ///< Time at which the device left `from`
+    uint64_t       arrive_us; ///< Time at which the device reaches `to`
+} sim_mobility_t;
+
+typedef struct {
+    uint64_t frames;         ///< Frames transmitted
+    uint64_t receptions;     ///< Frames a receiver locked on
+    uint64_t received;       ///< Frames decoded without errors
+    uint64_t collisions;     ///< Frames lost because of interference
+    uint64_t jammed;         ///< Frames lost because they were sent on a jammed channel
+} sim_medium_stats_t;
+
+typedef struct {
+    mr_host_device_t device;     ///< Emulated chip, device.ctx points back to this structure
+    size_t           index;      ///< Position in the device list
+    mr_node_type_t   node_type;  ///< Gateway or node
+    bool             booted;     ///< Whether mari_init was called
+    mari_ctx_t      *mari;       ///< Mari instance running on this device
+    sim_mobility_t   mobility;
+
+    // node state used for the statistics
+    bool     connected;
+    bool     joined_once;         ///< Tells first joins apart from rejoins
+    uint64_t gateway_id;
+    uint64_t searching_since_us;  ///< Since when the node is looking for a gateway
+    bool     bulk_complete;       ///< Whether the node has the whole image of the bulk transfer
+} sim_device_t;
+
+//=========================== prototypes =======================================
+
+// medium
+void                     sim_medium_init(const sim_config_t *config, sim_device_t *devices, size_t n_devices);
+const sim_medium_stats_t *sim_medium_stats(void);
+
+// mobility
+void           sim_mobility_init(const sim_config_t *config);
+void           sim_mobility_place(sim_device_t *device, sim_position_t position, bool moving);
+sim_position_t sim_mobility_position(sim_device_t *device, uint64_t now_us);
+
+// random numbers, shared by all the simulator modules
+void     sim_random_seed(uint64_t seed);
+uint64_t sim_random_u64(void);
+double   sim_random_uniform(void);
+double   sim_random_gaussian(uint64_t key);
+
+#endif  // __SIM_H
@@ -41,6 +41,7 @@ typedef struct {
     bool            mari_event_ready;
     bool            uart_to_radio_packet_ready;
     bool            to_uart_gateway_loop_ready;
+    bool            queue_saturated;  // between MARI_QUEUE_HIGH and MARI_QUEUE_LOW, packets from the application core are left in IPC
     uint32_t        tx_count;
     uint32_t        rx_count;
 } gateway_vars_t;
@@ -54,12 +55,17 @@ typedef struct {
 
 gateway_vars_t _app_vars = { 0 };
 
-extern schedule_t schedule_tiny, schedule_medium, schedule_big, schedule_huge;
-schedule_t       *schedule_app = &schedule_huge;
+extern const schedule_t schedule_tiny, schedule_medium, schedule_big, schedule_huge;
+const schedule_t       *schedule_app = &schedule_huge;
 
 volatile __attribute__((section(".shared_data"))) ipc_shared_data_t ipc_shared_data;
 
 static void _mari_event_callback(mr_event_t event, mr_event_data_t event_data) {
+    if (event == MARI_QUEUE_HIGH || event == MARI_QUEUE_LOW) {
+        // handled right away, so that it is not overwritten by another event
+        _app_vars.queue_saturated = event == MARI_QUEUE_HIGH;
+        return;
+    }
     _app_vars.mari_event = event;
     memcpy(&_app_vars.mari_event_data, &event_data, sizeof(mr_event_data_t));
     _app_vars.mari_event_ready = true;
@@ -161,7 +167,7 @@ int main(void) {
             }
         }
 
-        if (_app_vars.uart_to_radio_packet_ready) {
+        if (_app_vars.uart_to_radio_packet_ready && !_app_vars.queue_saturated) {
             _app_vars.uart_to_radio_packet_ready = false;
             uint8_t packet_type                  = ipc_shared_data.uart_to_radio_tx[0];
             if (packet_type != MARI_EDGE_DATA) {
@@ -13,6 +13,7 @@
 
 #include "mr_radio.h"
 #include "mac.h"
+#include "scheduler.h"
 #include "models.h"
 
 #include "metrics.h"
@@ -28,23 +29,27 @@ typedef struct {
 //=========================== variables ========================================
 
 typedef struct {
-    node_metrics_t nodes[MARI_N_CELLS_MAX];
+    node_metrics_t nodes[MARI_N_CELLS_MAX];  // indexed by the uplink index of the node, which a schedule switch keeps
 } metrics_vars_t;
 
 metrics_vars_t metrics_vars = { 0 };
 
+//=========================== prototypes =======================================
+
+static node_metrics_t *_get_node(uint64_t node_id);
+
 //=========================== functions ========================================
 
 void metrics_init(void) {
 }
 
 void metrics_add_node(uint64_t node_id) {
-    for (uint8_t i = 0; i < MARI_N_CELLS_MAX; i++) {
-        if (metrics_vars.nodes[i].node_id == 0) {
-            metrics_vars.nodes[i].node_id = node_id;
-            break;
-        }
+    int16_t uplink_index = mr_scheduler_gateway_get_node_uplink_index(node_id);
+    if (uplink_index < 0 || metrics_vars.nodes[uplink_index].node_id == node_id) {
+        // not joined, or joined again to the same cell
+        return;
     }
+    metrics_vars.nodes[uplink_index] = (node_metrics_t){ .node_id = node_id };
 }
 
 void metrics_clear_node(uint64_t node_id) {
@@ -68,11 +73,9 @@ void metrics_handle_rx_probe(uint64_t node_id, uint8_t *payload) {
     metrics_payload->gw_rx_asn  = mr_mac_get_asn();
     metrics_payload->rssi_at_gw = mr_radio_rssi();
 
-    for (uint8_t i = 0; i < MARI_N_CELLS_MAX; i++) {
-        if (metrics_vars.nodes[i].node_id == node_id) {
-            metrics_payload->gw_rx_count = ++metrics_vars.nodes[i].rx_count;
-            break;
-        }
+    node_metrics_t *node = _get_node(node_id);
+    if (node) {
+        metrics_payload->gw_rx_count = ++node->rx_count;
     }
 }
 
@@ -81,10 +84,19 @@ void metrics_handle_tx_probe(uint64_t node_id, uint8_t *payload) {
 
     metrics_payload->gw_tx_enqueued_asn = mr_mac_get_asn();
 
-    for (uint8_t i = 0; i < MARI_N_CELLS_MAX; i++) {
-        if (metrics_vars.nodes[i].node_id == node_id) {
-            metrics_payload->gw_tx_count = ++metrics_vars.nodes[i].tx_count;
-            break;
-        }
+    node_metrics_t *node = _get_node(node_id);
+    if (node) {
+        metrics_payload->gw_tx_count = ++node->tx_count;
+    }
+}
+
+//=========================== private ==========================================
+
+static node_metrics_t *_get_node(uint64_t node_id) {
+    // the node is found through its cell, instead of searching all the entries
+    int16_t uplink_index = mr_scheduler_gateway_get_node_uplink_index(node_id);
+    if (uplink_index < 0 || metrics_vars.nodes[uplink_index].node_id != node_id) {
+        return NULL;
     }
+    return &metrics_vars.nodes[uplink_index];
 }
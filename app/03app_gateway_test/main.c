@@ -43,9 +43,9 @@ uint8_t packet[MARI_PACKET_MAX_SIZE] = { 0 };
 uint8_t payload[]                    = { 0xFA, 0xFA, 0xFA, 0xFA, 0xFA };
 uint8_t payload_len                  = 5;
 
-extern schedule_t schedule_minuscule, schedule_tiny, schedule_huge;
+extern const schedule_t schedule_minuscule, schedule_tiny, schedule_huge;
 
-schedule_t *schedule_app = &schedule_huge;
+const schedule_t *schedule_app = &schedule_huge;
 
 //=========================== prototypes =======================================
 
@@ -30,6 +30,8 @@
 
 #define MARI_APP_TIMER_DEV 1
 
+#define MARI_APP_RX_PACKETS 4  // received packets kept until the main loop handles them, an aggregated packet gives several at once
+
 // -2 is for the type and needs_ack fields
 #define DEFAULT_PAYLOAD_SIZE MARI_PACKET_MAX_SIZE - sizeof(mr_packet_header_t) - 2
 
@@ -38,12 +40,21 @@ typedef struct __attribute__((packed)) {
     uint8_t value[DEFAULT_PAYLOAD_SIZE];
 } default_payload_t;
 
+typedef struct {
+    uint8_t len;
+    uint8_t buffer[MARI_PACKET_MAX_SIZE];
+} rx_packet_t;
+
 typedef struct {
     mr_event_t      event;
     mr_event_data_t event_data;
     bool            event_ready;
+    rx_packet_t     rx_packets[MARI_APP_RX_PACKETS];
+    uint8_t         rx_head;  // next packet to handle, written by the main loop
+    uint8_t         rx_tail;  // next free spot, written by the event callback
     bool            led_blink_state;  // for blinking when not connected
     bool            send_status_ready;
+    bool            queue_saturated;  // between MARI_QUEUE_HIGH and MARI_QUEUE_LOW, status packets are skipped
 } node_vars_t;
 
 typedef struct __attribute__((packed)) {
@@ -57,8 +68,8 @@ typedef struct __attribute__((packed)) {
 node_vars_t  node_vars  = { 0 };
 node_stats_t node_stats = { 0 };
 
-extern schedule_t schedule_minuscule, schedule_tiny, schedule_huge;
-schedule_t       *schedule_app = &schedule_huge;
+extern const schedule_t schedule_minuscule, schedule_tiny, schedule_huge;
+const schedule_t       *schedule_app = &schedule_huge;
 
 // example status packet, to use as periodic uplink packet
 uint8_t status_packet_mock[4] = {
@@ -79,6 +90,24 @@ static void _led_blink_callback(void) {
 }
 
 static void mari_event_callback(mr_event_t event, mr_event_data_t event_data) {
+    if (event == MARI_QUEUE_HIGH || event == MARI_QUEUE_LOW) {
+        // handled right away, so that it is not overwritten by another event
+        node_vars.queue_saturated = event == MARI_QUEUE_HIGH;
+        return;
+    }
+    if (event == MARI_NEW_PACKET) {
+        // copied right away, the received packet is overwritten by the next one
+        uint8_t next = (node_vars.rx_tail + 1) % MARI_APP_RX_PACKETS;
+        if (next == node_vars.rx_head) {
+            printf("Received packet dropped\n");
+            return;
+        }
+        rx_packet_t *rx_packet = &node_vars.rx_packets[node_vars.rx_tail];
+        rx_packet->len         = event_data.data.new_packet.len;
+        memcpy(rx_packet->buffer, event_data.data.new_packet.header, rx_packet->len);
+        node_vars.rx_tail = next;
+        return;
+    }
     memcpy(&node_vars.event, &event, sizeof(mr_event_t));
     memcpy(&node_vars.event_data, &event_data, sizeof(mr_event_data_t));
     node_vars.event_ready = true;
@@ -124,6 +153,19 @@ int main(void) {
         __WFE();
         __WFE();
 
+        while (node_vars.rx_head != node_vars.rx_tail) {
+            rx_packet_t *rx_packet   = &node_vars.rx_packets[node_vars.rx_head];
+            uint8_t     *payload     = rx_packet->buffer + sizeof(mr_packet_header_t);
+            uint8_t      payload_len = rx_packet->len - sizeof(mr_packet_header_t);
+
+            if (payload_len == sizeof(mr_metrics_payload_t) && payload[0] == MARI_PAYLOAD_TYPE_METRICS_PROBE) {
+                handle_metrics_payload((mr_metrics_payload_t *)payload);
+            } else {
+                // TBD custom application logic
+            }
+            node_vars.rx_head = (node_vars.rx_head + 1) % MARI_APP_RX_PACKETS;
+        }
+
         if (node_vars.event_ready) {
             node_vars.event_ready = false;
 
@@ -131,18 +173,6 @@ int main(void) {
             mr_event_data_t event_data = node_vars.event_data;
 
             switch (event) {
-                case MARI_NEW_PACKET:
-                {
-                    mari_packet_t packet = event_data.data.new_packet;
-
-                    if (packet.payload_len == sizeof(mr_metrics_payload_t) && packet.payload[0] == MARI_PAYLOAD_TYPE_METRICS_PROBE) {
-                        handle_metrics_payload((mr_metrics_payload_t *)packet.payload);
-                    } else {
-                        // TBD custom application logic
-                    }
-
-                    break;
-                }
                 case MARI_CONNECTED:
                 {
                     uint64_t gateway_id = event_data.data.gateway_info.gateway_id;
@@ -164,7 +194,10 @@ int main(void) {
 
         if (node_vars.send_status_ready) {
             node_vars.send_status_ready = false;
-            mari_node_tx_payload((uint8_t *)status_packet_mock, sizeof(status_packet_mock));
+            // a newer status will be sent once the queue drained, rather than one more stale status now
+            if (!node_vars.queue_saturated && mari_node_tx_payload((uint8_t *)status_packet_mock, sizeof(status_packet_mock)) != MARI_TX_OK) {
+                printf("Status packet dropped\n");
+            }
         }
 
         mari_event_loop();
@@ -69,10 +69,6 @@ typedef struct {
     uint8_t pin;   ///< Pin number of the GPIO
 } mr_gpio_t;
 
-//=========================== variables ========================================
-
-static NRF_GPIO_Type *mr_nrf_port[2] = { NRF_P0, NRF_P1 };
-
 //============================ public ==========================================
 
 /**
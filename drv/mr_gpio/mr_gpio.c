@@ -31,7 +31,8 @@ typedef struct {
 
 //=========================== variables ========================================
 
-static gpio_vars_t _gpio_vars;
+static NRF_GPIO_Type *mr_nrf_port[2] = { NRF_P0, NRF_P1 };
+static gpio_vars_t    _gpio_vars;
 
 //=========================== public ===========================================
 
@@ -0,0 +1,51 @@
+/**
+ * @file
+ * @ingroup bsp_gpio
+ *
+ * @brief  Host definition of the "gpio" bsp module.
+ *
+ * Output levels are kept in memory (see mr_host_gpio_ports), which is enough
+ * for the debug pins and LEDs driven by the mari core. Interrupts never fire.
+ *
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <stdint.h>
+
+#include "mr_gpio.h"
+
+//=========================== variables ========================================
+
+static NRF_GPIO_Type *mr_nrf_port[2] = { NRF_P0, NRF_P1 };
+
+//=========================== public ===========================================
+
+void mr_gpio_init(const mr_gpio_t *gpio, mr_gpio_mode_t mode) {
+    if (mode == MR_GPIO_OUT) {
+        mr_nrf_port[gpio->port]->DIRSET |= (1UL << gpio->pin);
+    }
+}
+
+void mr_gpio_init_irq(const mr_gpio_t *gpio, mr_gpio_mode_t mode, mr_gpio_irq_edge_t edge, gpio_cb_t callback, void *ctx) {
+    (void)edge;
+    (void)callback;
+    (void)ctx;
+    mr_gpio_init(gpio, mode);
+}
+
+void mr_gpio_set(const mr_gpio_t *gpio) {
+    mr_nrf_port[gpio->port]->OUT |= (1UL << gpio->pin);
+}
+
+void mr_gpio_clear(const mr_gpio_t *gpio) {
+    mr_nrf_port[gpio->port]->OUT &= ~(1UL << gpio->pin);
+}
+
+void mr_gpio_toggle(const mr_gpio_t *gpio) {
+    mr_nrf_port[gpio->port]->OUT ^= (1UL << gpio->pin);
+}
+
+uint8_t mr_gpio_read(const mr_gpio_t *gpio) {
+    return (mr_nrf_port[gpio->port]->OUT >> gpio->pin) & 0x1;
+}
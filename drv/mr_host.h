@@ -0,0 +1,216 @@
+#ifndef __MR_HOST_H
+#define __MR_HOST_H
+
+/**
+ * @defgroup    drv_host    Host (POSIX) driver backend
+ * @ingroup     drv
+ * @brief       Virtual clock and event engine backing the host implementation of the drivers
+ *
+ * On host builds, mr_timer_hf, mr_radio, mr_rng and mr_gpio are implemented on
+ * top of a virtual microsecond clock. Nothing runs in real time: timer and
+ * radio "interrupts" are events in a queue, and the clock jumps from one event
+ * to the next, so a slotframe is simulated much faster than real time.
+ *
+ * Each emulated chip is a mr_host_device_t, holding its FICR, TIMER, RADIO and
+ * RNG state. Events are always dispatched with their device selected, which is
+ * what the driver functions (and mr_device_id()) operate on. A default device
+ * is selected at startup, so single-device programs need no setup at all.
+ *
+ * Radio frames only leave a device through the medium hooks, see
+ * mr_host_set_medium(). Without a medium, transmitted frames are lost.
+ *
+ * @{
+ * @file
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <nrf.h>
+#include <nrf_peripherals.h>
+
+#include "mr_radio.h"
+#include "mr_timer_hf.h"
+
+//=========================== defines ==========================================
+
+#define MR_HOST_TIMER_CHANNELS         (6U)   ///< Number of CC channels per TIMER, last one is used for delays
+#define MR_HOST_TIMER_DEV_RADIO        (2U)   ///< TIMER used to timestamp radio events, same as in RADIO_IRQHandler
+#define MR_HOST_RADIO_ADDRESS_DELAY_US (59U)  ///< From TASKS_START to EVENTS_ADDRESS, measured with a logic analyzer (see fix_drift in mac.c)
+#define MR_HOST_RADIO_US_PER_BYTE      (4U)   ///< BLE 2M PHY
+#define MR_HOST_RADIO_OVERHEAD_BYTES   (5U)   ///< S0 + LENGTH fields and 3 bytes of CRC, sent after the address
+
+#define MR_HOST_DEFAULT_DEVICE_ID 0x0000000000000001ULL  ///< Device ID of the device selected at startup
+
+typedef struct mr_host_device mr_host_device_t;
+
+typedef void (*mr_host_event_cb_t)(mr_host_device_t *device, uintptr_t arg);  ///< Event callback, called with `device` selected
+typedef void (*mr_host_switch_cb_t)(mr_host_device_t *from, mr_host_device_t *to);  ///< Called when another device gets selected
+
+typedef struct {
+    uint32_t      cc;          ///< Compare value, in timer ticks (us)
+    uint32_t      period_us;   ///< Reload value for periodic channels
+    bool          one_shot;    ///< Whether the channel is disarmed after firing
+    bool          armed;       ///< Whether the compare interrupt is enabled
+    timer_hf_cb_t callback;    ///< Function called when the channel fires
+    uint32_t      generation;  ///< Incremented each time the channel is re-programmed, so stale events are dropped
+} mr_host_timer_channel_t;
+
+typedef struct {
+    bool                    running;    ///< Whether a delay is running
+    uint64_t                origin_us;  ///< Host time at which the timer was cleared and started
+    mr_host_timer_channel_t channels[MR_HOST_TIMER_CHANNELS];
+} mr_host_timer_t;
+
+typedef struct {
+    radio_ts_packet_t start_pac_cb;                        ///< Called on EVENTS_ADDRESS
+    radio_ts_packet_t end_pac_cb;                          ///< Called on EVENTS_END
+    uint8_t           state;                               ///< Same encoding as in the nRF driver (IDLE, RX, TX, BUSY)
+    uint8_t           frequency;                           ///< Radio frequency, 2400 + frequency (MHz)
+    uint8_t           length;                              ///< Length of the PDU payload
+    uint8_t           payload[MR_BLE_PAYLOAD_MAX_LENGTH];  ///< PDU payload, either to send or just received
+    bool              pending_rx_read;                     ///< Whether a received PDU was not read yet
+    int8_t            rssi;                                ///< RSSI of the last received frame
+    uint32_t          generation;                          ///< Incremented when the radio is disabled, so in-flight events are dropped
+    uint32_t          rx_lock;                             ///< Identifier of the frame the receiver is locked on
+    uint64_t          rx_on_us;                            ///< Host time at which the receiver was turned on
+    uint64_t          rx_us;                               ///< Time spent with the receiver on, since mr_radio_init
+} mr_host_radio_t;
+
+struct mr_host_device {
+    NRF_FICR_Type   ficr;                 ///< Holds the device ID returned by mr_device_id()
+    mr_host_timer_t timers[TIMER_COUNT];  ///< TIMER peripherals
+    mr_host_radio_t radio;                ///< RADIO peripheral
+    uint32_t        rng_state;            ///< State of the pseudo random generator
+    int16_t         clock_ppm;            ///< Deviation of the crystal, the timers count 1 + clock_ppm / 10^6 ticks per us
+    void           *ctx;                  ///< Free to use by the application, e.g. to attach per-device data
+};
+
+/// Hooks connecting the radios of all devices to a shared medium
+typedef struct {
+    /// A device started to transmit a frame on a given frequency, called at TASKS_START
+    void (*tx)(mr_host_device_t *device, uint8_t frequency, const uint8_t *packet, uint8_t length);
+    /// A device started listening on a given frequency
+    void (*rx)(mr_host_device_t *device, uint8_t frequency);
+} mr_host_medium_t;
+
+//=========================== prototypes =======================================
+
+/**
+ * @brief Reset a device to its power-on state
+ *
+ * @param[out] device       Device to initialize
+ * @param[in]  device_id    64-bit unique identifier, as returned by mr_device_id()
+ */
+void mr_host_device_init(mr_host_device_t *device, uint64_t device_id);
+
+/**
+ * @brief Select the device the driver functions operate on
+ *
+ * @param[in] device        Device to select
+ */
+void mr_host_device_select(mr_host_device_t *device);
+
+/**
+ * @brief Return the device currently selected
+ */
+mr_host_device_t *mr_host_device_current(void);
+
+/**
+ * @brief Set a function called each time the selected device changes
+ *
+ * Useful to swap state that is not held in mr_host_device_t, e.g. the
+ * firmware variables of the device.
+ *
+ * @param[in] switch_cb     Function to call, or NULL
+ */
+void mr_host_set_switch_callback(mr_host_switch_cb_t switch_cb);
+
+/**
+ * @brief Connect the radios to a medium, or disconnect them when `medium` is NULL
+ *
+ * @param[in] medium        Medium hooks, must remain valid while in use
+ */
+void mr_host_set_medium(const mr_host_medium_t *medium);
+
+/**
+ * @brief Return the medium the radios are connected to, NULL if none
+ */
+const mr_host_medium_t *mr_host_get_medium(void);
+
+/**
+ * @brief Return the current value of the virtual clock, in microseconds
+ */
+uint64_t mr_host_now_us(void);
+
+/**
+ * @brief Schedule a callback at an absolute time of the virtual clock
+ *
+ * Events scheduled at the same time are run in the order they were scheduled.
+ *
+ * @param[in] at_us         Absolute time, in microseconds, cannot be in the past
+ * @param[in] device        Device selected while the callback runs, or NULL to keep the current one
+ * @param[in] cb            Callback function
+ * @param[in] arg           Argument given to the callback
+ */
+void mr_host_schedule_at(uint64_t at_us, mr_host_device_t *device, mr_host_event_cb_t cb, uintptr_t arg);
+
+/**
+ * @brief Advance the virtual clock to the next event and run it
+ *
+ * @return false if there was no event left to run
+ */
+bool mr_host_step(void);
+
+/**
+ * @brief Run all events up to a given time, then set the clock to that time
+ *
+ * @param[in] until_us      Absolute time, in microseconds
+ */
+void mr_host_run_until(uint64_t until_us);
+
+/**
+ * @brief Compute the time between EVENTS_ADDRESS and EVENTS_END for a given payload length
+ *
+ * @param[in] length        Payload length in bytes
+ */
+uint32_t mr_host_radio_toa_us(uint8_t length);
+
+/**
+ * @brief Frequency that mr_radio_set_channel sets for a BLE channel
+ *
+ * @param[in] channel       BLE channel, 0 to 39
+ */
+uint8_t mr_host_radio_channel_frequency(uint8_t channel);
+
+/**
+ * @brief Whether a device is listening and not yet locked on a frame, on a given frequency
+ */
+bool mr_host_radio_is_listening(const mr_host_device_t *device, uint8_t frequency);
+
+/**
+ * @brief Feed the address of an incoming frame to the selected device (EVENTS_ADDRESS)
+ *
+ * Must be called from an event dispatched to the receiving device.
+ *
+ * @param[in] packet        Frame payload
+ * @param[in] length        Frame payload length
+ * @param[in] rssi          RSSI of the frame, in dBm
+ *
+ * @return an identifier to give to mr_host_radio_frame_end, 0 if the radio was not listening
+ */
+uint32_t mr_host_radio_frame_start(const uint8_t *packet, uint8_t length, int8_t rssi);
+
+/**
+ * @brief Feed the end of an incoming frame to the selected device (EVENTS_END)
+ *
+ * Must be called from an event dispatched to the receiving device.
+ *
+ * @param[in] frame_id      Identifier returned by mr_host_radio_frame_start
+ * @param[in] crc_ok        Whether the frame was received without errors
+ */
+void mr_host_radio_frame_end(uint32_t frame_id, bool crc_ok);
+
+#endif  // __MR_HOST_H
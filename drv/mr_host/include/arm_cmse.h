@@ -0,0 +1,15 @@
+#ifndef __MR_HOST_ARM_CMSE_H
+#define __MR_HOST_ARM_CMSE_H
+
+/**
+ * @ingroup     drv_host_nrf
+ * @brief       Empty replacement of the CMSE header for host builds
+ *
+ * @{
+ * @file
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#endif  // __MR_HOST_ARM_CMSE_H
@@ -0,0 +1,53 @@
+#ifndef __MR_HOST_NRF_H
+#define __MR_HOST_NRF_H
+
+/**
+ * @defgroup    drv_host_nrf    nRF register stand-ins for host builds
+ * @ingroup     drv_host
+ * @brief       Minimal replacement of the vendor `nrf.h` header for host builds
+ *
+ * Only the registers that are read directly from headers shared with the
+ * firmware (e.g. mr_device.h and mr_gpio.h) are provided. They are backed by
+ * the state of the currently selected host device.
+ *
+ * @{
+ * @file
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+
+//=========================== defines ==========================================
+
+typedef struct {
+    volatile uint32_t DEVICEID[2];    ///< Device identifier
+    volatile uint32_t DEVICEADDR[2];  ///< Device address
+} NRF_FICR_Type;
+
+typedef struct {
+    volatile uint32_t OUT;     ///< Write GPIO port
+    volatile uint32_t OUTSET;  ///< Set individual bits in GPIO port
+    volatile uint32_t OUTCLR;  ///< Clear individual bits in GPIO port
+    volatile uint32_t IN;      ///< Read GPIO port
+    volatile uint32_t DIRSET;  ///< Direction set register
+} NRF_GPIO_Type;
+
+#define GPIOTE_CONFIG_POLARITY_LoToHi (1UL)
+#define GPIOTE_CONFIG_POLARITY_HiToLo (2UL)
+#define GPIOTE_CONFIG_POLARITY_Toggle (3UL)
+
+//=========================== variables ========================================
+
+extern NRF_GPIO_Type mr_host_gpio_ports[2];
+
+//=========================== prototypes =======================================
+
+NRF_FICR_Type *mr_host_ficr(void);
+
+#define NRF_FICR (mr_host_ficr())
+#define NRF_P0   (&mr_host_gpio_ports[0])
+#define NRF_P1   (&mr_host_gpio_ports[1])
+
+#endif  // __MR_HOST_NRF_H
@@ -0,0 +1,17 @@
+#ifndef __MR_HOST_NRF_PERIPHERALS_H
+#define __MR_HOST_NRF_PERIPHERALS_H
+
+/**
+ * @ingroup     drv_host_nrf
+ * @brief       Replacement of the vendor `nrf_peripherals.h` header for host builds
+ *
+ * @{
+ * @file
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#define TIMER_COUNT 3  ///< Same number of TIMER instances as the nRF5340 network core
+
+#endif  // __MR_HOST_NRF_PERIPHERALS_H
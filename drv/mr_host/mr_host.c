@@ -0,0 +1,211 @@
+/**
+ * @file
+ * @ingroup drv_host
+ *
+ * @brief  Virtual clock and event engine for host builds.
+ *
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mr_host.h"
+
+//=========================== defines ==========================================
+
+#define HOST_EVENT_QUEUE_INITIAL_SIZE (256U)
+
+typedef struct {
+    uint64_t           at_us;   ///< Time at which the event runs
+    uint64_t           seq;     ///< Insertion order, to break ties deterministically
+    mr_host_device_t  *device;  ///< Device selected while the event runs
+    mr_host_event_cb_t cb;      ///< Event callback
+    uintptr_t          arg;     ///< Argument given to the callback
+} host_event_t;
+
+typedef struct {
+    uint64_t               now_us;          ///< Virtual clock
+    uint64_t               seq;             ///< Counter of scheduled events
+    host_event_t          *events;          ///< Binary min-heap of pending events
+    size_t                 events_len;      ///< Number of pending events
+    size_t                 events_size;     ///< Allocated size of the heap
+    mr_host_device_t      *current_device;  ///< Device the drivers operate on
+    mr_host_switch_cb_t    switch_cb;       ///< Called when the current device changes
+    const mr_host_medium_t *medium;         ///< Medium connecting the radios
+} host_vars_t;
+
+//=========================== variables ========================================
+
+NRF_GPIO_Type mr_host_gpio_ports[2] = { 0 };
+
+static mr_host_device_t _default_device = {
+    .ficr = {
+        .DEVICEID = { (uint32_t)MR_HOST_DEFAULT_DEVICE_ID, (uint32_t)(MR_HOST_DEFAULT_DEVICE_ID >> 32) },
+    },
+    .rng_state = (uint32_t)MR_HOST_DEFAULT_DEVICE_ID,
+};
+
+static host_vars_t _host_vars = {
+    .current_device = &_default_device,
+};
+
+//=========================== prototypes =======================================
+
+static bool _event_before(const host_event_t *a, const host_event_t *b);
+static void _heap_push(host_event_t event);
+static host_event_t _heap_pop(void);
+static void         _switch_device(mr_host_device_t *device);
+
+//=========================== public ===========================================
+
+void mr_host_device_init(mr_host_device_t *device, uint64_t device_id) {
+    memset(device, 0, sizeof(mr_host_device_t));
+    device->ficr.DEVICEID[0]   = (uint32_t)device_id;
+    device->ficr.DEVICEID[1]   = (uint32_t)(device_id >> 32);
+    device->ficr.DEVICEADDR[0] = (uint32_t)device_id;
+    device->ficr.DEVICEADDR[1] = (uint32_t)(device_id >> 32) & 0xffff;
+    // xorshift32 must not be seeded with 0
+    device->rng_state = (uint32_t)(device_id ^ (device_id >> 32)) | 1;
+}
+
+void mr_host_device_select(mr_host_device_t *device) {
+    assert(device);
+    _switch_device(device);
+}
+
+mr_host_device_t *mr_host_device_current(void) {
+    return _host_vars.current_device;
+}
+
+void mr_host_set_switch_callback(mr_host_switch_cb_t switch_cb) {
+    _host_vars.switch_cb = switch_cb;
+}
+
+NRF_FICR_Type *mr_host_ficr(void) {
+    return &_host_vars.current_device->ficr;
+}
+
+void mr_host_set_medium(const mr_host_medium_t *medium) {
+    _host_vars.medium = medium;
+}
+
+const mr_host_medium_t *mr_host_get_medium(void) {
+    return _host_vars.medium;
+}
+
+uint64_t mr_host_now_us(void) {
+    return _host_vars.now_us;
+}
+
+void mr_host_schedule_at(uint64_t at_us, mr_host_device_t *device, mr_host_event_cb_t cb, uintptr_t arg) {
+    assert(at_us >= _host_vars.now_us);
+    assert(cb);
+
+    host_event_t event = {
+        .at_us  = at_us,
+        .seq    = _host_vars.seq++,
+        .device = device,
+        .cb     = cb,
+        .arg    = arg,
+    };
+    _heap_push(event);
+}
+
+bool mr_host_step(void) {
+    if (_host_vars.events_len == 0) {
+        return false;
+    }
+
+    host_event_t event = _heap_pop();
+    _host_vars.now_us  = event.at_us;
+
+    // events behave like interrupts: they run on their own device, then the interrupted one resumes
+    mr_host_device_t *interrupted_device = _host_vars.current_device;
+    if (event.device) {
+        _switch_device(event.device);
+    }
+    event.cb(_host_vars.current_device, event.arg);
+    _switch_device(interrupted_device);
+
+    return true;
+}
+
+void mr_host_run_until(uint64_t until_us) {
+    while (_host_vars.events_len > 0 && _host_vars.events[0].at_us <= until_us) {
+        mr_host_step();
+    }
+    if (until_us > _host_vars.now_us) {
+        _host_vars.now_us = until_us;
+    }
+}
+
+//=========================== private ==========================================
+
+static void _switch_device(mr_host_device_t *device) {
+    if (device == _host_vars.current_device) {
+        return;
+    }
+    if (_host_vars.switch_cb) {
+        _host_vars.switch_cb(_host_vars.current_device, device);
+    }
+    _host_vars.current_device = device;
+}
+
+static bool _event_before(const host_event_t *a, const host_event_t *b) {
+    if (a->at_us != b->at_us) {
+        return a->at_us < b->at_us;
+    }
+    return a->seq < b->seq;
+}
+
+static void _heap_push(host_event_t event) {
+    if (_host_vars.events_len == _host_vars.events_size) {
+        _host_vars.events_size = _host_vars.events_size ? _host_vars.events_size * 2 : HOST_EVENT_QUEUE_INITIAL_SIZE;
+        _host_vars.events      = realloc(_host_vars.events, _host_vars.events_size * sizeof(host_event_t));
+        assert(_host_vars.events);
+    }
+
+    // sift up
+    size_t idx = _host_vars.events_len++;
+    while (idx > 0) {
+        size_t parent = (idx - 1) / 2;
+        if (!_event_before(&event, &_host_vars.events[parent])) {
+            break;
+        }
+        _host_vars.events[idx] = _host_vars.events[parent];
+        idx                    = parent;
+    }
+    _host_vars.events[idx] = event;
+}
+
+static host_event_t _heap_pop(void) {
+    host_event_t top  = _host_vars.events[0];
+    host_event_t last = _host_vars.events[--_host_vars.events_len];
+
+    // sift down
+    size_t idx = 0;
+    while (true) {
+        size_t child = 2 * idx + 1;
+        if (child >= _host_vars.events_len) {
+            break;
+        }
+        if (child + 1 < _host_vars.events_len && _event_before(&_host_vars.events[child + 1], &_host_vars.events[child])) {
+            child++;
+        }
+        if (!_event_before(&_host_vars.events[child], &last)) {
+            break;
+        }
+        _host_vars.events[idx] = _host_vars.events[child];
+        idx                    = child;
+    }
+    if (_host_vars.events_len > 0) {
+        _host_vars.events[idx] = last;
+    }
+
+    return top;
+}
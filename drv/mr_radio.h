@@ -41,6 +41,13 @@ typedef enum {
     MR_RADIO_IEEE802154_250Kbit
 } mr_radio_mode_t;
 
+/// Radio PDU, as read and written by the radio with EasyDMA
+typedef struct __attribute__((packed)) {
+    uint8_t header;                              ///< PDU header (depends on the type of PDU - advertising physical channel or Data physical channel)
+    uint8_t length;                              ///< Length of the payload + MIC (if any)
+    uint8_t payload[MR_BLE_PAYLOAD_MAX_LENGTH];  ///< Payload + MIC (if any) (MR_BLE_PAYLOAD_MAX_LENGTH > MR_IEEE802154_PAYLOAD_MAX_LENGTH)
+} mr_radio_pdu_t;
+
 typedef void (*mr_radio_cb_t)(uint8_t *packet, uint8_t length);  ///< get the received packet
 typedef void (*radio_ts_packet_t)(uint32_t ts);                  ///< capture timestamp for start/end of packet
 
@@ -123,10 +130,22 @@ int8_t mr_radio_rssi(void);
  */
 void mr_radio_disable(void);
 
+/**
+ * @brief Whether a packet was received and not read yet; false at the end of a received frame with an invalid CRC
+ */
 bool mr_radio_pending_rx_read(void);
 void mr_radio_get_rx_packet(uint8_t *packet, uint8_t *length);
 
 void mr_radio_tx_prepare(const uint8_t *tx_buffer, uint8_t length);
 void mr_radio_tx_dispatch(void);
 
+/**
+ * @brief Same as mr_radio_tx_prepare, but the radio sends the PDU from where it is, without copying it
+ *
+ * The PDU must stay in RAM, unchanged, until the end of the transmission.
+ *
+ * @param[in] pdu               PDU to send
+ */
+void mr_radio_tx_prepare_pdu(const mr_radio_pdu_t *pdu);
+
 #endif  // __MR_RADIO_H
@@ -45,14 +45,8 @@
 #define RADIO_STATE_TX   0x02
 #define RADIO_STATE_BUSY 0x04
 
-typedef struct __attribute__((packed)) {
-    uint8_t header;                              ///< PDU header (depends on the type of PDU - advertising physical channel or Data physical channel)
-    uint8_t length;                              ///< Length of the payload + MIC (if any)
-    uint8_t payload[MR_BLE_PAYLOAD_MAX_LENGTH];  ///< Payload + MIC (if any) (MR_BLE_PAYLOAD_MAX_LENGTH > MR_IEEE802154_PAYLOAD_MAX_LENGTH)
-} radio_pdu_t;
-
 typedef struct {
-    radio_pdu_t       pdu;              ///< Variable that stores the radio PDU (protocol data unit) that arrives and the radio packets that are about to be sent.
+    mr_radio_pdu_t    pdu;              ///< Variable that stores the radio PDU (protocol data unit) that arrives and the radio packets that are about to be sent.
     bool              pending_rx_read;  ///< Flag to indicate that a PDU has been received, but not yet read by the application.
     radio_ts_packet_t start_pac_cb;     ///< Function pointer, stores the callback to capture the start of the packet.
     radio_ts_packet_t end_pac_cb;       ///< Function pointer, stores the callback to capture the end of the packet.
@@ -79,6 +73,7 @@ static radio_vars_t radio_vars = { 0 };
 //========================== prototypes ========================================
 
 static void _radio_enable(void);
+static void _set_packet_ptr(const mr_radio_pdu_t *pdu);
 
 //=========================== public ===========================================
 
@@ -198,11 +193,7 @@ void mr_radio_init(radio_ts_packet_t start_pac_cb, radio_ts_packet_t end_pac_cb,
     }
 
     // Configure pointer to PDU for EasyDMA
-    if (mode == MR_RADIO_IEEE802154_250Kbit) {
-        NRF_RADIO->PACKETPTR = (uint32_t)((uint8_t *)&radio_vars.pdu + 1);  // Skip header for IEEE 802.15.4
-    } else {
-        NRF_RADIO->PACKETPTR = (uint32_t)&radio_vars.pdu;
-    }
+    _set_packet_ptr(&radio_vars.pdu);
 
     // Assign the callbacks that will be called in the RADIO_IRQHandler
     radio_vars.start_pac_cb = start_pac_cb;
@@ -267,6 +258,9 @@ void mr_radio_rx(void) {
         return;
     }
 
+    // receive into the internal PDU, a transmission may have pointed the radio elsewhere
+    _set_packet_ptr(&radio_vars.pdu);
+
     // enable the radio shorts and interrupts
     NRF_RADIO->SHORTS = RADIO_SHORTS_COMMON | (RADIO_SHORTS_RXREADY_START_Enabled << RADIO_SHORTS_RXREADY_START_Pos);
     _radio_enable();
@@ -279,6 +273,15 @@ void mr_radio_tx_prepare(const uint8_t *tx_buffer, uint8_t length) {
     // TODO: check for IDLE?
     radio_vars.pdu.length = length;
     memcpy(radio_vars.pdu.payload, tx_buffer, length);
+    _set_packet_ptr(&radio_vars.pdu);
+
+    // ramp up the radio for tx (packet will not be sent yet)
+    NRF_RADIO->TASKS_TXEN = RADIO_TASKS_TXEN_TASKS_TXEN_Trigger << RADIO_TASKS_TXEN_TASKS_TXEN_Pos;
+}
+
+void mr_radio_tx_prepare_pdu(const mr_radio_pdu_t *pdu) {
+    // EasyDMA reads the PDU where it is
+    _set_packet_ptr(pdu);
 
     // ramp up the radio for tx (packet will not be sent yet)
     NRF_RADIO->TASKS_TXEN = RADIO_TASKS_TXEN_TASKS_TXEN_Trigger << RADIO_TASKS_TXEN_TASKS_TXEN_Pos;
@@ -300,6 +303,14 @@ void mr_radio_tx_dispatch(void) {
 
 //=========================== private ==========================================
 
+static void _set_packet_ptr(const mr_radio_pdu_t *pdu) {
+    if (radio_vars.mode == MR_RADIO_IEEE802154_250Kbit) {
+        NRF_RADIO->PACKETPTR = (uint32_t)((const uint8_t *)pdu + 1);  // Skip header for IEEE 802.15.4
+    } else {
+        NRF_RADIO->PACKETPTR = (uint32_t)pdu;
+    }
+}
+
 static void _radio_enable(void) {
     NRF_RADIO->EVENTS_ADDRESS  = 0;
     NRF_RADIO->EVENTS_END      = 0;
@@ -337,14 +348,10 @@ void RADIO_IRQHandler(void) {
         NRF_RADIO->EVENTS_END = 0;
         dbg |= 2;
         if (radio_vars.state == (RADIO_STATE_BUSY | RADIO_STATE_RX)) {
-            // if rx, check the CRC
-            if (NRF_RADIO->CRCSTATUS != RADIO_CRCSTATUS_CRCSTATUS_CRCOk) {
-                puts("Invalid CRC");
-            } else {
-                if (radio_vars.end_pac_cb) {
-                    radio_vars.pending_rx_read = true;
-                    radio_vars.end_pac_cb(now_ts);
-                }
+            // if rx, check the CRC: the end is reported either way, with no packet to read if the CRC is invalid
+            if (radio_vars.end_pac_cb) {
+                radio_vars.pending_rx_read = NRF_RADIO->CRCSTATUS == RADIO_CRCSTATUS_CRCSTATUS_CRCOk;
+                radio_vars.end_pac_cb(now_ts);
             }
         } else if (radio_vars.state == (RADIO_STATE_BUSY | RADIO_STATE_TX)) {
             if (radio_vars.end_pac_cb) {
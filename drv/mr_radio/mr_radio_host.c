@@ -0,0 +1,247 @@
+/**
+ * @file
+ * @ingroup bsp_radio
+ *
+ * @brief  Host definition of the "radio" bsp module, running on the virtual clock.
+ *
+ * Follows the nRF state machine (IDLE, RX, TX, BUSY) and the END -> DISABLE
+ * short: after each frame the radio goes back to IDLE. Frames are sent to,
+ * and received from, the medium set with mr_host_set_medium().
+ *
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "mr_host.h"
+#include "mr_radio.h"
+#include "mr_timer_hf.h"
+
+//=========================== defines ==========================================
+
+#define RADIO_STATE_IDLE 0x00
+#define RADIO_STATE_RX   0x01
+#define RADIO_STATE_TX   0x02
+#define RADIO_STATE_BUSY 0x04
+
+#define RADIO_EVENT_ADDRESS 0x01
+#define RADIO_EVENT_END     0x02
+
+//=========================== variables ========================================
+
+static const uint8_t _ble_chan_to_freq[40] = {
+    4, 6, 8,
+    10, 12, 14, 16, 18,
+    20, 22, 24, 28,
+    30, 32, 34, 36, 38,
+    40, 42, 44, 46, 48,
+    50, 52, 54, 56, 58,
+    60, 62, 64, 66, 68,
+    70, 72, 74, 76, 78,
+    2, 26, 80  // Advertising channels
+};
+
+static uint32_t _last_frame_id = 0;
+
+//========================== prototypes ========================================
+
+static mr_host_radio_t *_radio(void);
+static void             _radio_tx_isr(mr_host_device_t *device, uintptr_t arg);
+static void             _radio_end(mr_host_radio_t *radio);
+
+//=========================== public ===========================================
+
+void mr_radio_init(radio_ts_packet_t start_pac_cb, radio_ts_packet_t end_pac_cb, mr_radio_mode_t mode) {
+    // only the BLE 2M PHY is emulated, which is what mari uses
+    assert(mode == MR_RADIO_BLE_2MBit);
+    (void)mode;
+
+    mr_host_radio_t *radio = _radio();
+    memset(radio, 0, sizeof(mr_host_radio_t));
+    radio->start_pac_cb = start_pac_cb;
+    radio->end_pac_cb   = end_pac_cb;
+    radio->state        = RADIO_STATE_IDLE;
+}
+
+void mr_radio_set_frequency(uint8_t freq) {
+    _radio()->frequency = freq;
+}
+
+void mr_radio_set_channel(uint8_t channel) {
+    assert(channel < sizeof(_ble_chan_to_freq));
+    mr_radio_set_frequency(_ble_chan_to_freq[channel]);
+}
+
+void mr_radio_set_network_address(uint32_t addr) {
+    // all devices share the same medium, the address is not emulated
+    (void)addr;
+}
+
+void mr_radio_disable(void) {
+    mr_host_radio_t *radio = _radio();
+    if (radio->state & RADIO_STATE_RX) {
+        radio->rx_us += mr_host_now_us() - radio->rx_on_us;
+    }
+    radio->state   = RADIO_STATE_IDLE;
+    radio->rx_lock = 0;
+    radio->generation++;
+}
+
+int8_t mr_radio_rssi(void) {
+    return _radio()->rssi;
+}
+
+bool mr_radio_pending_rx_read(void) {
+    return _radio()->pending_rx_read;
+}
+
+void mr_radio_get_rx_packet(uint8_t *packet, uint8_t *length) {
+    mr_host_radio_t *radio = _radio();
+    *length                = radio->length;
+    memcpy(packet, radio->payload, radio->length);
+    radio->pending_rx_read = false;
+}
+
+//--------------------------- send and receive --------------------------------
+
+void mr_radio_rx(void) {
+    mr_host_radio_t *radio = _radio();
+    if (radio->state != RADIO_STATE_IDLE) {
+        return;
+    }
+    radio->state    = RADIO_STATE_RX;
+    radio->rx_on_us = mr_host_now_us();
+
+    const mr_host_medium_t *medium = mr_host_get_medium();
+    if (medium && medium->rx) {
+        medium->rx(mr_host_device_current(), radio->frequency);
+    }
+}
+
+void mr_radio_tx(const uint8_t *packet, uint8_t length) {
+    mr_radio_tx_prepare(packet, length);
+    mr_radio_tx_dispatch();
+}
+
+void mr_radio_tx_prepare(const uint8_t *tx_buffer, uint8_t length) {
+    mr_host_radio_t *radio = _radio();
+    radio->length          = length;
+    memcpy(radio->payload, tx_buffer, length);
+}
+
+void mr_radio_tx_prepare_pdu(const mr_radio_pdu_t *pdu) {
+    // the medium needs its own copy of the frame
+    mr_radio_tx_prepare(pdu->payload, pdu->length);
+}
+
+void mr_radio_tx_dispatch(void) {
+    mr_host_device_t *device = mr_host_device_current();
+    mr_host_radio_t  *radio  = &device->radio;
+    if (radio->state != RADIO_STATE_IDLE) {
+        return;
+    }
+    radio->state = RADIO_STATE_TX;
+
+    // same timing as the receivers: address after the preamble, end after the rest of the frame
+    uint64_t  start_us = mr_host_now_us() + MR_HOST_RADIO_ADDRESS_DELAY_US;
+    uintptr_t arg      = (uintptr_t)radio->generation << 8;
+    mr_host_schedule_at(start_us, device, &_radio_tx_isr, arg | RADIO_EVENT_ADDRESS);
+    mr_host_schedule_at(start_us + mr_host_radio_toa_us(radio->length), device, &_radio_tx_isr, arg | RADIO_EVENT_END);
+
+    const mr_host_medium_t *medium = mr_host_get_medium();
+    if (medium && medium->tx) {
+        medium->tx(device, radio->frequency, radio->payload, radio->length);
+    }
+}
+
+//--------------------------- medium ------------------------------------------
+
+uint32_t mr_host_radio_toa_us(uint8_t length) {
+    return (length + MR_HOST_RADIO_OVERHEAD_BYTES) * MR_HOST_RADIO_US_PER_BYTE;
+}
+
+uint8_t mr_host_radio_channel_frequency(uint8_t channel) {
+    assert(channel < sizeof(_ble_chan_to_freq));
+    return _ble_chan_to_freq[channel];
+}
+
+bool mr_host_radio_is_listening(const mr_host_device_t *device, uint8_t frequency) {
+    return device->radio.state == RADIO_STATE_RX && device->radio.frequency == frequency;
+}
+
+uint32_t mr_host_radio_frame_start(const uint8_t *packet, uint8_t length, int8_t rssi) {
+    mr_host_radio_t *radio = _radio();
+    if (radio->state != RADIO_STATE_RX) {
+        return 0;
+    }
+
+    // the receiver locks on this frame until its end, other frames are ignored meanwhile
+    radio->state |= RADIO_STATE_BUSY;
+    radio->rx_lock = ++_last_frame_id;
+    radio->length  = length;
+    radio->rssi    = rssi;
+    memcpy(radio->payload, packet, length);
+
+    if (radio->start_pac_cb) {
+        radio->start_pac_cb(mr_timer_hf_now(MR_HOST_TIMER_DEV_RADIO));
+    }
+    return radio->rx_lock;
+}
+
+void mr_host_radio_frame_end(uint32_t frame_id, bool crc_ok) {
+    mr_host_radio_t *radio = _radio();
+    if (frame_id == 0 || radio->rx_lock != frame_id || radio->state != (RADIO_STATE_BUSY | RADIO_STATE_RX)) {
+        // the radio was disabled, or re-enabled, while receiving
+        return;
+    }
+
+    if (radio->end_pac_cb) {
+        // as the RADIO does, the end is reported either way, with no packet to read if the CRC is invalid
+        radio->pending_rx_read = crc_ok;
+        radio->end_pac_cb(mr_timer_hf_now(MR_HOST_TIMER_DEV_RADIO));
+    }
+    _radio_end(radio);
+}
+
+//=========================== private ==========================================
+
+static mr_host_radio_t *_radio(void) {
+    return &mr_host_device_current()->radio;
+}
+
+static void _radio_end(mr_host_radio_t *radio) {
+    // END -> DISABLE short, unless the callback already changed the radio state
+    if (radio->state & RADIO_STATE_BUSY) {
+        mr_radio_disable();
+    }
+}
+
+//=========================== interrupt handlers ===============================
+
+static void _radio_tx_isr(mr_host_device_t *device, uintptr_t arg) {
+    mr_host_radio_t *radio = &device->radio;
+    uint32_t         now   = mr_timer_hf_now(MR_HOST_TIMER_DEV_RADIO);
+
+    if ((uint32_t)(arg >> 8) != radio->generation) {
+        // the radio was disabled after the frame was dispatched
+        return;
+    }
+
+    if (arg & RADIO_EVENT_ADDRESS) {
+        radio->state |= RADIO_STATE_BUSY;
+        if (radio->start_pac_cb) {
+            radio->start_pac_cb(now);
+        }
+    }
+
+    if ((arg & RADIO_EVENT_END) && radio->state == (RADIO_STATE_BUSY | RADIO_STATE_TX)) {
+        if (radio->end_pac_cb) {
+            radio->end_pac_cb(now);
+        }
+        _radio_end(radio);
+    }
+}
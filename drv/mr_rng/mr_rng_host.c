@@ -0,0 +1,48 @@
+/**
+ * @file
+ * @ingroup bsp_rng
+ *
+ * @brief  Host definition of the "rng" bsp module.
+ *
+ * A xorshift32 generator, seeded per device from its device ID, so that
+ * simulations are reproducible.
+ *
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <stdint.h>
+
+#include "mr_host.h"
+#include "mr_rng.h"
+
+//=========================== public ===========================================
+
+void mr_rng_init(void) {
+    // nothing to do, the seed is set by mr_host_device_init
+}
+
+void mr_rng_read_u8(uint8_t *value) {
+    uint32_t *state = &mr_host_device_current()->rng_state;
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    *value = (uint8_t)(*state >> 24);
+}
+
+void mr_rng_read_u16(uint16_t *value) {
+    uint8_t raw_low, raw_high;
+    mr_rng_read_u8(&raw_low);
+    mr_rng_read_u8(&raw_high);
+    *value = ((uint16_t)raw_high << 8) | (uint16_t)raw_low;
+}
+
+void mr_rng_read_range(uint8_t *value, uint8_t min, uint8_t max) {
+    do {
+        mr_rng_read_u8(value);
+    } while (!(*value >= min && *value < max));
+}
+
+void mr_rng_read_u8_fast(uint8_t *value) {
+    mr_rng_read_u8(value);
+}
@@ -0,0 +1,186 @@
+/**
+ * @file
+ * @ingroup bsp_timer_hf
+ *
+ * @brief  Host definition of the "timer hf" bsp module, running on the virtual clock.
+ *
+ * Mirrors the nRF implementation: each channel holds a 32-bit compare value
+ * (CC) that is programmed exactly as the TIMER peripheral registers would be,
+ * and fires when the 1 MHz counter reaches it.
+ *
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ *
+ * @copyright Inria, 2025-now
+ */
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "mr_host.h"
+#include "mr_timer_hf.h"
+
+//=========================== define ===========================================
+
+#define TIMER_DELAY_CHANNEL (MR_HOST_TIMER_CHANNELS - 1)  ///< Channel used for delays, like cc_num on nRF
+
+//=========================== prototypes =======================================
+
+static uint32_t _counter(const mr_host_timer_t *timer);
+static void     _program(timer_hf_t timer, uint8_t channel, uint32_t cc);
+static void     _timer_hf_isr(mr_host_device_t *device, uintptr_t arg);
+
+//=========================== public ===========================================
+
+void mr_timer_hf_init(timer_hf_t timer) {
+    mr_host_timer_t *_timer = &mr_host_device_current()->timers[timer];
+
+    // clear and start the counter, keeping channels as they are (like the hardware does)
+    _timer->running   = false;
+    _timer->origin_us = mr_host_now_us();
+}
+
+uint32_t mr_timer_hf_now(timer_hf_t timer) {
+    return _counter(&mr_host_device_current()->timers[timer]);
+}
+
+void mr_timer_hf_set_periodic_us(timer_hf_t timer, uint8_t channel, uint32_t us, timer_hf_cb_t cb) {
+    assert(channel < TIMER_DELAY_CHANNEL);  // Make sure the required channel is correct
+    assert(cb);                             // Make sure the callback function is valid
+
+    mr_host_timer_channel_t *_channel = &mr_host_device_current()->timers[timer].channels[channel];
+    _channel->period_us               = us;
+    _channel->one_shot                = false;
+    _channel->callback                = cb;
+    _program(timer, channel, mr_timer_hf_now(timer) + us);
+}
+
+void mr_timer_hf_adjust_periodic_us(timer_hf_t timer, uint8_t channel, int32_t adjust_us) {
+    assert(channel < TIMER_DELAY_CHANNEL);  // Make sure the required channel is correct
+
+    // Only update the CC register, so that the adjust applies only to the current "tick"
+    mr_host_timer_channel_t *_channel = &mr_host_device_current()->timers[timer].channels[channel];
+    _program(timer, channel, _channel->cc + adjust_us);
+}
+
+void mr_timer_hf_set_oneshot_us(timer_hf_t timer, uint8_t channel, uint32_t us, timer_hf_cb_t cb) {
+    assert(channel < TIMER_DELAY_CHANNEL);  // Make sure the required channel is correct
+    assert(cb);                             // Make sure the callback function is valid
+
+    mr_host_timer_channel_t *_channel = &mr_host_device_current()->timers[timer].channels[channel];
+    _channel->period_us               = us;
+    _channel->one_shot                = true;
+    _channel->callback                = cb;
+    _program(timer, channel, mr_timer_hf_now(timer) + us);
+}
+
+void mr_timer_hf_set_oneshot_with_ref_us(timer_hf_t timer, uint8_t channel, uint32_t base_us, uint32_t us, timer_hf_cb_t cb) {
+    mr_host_timer_channel_t *_channel = &mr_host_device_current()->timers[timer].channels[channel];
+
+    // same arithmetic as the nRF implementation
+    uint32_t now        = mr_timer_hf_now(timer);
+    uint32_t period_us  = us + (now - base_us);
+    _channel->period_us = period_us;
+    _channel->one_shot  = true;
+    _channel->callback  = cb;
+    _program(timer, channel, now + period_us);
+}
+
+void mr_timer_hf_set_oneshot_with_ref_diff_us(timer_hf_t timer, uint8_t channel, uint32_t base_us, uint32_t us, timer_hf_cb_t cb) {
+    mr_host_timer_channel_t *_channel = &mr_host_device_current()->timers[timer].channels[channel];
+
+    uint32_t now        = mr_timer_hf_now(timer);
+    uint32_t period_us  = us - (now - base_us);
+    _channel->period_us = period_us;
+    _channel->one_shot  = true;
+    _channel->callback  = cb;
+    _program(timer, channel, now + period_us);
+}
+
+void mr_timer_hf_cancel(timer_hf_t timer, uint8_t channel) {
+    assert(channel < TIMER_DELAY_CHANNEL);
+
+    mr_host_timer_channel_t *_channel = &mr_host_device_current()->timers[timer].channels[channel];
+    _channel->period_us               = 0;
+    _channel->callback                = NULL;
+    _channel->armed                   = false;
+    _channel->cc                      = 0;
+    _channel->generation++;
+}
+
+void mr_timer_hf_set_oneshot_ms(timer_hf_t timer, uint8_t channel, uint32_t ms, timer_hf_cb_t cb) {
+    mr_timer_hf_set_oneshot_us(timer, channel, ms * 1000UL, cb);
+}
+
+void mr_timer_hf_set_oneshot_s(timer_hf_t timer, uint8_t channel, uint32_t s, timer_hf_cb_t cb) {
+    mr_timer_hf_set_oneshot_us(timer, channel, s * 1000UL * 1000UL, cb);
+}
+
+void mr_timer_hf_delay_us(timer_hf_t timer, uint32_t us) {
+    mr_host_timer_t *_timer = &mr_host_device_current()->timers[timer];
+
+    // the device is busy waiting: let the other devices (and our own interrupts) run meanwhile
+    _timer->running = true;
+    mr_host_run_until(mr_host_now_us() + us);
+    _timer->running = false;
+}
+
+void mr_timer_hf_delay_ms(timer_hf_t timer, uint32_t ms) {
+    mr_timer_hf_delay_us(timer, ms * 1000UL);
+}
+
+void mr_timer_hf_delay_s(timer_hf_t timer, uint32_t s) {
+    mr_timer_hf_delay_us(timer, s * 1000UL * 1000UL);
+}
+
+//=========================== private ==========================================
+
+static uint32_t _counter(const mr_host_timer_t *timer) {
+    // the counter runs on the crystal of the device, which deviates from the virtual clock
+    uint64_t elapsed_us = mr_host_now_us() - timer->origin_us;
+    return (uint32_t)(elapsed_us + (int64_t)elapsed_us * mr_host_device_current()->clock_ppm / 1000000);
+}
+
+static void _program(timer_hf_t timer, uint8_t channel, uint32_t cc) {
+    mr_host_device_t        *device   = mr_host_device_current();
+    mr_host_timer_channel_t *_channel = &device->timers[timer].channels[channel];
+
+    _channel->cc    = cc;
+    _channel->armed = true;
+    _channel->generation++;
+
+    // the COMPARE event happens when the counter reaches CC, which may only be after wrapping around
+    uint32_t delay_ticks = cc - _counter(&device->timers[timer]);
+    uint64_t delay_us    = delay_ticks ? delay_ticks : (1ULL << 32);
+    if (device->clock_ppm != 0) {
+        // ticks of the crystal, in us of the virtual clock, rounded up so that the counter reached CC
+        delay_us = (delay_us * 1000000 + 1000000 + device->clock_ppm - 1) / (1000000 + device->clock_ppm);
+    }
+    uint64_t at_us = mr_host_now_us() + delay_us;
+
+    uintptr_t arg = ((uintptr_t)_channel->generation << 16) | ((uintptr_t)timer << 8) | channel;
+    mr_host_schedule_at(at_us, device, &_timer_hf_isr, arg);
+}
+
+//=========================== interrupt ========================================
+
+static void _timer_hf_isr(mr_host_device_t *device, uintptr_t arg) {
+    timer_hf_t               timer    = (arg >> 8) & 0xff;
+    uint8_t                  channel  = arg & 0xff;
+    uint32_t                 gen      = (uint32_t)(arg >> 16);
+    mr_host_timer_channel_t *_channel = &device->timers[timer].channels[channel];
+
+    if (!_channel->armed || _channel->generation != gen) {
+        // the channel was re-programmed or cancelled after this event was scheduled
+        return;
+    }
+
+    if (_channel->one_shot) {
+        _channel->armed = false;
+    } else {
+        _program(timer, channel, _channel->cc + _channel->period_us);
+    }
+    if (_channel->callback) {
+        _channel->callback();
+    }
+}
@@ -4,20 +4,18 @@
  *
  * @brief       Fixed schedules
  *
+ * Other schedules can be generated with app/01mari_schedgen, which also
+ * checks these ones at each host build.
+ *
  * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
  *
  * @copyright Inria, 2024
  */
 #include "models.h"
 
-// account for:
-// - the 4 schedules supporting up to 10, 44, 66 and 102 nodes
-// - the schedule that can be passed by the application during initialization
-#define MARI_N_SCHEDULES 4 + 1
-
 // clang-format off
 /* Schedule used for tests only. Commented out by default. */
-// schedule_t schedule_test = {
+// const schedule_t schedule_test = {
 //     .id            = 0xFE,
 //     .max_nodes     = 0,
 //     .backoff_n_min = 5,
@@ -25,12 +23,12 @@
 //     .n_cells       = 1,
 //     .cells         = {
 //         // the channel offset doesn't matter here
-//         { 'U', 0, 0, 0, 0, 0 },
+//         { 'U', 0 },
 //     }
 // };
 
 /* Schedule with 17 slots, supporting up to 10 nodes */
-schedule_t schedule_tiny = {
+const schedule_t schedule_tiny = {
     .id = 6,
     .max_nodes = 10,
     .backoff_n_min = 5,
@@ -38,29 +36,29 @@ schedule_t schedule_tiny = {
     .n_cells = 17,
     .cells = {
         // Begin with beacon cells. They use their own channel offsets and frequencies.
-        {'B', 0, 0, 0, 0, 0},
-        {'B', 1, 0, 0, 0, 0},
-        {'B', 2, 0, 0, 0, 0},
+        {'B', 0},
+        {'B', 1},
+        {'B', 2},
         // Continue with regular cells.
-        {'U', 0, 0, 0, 0, 0},
-        {'U', 9, 0, 0, 0, 0},
-        {'S', 5, 0, 0, 0, 0},
-        {'D', 3, 0, 0, 0, 0},
-        {'U', 10, 0, 0, 0, 0},
-        {'U', 8, 0, 0, 0, 0},
-        {'U', 1, 0, 0, 0, 0},
-        {'U', 12, 0, 0, 0, 0},
-        {'S', 11, 0, 0, 0, 0},
-        {'D', 2, 0, 0, 0, 0},
-        {'U', 7, 0, 0, 0, 0},
-        {'U', 4, 0, 0, 0, 0},
-        {'U', 13, 0, 0, 0, 0},
-        {'U', 6, 0, 0, 0, 0}
+        {'U', 0},
+        {'U', 9},
+        {'S', 5},
+        {'D', 3},
+        {'U', 10},
+        {'U', 8},
+        {'U', 1},
+        {'U', 12},
+        {'S', 11},
+        {'D', 2},
+        {'U', 7},
+        {'U', 4},
+        {'U', 13},
+        {'U', 6}
     }
 };
 
 /* Schedule with 67 slots, supporting up to 44 nodes */
-schedule_t schedule_medium = {
+const schedule_t schedule_medium = {
     .id = 4,
     .max_nodes = 44,
     .backoff_n_min = 5,
@@ -68,79 +66,79 @@ schedule_t schedule_medium = {
     .n_cells = 67,
     .cells = {
         // Begin with beacon cells. They use their own channel offsets and frequencies.
-        {'B', 0, 0, 0, 0, 0},
-        {'B', 1, 0, 0, 0, 0},
-        {'B', 2, 0, 0, 0, 0},
+        {'B', 0},
+        {'B', 1},
+        {'B', 2},
         // Continue with regular cells.
-        {'U', 14, 0, 0, 0, 0},
-        {'U', 53, 0, 0, 0, 0},
-        {'S', 59, 0, 0, 0, 0},
-        {'D', 30, 0, 0, 0, 0},
-        {'U', 27, 0, 0, 0, 0},
-        {'U', 11, 0, 0, 0, 0},
-        {'U', 1, 0, 0, 0, 0},
-        {'U', 34, 0, 0, 0, 0},
-        {'S', 43, 0, 0, 0, 0},
-        {'D', 6, 0, 0, 0, 0},
-        {'U', 16, 0, 0, 0, 0},
-        {'U', 63, 0, 0, 0, 0},
-        {'U', 8, 0, 0, 0, 0},
-        {'U', 42, 0, 0, 0, 0},
-        {'S', 54, 0, 0, 0, 0},
-        {'D', 50, 0, 0, 0, 0},
-        {'U', 62, 0, 0, 0, 0},
-        {'U', 36, 0, 0, 0, 0},
-        {'U', 9, 0, 0, 0, 0},
-        {'U', 48, 0, 0, 0, 0},
-        {'S', 0, 0, 0, 0, 0},
-        {'D', 24, 0, 0, 0, 0},
-        {'U', 17, 0, 0, 0, 0},
-        {'U', 60, 0, 0, 0, 0},
-        {'U', 45, 0, 0, 0, 0},
-        {'U', 57, 0, 0, 0, 0},
-        {'S', 25, 0, 0, 0, 0},
-        {'D', 61, 0, 0, 0, 0},
-        {'U', 10, 0, 0, 0, 0},
-        {'U', 15, 0, 0, 0, 0},
-        {'U', 40, 0, 0, 0, 0},
-        {'U', 21, 0, 0, 0, 0},
-        {'S', 39, 0, 0, 0, 0},
-        {'D', 49, 0, 0, 0, 0},
-        {'U', 47, 0, 0, 0, 0},
-        {'U', 22, 0, 0, 0, 0},
-        {'U', 38, 0, 0, 0, 0},
-        {'U', 44, 0, 0, 0, 0},
-        {'S', 28, 0, 0, 0, 0},
-        {'D', 33, 0, 0, 0, 0},
-        {'U', 35, 0, 0, 0, 0},
-        {'U', 31, 0, 0, 0, 0},
-        {'U', 20, 0, 0, 0, 0},
-        {'U', 29, 0, 0, 0, 0},
-        {'S', 7, 0, 0, 0, 0},
-        {'D', 3, 0, 0, 0, 0},
-        {'U', 18, 0, 0, 0, 0},
-        {'U', 5, 0, 0, 0, 0},
-        {'U', 19, 0, 0, 0, 0},
-        {'U', 58, 0, 0, 0, 0},
-        {'S', 37, 0, 0, 0, 0},
-        {'D', 32, 0, 0, 0, 0},
-        {'U', 13, 0, 0, 0, 0},
-        {'U', 2, 0, 0, 0, 0},
-        {'U', 52, 0, 0, 0, 0},
-        {'U', 4, 0, 0, 0, 0},
-        {'S', 41, 0, 0, 0, 0},
-        {'D', 12, 0, 0, 0, 0},
-        {'U', 56, 0, 0, 0, 0},
-        {'U', 46, 0, 0, 0, 0},
-        {'U', 55, 0, 0, 0, 0},
-        {'U', 51, 0, 0, 0, 0},
-        {'U', 23, 0, 0, 0, 0},
-        {'U', 26, 0, 0, 0, 0}
+        {'U', 14},
+        {'U', 53},
+        {'S', 59},
+        {'D', 30},
+        {'U', 27},
+        {'U', 11},
+        {'U', 1},
+        {'U', 34},
+        {'S', 43},
+        {'D', 6},
+        {'U', 16},
+        {'U', 63},
+        {'U', 8},
+        {'U', 42},
+        {'S', 54},
+        {'D', 50},
+        {'U', 62},
+        {'U', 36},
+        {'U', 9},
+        {'U', 48},
+        {'S', 0},
+        {'D', 24},
+        {'U', 17},
+        {'U', 60},
+        {'U', 45},
+        {'U', 57},
+        {'S', 25},
+        {'D', 61},
+        {'U', 10},
+        {'U', 15},
+        {'U', 40},
+        {'U', 21},
+        {'S', 39},
+        {'D', 49},
+        {'U', 47},
+        {'U', 22},
+        {'U', 38},
+        {'U', 44},
+        {'S', 28},
+        {'D', 33},
+        {'U', 35},
+        {'U', 31},
+        {'U', 20},
+        {'U', 29},
+        {'S', 7},
+        {'D', 3},
+        {'U', 18},
+        {'U', 5},
+        {'U', 19},
+        {'U', 58},
+        {'S', 37},
+        {'D', 32},
+        {'U', 13},
+        {'U', 2},
+        {'U', 52},
+        {'U', 4},
+        {'S', 41},
+        {'D', 12},
+        {'U', 56},
+        {'U', 46},
+        {'U', 55},
+        {'U', 51},
+        {'U', 23},
+        {'U', 26}
     }
 };
 
 /* Schedule with 101 slots, supporting up to 66 nodes */
-schedule_t schedule_big = {
+const schedule_t schedule_big = {
     .id = 3,
     .max_nodes = 66,
     .backoff_n_min = 5,
@@ -148,113 +146,113 @@ schedule_t schedule_big = {
     .n_cells = 101,
     .cells = {
         // Begin with beacon cells. They use their own channel offsets and frequencies.
-        {'B', 0, 0, 0, 0, 0},
-        {'B', 1, 0, 0, 0, 0},
-        {'B', 2, 0, 0, 0, 0},
+        {'B', 0},
+        {'B', 1},
+        {'B', 2},
         // Continue with regular cells.
-        {'U', 23, 0, 0, 0, 0},
-        {'U', 35, 0, 0, 0, 0},
-        {'S', 44, 0, 0, 0, 0},
-        {'D', 55, 0, 0, 0, 0},
-        {'U', 46, 0, 0, 0, 0},
-        {'U', 2, 0, 0, 0, 0},
-        {'U', 36, 0, 0, 0, 0},
-        {'U', 75, 0, 0, 0, 0},
-        {'S', 90, 0, 0, 0, 0},
-        {'D', 88, 0, 0, 0, 0},
-        {'U', 66, 0, 0, 0, 0},
-        {'U', 70, 0, 0, 0, 0},
-        {'U', 12, 0, 0, 0, 0},
-        {'U', 11, 0, 0, 0, 0},
-        {'S', 32, 0, 0, 0, 0},
-        {'D', 80, 0, 0, 0, 0},
-        {'U', 24, 0, 0, 0, 0},
-        {'U', 67, 0, 0, 0, 0},
-        {'U', 77, 0, 0, 0, 0},
-        {'U', 94, 0, 0, 0, 0},
-        {'S', 95, 0, 0, 0, 0},
-        {'D', 14, 0, 0, 0, 0},
-        {'U', 93, 0, 0, 0, 0},
-        {'U', 82, 0, 0, 0, 0},
-        {'U', 1, 0, 0, 0, 0},
-        {'U', 37, 0, 0, 0, 0},
-        {'S', 57, 0, 0, 0, 0},
-        {'D', 49, 0, 0, 0, 0},
-        {'U', 34, 0, 0, 0, 0},
-        {'U', 26, 0, 0, 0, 0},
-        {'U', 71, 0, 0, 0, 0},
-        {'U', 5, 0, 0, 0, 0},
-        {'S', 13, 0, 0, 0, 0},
-        {'D', 33, 0, 0, 0, 0},
-        {'U', 17, 0, 0, 0, 0},
-        {'U', 41, 0, 0, 0, 0},
-        {'U', 42, 0, 0, 0, 0},
-        {'U', 30, 0, 0, 0, 0},
-        {'S', 64, 0, 0, 0, 0},
-        {'D', 73, 0, 0, 0, 0},
-        {'U', 8, 0, 0, 0, 0},
-        {'U', 85, 0, 0, 0, 0},
-        {'U', 40, 0, 0, 0, 0},
-        {'U', 91, 0, 0, 0, 0},
-        {'S', 7, 0, 0, 0, 0},
-        {'D', 56, 0, 0, 0, 0},
-        {'U', 10, 0, 0, 0, 0},
-        {'U', 19, 0, 0, 0, 0},
-        {'U', 53, 0, 0, 0, 0},
-        {'U', 22, 0, 0, 0, 0},
-        {'S', 52, 0, 0, 0, 0},
-        {'D', 47, 0, 0, 0, 0},
-        {'U', 6, 0, 0, 0, 0},
-        {'U', 25, 0, 0, 0, 0},
-        {'U', 81, 0, 0, 0, 0},
-        {'U', 97, 0, 0, 0, 0},
-        {'S', 21, 0, 0, 0, 0},
-        {'D', 76, 0, 0, 0, 0},
-        {'U', 20, 0, 0, 0, 0},
-        {'U', 74, 0, 0, 0, 0},
-        {'U', 89, 0, 0, 0, 0},
-        {'U', 61, 0, 0, 0, 0},
-        {'S', 96, 0, 0, 0, 0},
-        {'D', 79, 0, 0, 0, 0},
-        {'U', 39, 0, 0, 0, 0},
-        {'U', 72, 0, 0, 0, 0},
-        {'U', 43, 0, 0, 0, 0},
-        {'U', 9, 0, 0, 0, 0},
-        {'S', 60, 0, 0, 0, 0},
-        {'D', 4, 0, 0, 0, 0},
-        {'U', 83, 0, 0, 0, 0},
-        {'U', 15, 0, 0, 0, 0},
-        {'U', 51, 0, 0, 0, 0},
-        {'U', 0, 0, 0, 0, 0},
-        {'S', 62, 0, 0, 0, 0},
-        {'D', 54, 0, 0, 0, 0},
-        {'U', 38, 0, 0, 0, 0},
-        {'U', 59, 0, 0, 0, 0},
-        {'U', 31, 0, 0, 0, 0},
-        {'U', 69, 0, 0, 0, 0},
-        {'S', 48, 0, 0, 0, 0},
-        {'D', 28, 0, 0, 0, 0},
-        {'U', 78, 0, 0, 0, 0},
-        {'U', 87, 0, 0, 0, 0},
-        {'U', 50, 0, 0, 0, 0},
-        {'U', 65, 0, 0, 0, 0},
-        {'S', 45, 0, 0, 0, 0},
-        {'D', 63, 0, 0, 0, 0},
-        {'U', 29, 0, 0, 0, 0},
-        {'U', 18, 0, 0, 0, 0},
-        {'U', 92, 0, 0, 0, 0},
-        {'U', 86, 0, 0, 0, 0},
-        {'S', 58, 0, 0, 0, 0},
-        {'D', 84, 0, 0, 0, 0},
-        {'U', 16, 0, 0, 0, 0},
-        {'U', 3, 0, 0, 0, 0},
-        {'U', 68, 0, 0, 0, 0},
-        {'U', 27, 0, 0, 0, 0}
+        {'U', 23},
+        {'U', 35},
+        {'S', 44},
+        {'D', 55},
+        {'U', 46},
+        {'U', 2},
+        {'U', 36},
+        {'U', 75},
+        {'S', 90},
+        {'D', 88},
+        {'U', 66},
+        {'U', 70},
+        {'U', 12},
+        {'U', 11},
+        {'S', 32},
+        {'D', 80},
+        {'U', 24},
+        {'U', 67},
+        {'U', 77},
+        {'U', 94},
+        {'S', 95},
+        {'D', 14},
+        {'U', 93},
+        {'U', 82},
+        {'U', 1},
+        {'U', 37},
+        {'S', 57},
+        {'D', 49},
+        {'U', 34},
+        {'U', 26},
+        {'U', 71},
+        {'U', 5},
+        {'S', 13},
+        {'D', 33},
+        {'U', 17},
+        {'U', 41},
+        {'U', 42},
+        {'U', 30},
+        {'S', 64},
+        {'D', 73},
+        {'U', 8},
+        {'U', 85},
+        {'U', 40},
+        {'U', 91},
+        {'S', 7},
+        {'D', 56},
+        {'U', 10},
+        {'U', 19},
+        {'U', 53},
+        {'U', 22},
+        {'S', 52},
+        {'D', 47},
+        {'U', 6},
+        {'U', 25},
+        {'U', 81},
+        {'U', 97},
+        {'S', 21},
+        {'D', 76},
+        {'U', 20},
+        {'U', 74},
+        {'U', 89},
+        {'U', 61},
+        {'S', 96},
+        {'D', 79},
+        {'U', 39},
+        {'U', 72},
+        {'U', 43},
+        {'U', 9},
+        {'S', 60},
+        {'D', 4},
+        {'U', 83},
+        {'U', 15},
+        {'U', 51},
+        {'U', 0},
+        {'S', 62},
+        {'D', 54},
+        {'U', 38},
+        {'U', 59},
+        {'U', 31},
+        {'U', 69},
+        {'S', 48},
+        {'D', 28},
+        {'U', 78},
+        {'U', 87},
+        {'U', 50},
+        {'U', 65},
+        {'S', 45},
+        {'D', 63},
+        {'U', 29},
+        {'U', 18},
+        {'U', 92},
+        {'U', 86},
+        {'S', 58},
+        {'D', 84},
+        {'U', 16},
+        {'U', 3},
+        {'U', 68},
+        {'U', 27}
     }
 };
 
 /* Schedule with 149 slots, supporting up to 102 nodes */
-schedule_t schedule_huge = {
+const schedule_t schedule_huge = {
     .id = 1,
     .max_nodes = 102,
     .backoff_n_min = 5,
@@ -262,156 +260,156 @@ schedule_t schedule_huge = {
     .n_cells = 149,
     .cells = {
         // Begin with beacon cells. They use their own channel offsets and frequencies.
-        {'B', 0, 0, 0, 0, 0},
-        {'B', 1, 0, 0, 0, 0},
-        {'B', 2, 0, 0, 0, 0},
+        {'B', 0},
+        {'B', 1},
+        {'B', 2},
         // Continue with regular cells.
-        {'U', 54, 0, 0, 0, 0},
-        {'U', 9, 0, 0, 0, 0},
-        {'S', 138, 0, 0, 0, 0},
-        {'D', 117, 0, 0, 0, 0},
-        {'U', 34, 0, 0, 0, 0},
-        {'U', 77, 0, 0, 0, 0},
-        {'U', 130, 0, 0, 0, 0},
-        {'U', 129, 0, 0, 0, 0},
-        {'S', 87, 0, 0, 0, 0},
-        {'D', 120, 0, 0, 0, 0},
-        {'U', 97, 0, 0, 0, 0},
-        {'U', 65, 0, 0, 0, 0},
-        {'U', 21, 0, 0, 0, 0},
-        {'U', 113, 0, 0, 0, 0},
-        {'U', 1, 0, 0, 0, 0},
-        {'S', 91, 0, 0, 0, 0},
-        {'D', 135, 0, 0, 0, 0},
-        {'U', 96, 0, 0, 0, 0},
-        {'U', 132, 0, 0, 0, 0},
-        {'U', 101, 0, 0, 0, 0},
-        {'U', 74, 0, 0, 0, 0},
-        {'S', 15, 0, 0, 0, 0},
-        {'D', 73, 0, 0, 0, 0},
-        {'U', 84, 0, 0, 0, 0},
-        {'U', 55, 0, 0, 0, 0},
-        {'U', 58, 0, 0, 0, 0},
-        {'U', 105, 0, 0, 0, 0},
-        {'U', 49, 0, 0, 0, 0},
-        {'S', 3, 0, 0, 0, 0},
-        {'D', 122, 0, 0, 0, 0},
-        {'U', 40, 0, 0, 0, 0},
-        {'U', 0, 0, 0, 0, 0},
-        {'U', 47, 0, 0, 0, 0},
-        {'U', 51, 0, 0, 0, 0},
-        {'S', 14, 0, 0, 0, 0},
-        {'D', 35, 0, 0, 0, 0},
-        {'U', 5, 0, 0, 0, 0},
-        {'U', 10, 0, 0, 0, 0},
-        {'U', 53, 0, 0, 0, 0},
-        {'U', 80, 0, 0, 0, 0},
-        {'U', 59, 0, 0, 0, 0},
-        {'S', 139, 0, 0, 0, 0},
-        {'D', 104, 0, 0, 0, 0},
-        {'U', 134, 0, 0, 0, 0},
-        {'U', 66, 0, 0, 0, 0},
-        {'U', 11, 0, 0, 0, 0},
-        {'U', 121, 0, 0, 0, 0},
-        {'S', 95, 0, 0, 0, 0},
-        {'D', 7, 0, 0, 0, 0},
-        {'U', 108, 0, 0, 0, 0},
-        {'U', 23, 0, 0, 0, 0},
-        {'U', 72, 0, 0, 0, 0},
-        {'U', 8, 0, 0, 0, 0},
-        {'U', 28, 0, 0, 0, 0},
-        {'S', 18, 0, 0, 0, 0},
-        {'D', 94, 0, 0, 0, 0},
-        {'U', 17, 0, 0, 0, 0},
-        {'U', 125, 0, 0, 0, 0},
-        {'U', 22, 0, 0, 0, 0},
-        {'U', 143, 0, 0, 0, 0},
-        {'S', 111, 0, 0, 0, 0},
-        {'D', 16, 0, 0, 0, 0},
-        {'U', 56, 0, 0, 0, 0},
-        {'U', 20, 0, 0, 0, 0},
-        {'U', 131, 0, 0, 0, 0},
-        {'U', 61, 0, 0, 0, 0},
-        {'U', 142, 0, 0, 0, 0},
-        {'S', 83, 0, 0, 0, 0},
-        {'D', 71, 0, 0, 0, 0},
-        {'U', 110, 0, 0, 0, 0},
-        {'U', 6, 0, 0, 0, 0},
-        {'U', 98, 0, 0, 0, 0},
-        {'U', 86, 0, 0, 0, 0},
-        {'S', 42, 0, 0, 0, 0},
-        {'D', 60, 0, 0, 0, 0},
-        {'U', 137, 0, 0, 0, 0},
-        {'U', 127, 0, 0, 0, 0},
-        {'U', 141, 0, 0, 0, 0},
-        {'U', 48, 0, 0, 0, 0},
-        {'U', 92, 0, 0, 0, 0},
-        {'S', 128, 0, 0, 0, 0},
-        {'D', 19, 0, 0, 0, 0},
-        {'U', 4, 0, 0, 0, 0},
-        {'U', 115, 0, 0, 0, 0},
-        {'U', 102, 0, 0, 0, 0},
-        {'U', 81, 0, 0, 0, 0},
-        {'S', 112, 0, 0, 0, 0},
-        {'D', 133, 0, 0, 0, 0},
-        {'U', 93, 0, 0, 0, 0},
-        {'U', 62, 0, 0, 0, 0},
-        {'U', 67, 0, 0, 0, 0},
-        {'U', 89, 0, 0, 0, 0},
-        {'U', 52, 0, 0, 0, 0},
-        {'S', 114, 0, 0, 0, 0},
-        {'D', 29, 0, 0, 0, 0},
-        {'U', 100, 0, 0, 0, 0},
-        {'U', 63, 0, 0, 0, 0},
-        {'U', 99, 0, 0, 0, 0},
-        {'U', 145, 0, 0, 0, 0},
-        {'S', 31, 0, 0, 0, 0},
-        {'D', 82, 0, 0, 0, 0},
-        {'U', 37, 0, 0, 0, 0},
-        {'U', 103, 0, 0, 0, 0},
-        {'U', 39, 0, 0, 0, 0},
-        {'U', 33, 0, 0, 0, 0},
-        {'U', 24, 0, 0, 0, 0},
-        {'S', 32, 0, 0, 0, 0},
-        {'D', 140, 0, 0, 0, 0},
-        {'U', 41, 0, 0, 0, 0},
-        {'U', 85, 0, 0, 0, 0},
-        {'U', 50, 0, 0, 0, 0},
-        {'U', 25, 0, 0, 0, 0},
-        {'S', 46, 0, 0, 0, 0},
-        {'D', 26, 0, 0, 0, 0},
-        {'U', 44, 0, 0, 0, 0},
-        {'U', 68, 0, 0, 0, 0},
-        {'U', 36, 0, 0, 0, 0},
-        {'U', 12, 0, 0, 0, 0},
-        {'U', 78, 0, 0, 0, 0},
-        {'S', 90, 0, 0, 0, 0},
-        {'D', 13, 0, 0, 0, 0},
-        {'U', 75, 0, 0, 0, 0},
-        {'U', 57, 0, 0, 0, 0},
-        {'U', 116, 0, 0, 0, 0},
-        {'U', 136, 0, 0, 0, 0},
-        {'S', 124, 0, 0, 0, 0},
-        {'D', 69, 0, 0, 0, 0},
-        {'U', 30, 0, 0, 0, 0},
-        {'U', 119, 0, 0, 0, 0},
-        {'U', 70, 0, 0, 0, 0},
-        {'U', 76, 0, 0, 0, 0},
-        {'U', 123, 0, 0, 0, 0},
-        {'S', 45, 0, 0, 0, 0},
-        {'D', 118, 0, 0, 0, 0},
-        {'U', 79, 0, 0, 0, 0},
-        {'U', 107, 0, 0, 0, 0},
-        {'U', 106, 0, 0, 0, 0},
-        {'U', 144, 0, 0, 0, 0},
-        {'S', 88, 0, 0, 0, 0},
-        {'D', 64, 0, 0, 0, 0},
-        {'U', 2, 0, 0, 0, 0},
-        {'U', 43, 0, 0, 0, 0},
-        {'U', 109, 0, 0, 0, 0},
-        {'U', 27, 0, 0, 0, 0},
-        {'U', 126, 0, 0, 0, 0},
-        {'U', 38, 0, 0, 0, 0}
+        {'U', 54},
+        {'U', 9},
+        {'S', 138},
+        {'D', 117},
+        {'U', 34},
+        {'U', 77},
+        {'U', 130},
+        {'U', 129},
+        {'S', 87},
+        {'D', 120},
+        {'U', 97},
+        {'U', 65},
+        {'U', 21},
+        {'U', 113},
+        {'U', 1},
+        {'S', 91},
+        {'D', 135},
+        {'U', 96},
+        {'U', 132},
+        {'U', 101},
+        {'U', 74},
+        {'S', 15},
+        {'D', 73},
+        {'U', 84},
+        {'U', 55},
+        {'U', 58},
+        {'U', 105},
+        {'U', 49},
+        {'S', 3},
+        {'D', 122},
+        {'U', 40},
+        {'U', 0},
+        {'U', 47},
+        {'U', 51},
+        {'S', 14},
+        {'D', 35},
+        {'U', 5},
+        {'U', 10},
+        {'U', 53},
+        {'U', 80},
+        {'U', 59},
+        {'S', 139},
+        {'D', 104},
+        {'U', 134},
+        {'U', 66},
+        {'U', 11},
+        {'U', 121},
+        {'S', 95},
+        {'D', 7},
+        {'U', 108},
+        {'U', 23},
+        {'U', 72},
+        {'U', 8},
+        {'U', 28},
+        {'S', 18},
+        {'D', 94},
+        {'U', 17},
+        {'U', 125},
+        {'U', 22},
+        {'U', 143},
+        {'S', 111},
+        {'D', 16},
+        {'U', 56},
+        {'U', 20},
+        {'U', 131},
+        {'U', 61},
+        {'U', 142},
+        {'S', 83},
+        {'D', 71},
+        {'U', 110},
+        {'U', 6},
+        {'U', 98},
+        {'U', 86},
+        {'S', 42},
+        {'D', 60},
+        {'U', 137},
+        {'U', 127},
+        {'U', 141},
+        {'U', 48},
+        {'U', 92},
+        {'S', 128},
+        {'D', 19},
+        {'U', 4},
+        {'U', 115},
+        {'U', 102},
+        {'U', 81},
+        {'S', 112},
+        {'D', 133},
+        {'U', 93},
+        {'U', 62},
+        {'U', 67},
+        {'U', 89},
+        {'U', 52},
+        {'S', 114},
+        {'D', 29},
+        {'U', 100},
+        {'U', 63},
+        {'U', 99},
+        {'U', 145},
+        {'S', 31},
+        {'D', 82},
+        {'U', 37},
+        {'U', 103},
+        {'U', 39},
+        {'U', 33},
+        {'U', 24},
+        {'S', 32},
+        {'D', 140},
+        {'U', 41},
+        {'U', 85},
+        {'U', 50},
+        {'U', 25},
+        {'S', 46},
+        {'D', 26},
+        {'U', 44},
+        {'U', 68},
+        {'U', 36},
+        {'U', 12},
+        {'U', 78},
+        {'S', 90},
+        {'D', 13},
+        {'U', 75},
+        {'U', 57},
+        {'U', 116},
+        {'U', 136},
+        {'S', 124},
+        {'D', 69},
+        {'U', 30},
+        {'U', 119},
+        {'U', 70},
+        {'U', 76},
+        {'U', 123},
+        {'S', 45},
+        {'D', 118},
+        {'U', 79},
+        {'U', 107},
+        {'U', 106},
+        {'U', 144},
+        {'S', 88},
+        {'D', 64},
+        {'U', 2},
+        {'U', 43},
+        {'U', 109},
+        {'U', 27},
+        {'U', 126},
+        {'U', 38}
     }
 };
 // clang-format on
@@ -26,6 +26,7 @@
 #include "scheduler.h"
 #include "bloom.h"
 #include "queue.h"
+#include "context.h"
 
 //=========================== debug ============================================
 
@@ -69,24 +70,10 @@ mr_gpio_t led3 = { .port = 0, .pin = 31 };
 // and the gateway prioritizes join responses over all other downstream packets
 #define MARI_JOINING_STATE_TIMEOUT ((MARI_WHOLE_SLOT_DURATION * (2 - 1)) + (MARI_WHOLE_SLOT_DURATION / 2))  // apply a half-slot duration just so that the timeout happens before the slot boundary
 
-typedef struct {
-    mr_assoc_state_t state;
-    mr_event_cb_t    mari_event_callback;
-    uint32_t         last_state_change_ts;  ///< Last time the state changed
-    uint16_t         network_id;            ///< If gateway, puts it in the beacon packet. If node, uses it to filter beacons (0 means accept any network)
-
-    // node
-    uint32_t       last_received_from_gateway_asn;  ///< Last received packet when in joined state
-    int16_t        backoff_n;
-    uint8_t        backoff_random_time;                ///< Number of slots to wait before re-trying to join
-    uint32_t       join_response_timeout_ts;           ///< Time when the node will give up joining
-    uint16_t       synced_gateway_remaining_capacity;  ///< Number of nodes that my gateway can still accept
-    mr_event_tag_t is_pending_disconnect;              ///< Whether the node is pending a disconnect
-} assoc_vars_t;
-
 //=========================== variables =======================================
 
-assoc_vars_t assoc_vars = { 0 };
+// state of the selected mari instance, see context.h
+#define assoc_vars (mr_ctx->assoc)
 
 //=========================== prototypes ======================================
 
@@ -292,7 +279,8 @@ bool mr_assoc_node_should_leave(uint32_t asn) {
         return true;
     }
 
-    bool gateway_is_lost = (asn - assoc_vars.last_received_from_gateway_asn) > mr_scheduler_get_active_schedule_slot_count() * MARI_MAX_SLOTFRAMES_NO_RX_LEAVE;
+    uint8_t max_slotframes  = mr_mac_is_drift_compensated() ? MARI_MAX_SLOTFRAMES_NO_RX_LEAVE_COMPENSATED : MARI_MAX_SLOTFRAMES_NO_RX_LEAVE;
+    bool    gateway_is_lost = (asn - assoc_vars.last_received_from_gateway_asn) > mr_scheduler_get_active_schedule_slot_count() * max_slotframes;
     if (gateway_is_lost) {
         // too long since last received from the gateway, consider it lost
         assoc_vars.is_pending_disconnect = MARI_PEER_LOST_TIMEOUT;
@@ -338,56 +326,40 @@ bool mr_assoc_node_matches_network_id(uint16_t network_id) {
 // ------------ gateway functions ---------
 
 bool mr_assoc_gateway_node_is_joined(uint64_t node_id) {
-    schedule_t *schedule = mr_scheduler_get_active_schedule_ptr();
-    for (size_t i = 0; i < schedule->n_cells; i++) {
-        if (schedule->cells[i].type != SLOT_TYPE_UPLINK) {
-            // we only care about uplink cells
-            continue;
-        }
-        if (schedule->cells[i].assigned_node_id == node_id) {
-            // this node is assigned to a cell, so it is joined
-            return true;
-        }
-    }
-    return false;
+    // a node is joined when it is assigned to a cell
+    return mr_scheduler_gateway_get_node_cell(node_id) >= 0;
 }
 
 bool mr_assoc_gateway_keep_node_alive(uint64_t node_id, uint64_t asn) {
     // save the asn of the last packet received from a certain node_id
-    schedule_t *schedule = mr_scheduler_get_active_schedule_ptr();
-    for (size_t i = 0; i < schedule->n_cells; i++) {
-        if (schedule->cells[i].type != SLOT_TYPE_UPLINK) {
-            // we only care about uplink cells
-            continue;
-        }
-        if (schedule->cells[i].assigned_node_id == node_id) {
-            // save the asn so we know this node is alive
-            schedule->cells[i].last_received_asn = asn;
-        }
+    int16_t cell_index = mr_scheduler_gateway_get_node_cell(node_id);
+    if (cell_index < 0) {
+        return false;
     }
-    // should never reach here
-    return false;
+    // save the asn so we know this node is alive
+    mr_scheduler_get_cell_assignment(cell_index)->last_received_asn = asn;
+    return true;
 }
 
 void mr_assoc_gateway_clear_old_nodes(uint64_t asn) {
     // clear all nodes that have not been heard from in the last N asn
     // also deassign the cells from the scheduler
-    uint64_t max_asn_old = mr_scheduler_get_active_schedule_slot_count() * MARI_MAX_SLOTFRAMES_NO_RX_LEAVE;
+    // a node whose frequency offset is corrected keeps its cell for longer without hearing the gateway,
+    // which does not know whether it is: the cell is only given to another node once every node would have left
+    uint8_t  max_slotframes = MARI_DRIFT_COMPENSATION ? MARI_MAX_SLOTFRAMES_NO_RX_LEAVE_COMPENSATED : MARI_MAX_SLOTFRAMES_NO_RX_LEAVE;
+    uint64_t max_asn_old    = mr_scheduler_get_active_schedule_slot_count() * max_slotframes;
 
-    schedule_t *schedule = mr_scheduler_get_active_schedule_ptr();
+    const schedule_t *schedule = mr_scheduler_get_active_schedule_ptr();
     for (size_t i = 0; i < schedule->n_cells; i++) {
         if (schedule->cells[i].type != SLOT_TYPE_UPLINK) {
             // we only care about uplink cells
             continue;
         }
-        cell_t *cell = &schedule->cells[i];
+        mr_cell_assignment_t *cell = mr_scheduler_get_cell_assignment(i);
         if (cell->assigned_node_id != 0 && asn - cell->last_received_asn > max_asn_old) {
             mr_event_data_t event_data = (mr_event_data_t){ .data.node_info.node_id = cell->assigned_node_id, .tag = MARI_PEER_LOST_TIMEOUT };
-            // inform the scheduler
-            mr_scheduler_gateway_decrease_nodes_counter();
-            // clear the cell
-            cell->assigned_node_id  = NULL;
-            cell->last_received_asn = 0;
+            // clear the cell, and inform the scheduler
+            mr_scheduler_gateway_deassign_cell(i);
             // inform the application
             assoc_vars.mari_event_callback(MARI_NODE_LEFT, event_data);
         }
@@ -397,9 +369,7 @@ void mr_assoc_gateway_clear_old_nodes(uint64_t asn) {
 // ------------ packet handlers -------
 
 void mr_assoc_handle_beacon(uint8_t *packet, uint8_t length, uint8_t channel, uint32_t ts) {
-    (void)length;
-
-    if (packet[1] != MARI_PACKET_BEACON) {
+    if (length < MARI_BEACON_HEADER_LEN || packet[1] != MARI_PACKET_BEACON) {
         return;
     }
 
@@ -418,19 +388,37 @@ void mr_assoc_handle_beacon(uint8_t *packet, uint8_t length, uint8_t channel, ui
 
     bool from_my_gateway = beacon->src == mr_mac_get_synced_gateway();
     if (from_my_gateway && mr_assoc_is_joined()) {
-        bool still_joined = mr_bloom_node_contains(mr_device_id(), beacon->bloom_filter);
+        if (beacon->active_schedule_id != mr_scheduler_get_active_schedule_id()) {
+            // the gateway switched schedule, and this node missed all the beacons that announced it
+            assoc_vars.is_pending_disconnect = MARI_OUT_OF_SYNC;
+            return;
+        }
+
+        uint8_t membership_len = length - MARI_BEACON_HEADER_LEN;
+        bool    still_joined   = mr_bloom_node_contains(mr_device_id(), mr_scheduler_node_get_uplink_index(), beacon->membership_encoding, beacon->membership, membership_len);
         if (!still_joined) {
             // node no longer joined to this gateway, so need to leave
             assoc_vars.is_pending_disconnect = MARI_PEER_LOST_BLOOM;
             return;
         }
 
+        int16_t uplink_index = mr_scheduler_node_get_uplink_index();
+        if (uplink_index >= 0 && beacon->uplink_received[uplink_index / 8] & (1 << (uplink_index % 8))) {
+            // the gateway received the frame sent in my last uplink cell, no need to send it again
+            mr_queue_in_flight_done();
+        }
+
         mr_assoc_node_keep_gateway_alive(mr_mac_get_asn());
     }
 
     if (from_my_gateway && assoc_vars.state >= JOIN_STATE_SYNCED) {
         // save the remaining capacity of my gateway
         assoc_vars.synced_gateway_remaining_capacity = beacon->remaining_capacity;
+        if (beacon->switch_countdown != 0) {
+            // follow the gateway to its next schedule, keeping the same uplink index
+            mr_scheduler_node_set_pending_switch(beacon->next_schedule_id, beacon->asn + beacon->switch_countdown);
+        }
+        mr_scheduler_node_set_channel_map(beacon->channel_map, beacon->asn + beacon->channel_map_countdown);
     }
 
     if (beacon->remaining_capacity == 0) {  // TODO: what if I am joined to this gateway? add a check for it.
@@ -27,6 +27,21 @@ typedef enum {
     JOIN_STATE_JOINED   = 16,
 } mr_assoc_state_t;
 
+typedef struct {
+    mr_assoc_state_t state;
+    mr_event_cb_t    mari_event_callback;
+    uint32_t         last_state_change_ts;  ///< Last time the state changed
+    uint16_t         network_id;            ///< If gateway, puts it in the beacon packet. If node, uses it to filter beacons (0 means accept any network)
+
+    // node
+    uint32_t       last_received_from_gateway_asn;  ///< Last received packet when in joined state
+    int16_t        backoff_n;
+    uint8_t        backoff_random_time;                ///< Number of slots to wait before re-trying to join
+    uint32_t       join_response_timeout_ts;           ///< Time when the node will give up joining
+    uint16_t       synced_gateway_remaining_capacity;  ///< Number of nodes that my gateway can still accept
+    mr_event_tag_t is_pending_disconnect;              ///< Whether the node is pending a disconnect
+} mr_assoc_vars_t;
+
 //=========================== variables ========================================
 
 //=========================== prototypes =======================================
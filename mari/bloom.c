@@ -4,6 +4,17 @@
  *
  * @brief       Bloom filter
  *
+ * The gateway maintains a counting bloom filter: each join or leave updates
+ * the counters of k bits, and the resulting filter is published into one of
+ * two snapshots. Beacons, built in the timer interrupt, always copy the
+ * snapshot published last, which is never written while it is published.
+ *
+ * The snapshot holds whichever membership encoding is the shortest for the
+ * current occupancy: the filter folded to MARI_BLOOM_BITS_PER_NODE bits per
+ * joined node (the bits that are a multiple of its size apart are OR-ed, so a
+ * node only masks its hashes with a smaller size), or the fingerprints of the
+ * nodes in the uplink cells up to the last assigned one.
+ *
  * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
  *
  * @copyright Inria, 2025
@@ -16,22 +27,22 @@
 
 #include "bloom.h"
 #include "scheduler.h"
+#include "context.h"
 
 //=========================== defines ==========================================
 
-typedef struct {
-    // used by the gateway
-    bool    is_dirty;                   // true if the bloom filter needs to be re-computed
-    bool    is_available;               // true if the bloom filter is being computed
-    uint8_t bloom[MARI_BLOOM_M_BYTES];  // bloom filter output
-} bloom_vars_t;
-
 //=========================== variables ========================================
 
-static bloom_vars_t bloom_vars = { 0 };
+// state of the selected mari instance, see context.h
+#define bloom_vars (mr_ctx->bloom)
 
 //=========================== prototypes =======================================
 
+static void    _add(uint64_t h1, uint64_t h2, uint8_t uplink_index);
+static uint8_t _fingerprint(uint64_t h1);
+static uint8_t _bloom_len(uint8_t n_nodes);
+static void    _publish(void);
+
 //=========================== public ===========================================
 
 // FNV-1a 64-bit hash
@@ -48,74 +59,86 @@ uint64_t mr_bloom_hash_fnv1a64(uint64_t input) {
 // -------- gateway ---------
 
 void mr_bloom_gateway_init(void) {
-    bloom_vars.is_dirty     = false;
-    bloom_vars.is_available = false;
-}
-
-void mr_bloom_gateway_set_dirty(void) {
-    bloom_vars.is_dirty = true;
+    memset(&bloom_vars, 0, sizeof(bloom_vars));
+    // no node joined yet
+    bloom_vars.snapshots[0].encoding = MARI_MEMBERSHIP_FINGERPRINTS;
+    bloom_vars.snapshots[1].encoding = MARI_MEMBERSHIP_FINGERPRINTS;
 }
 
-void mr_bloom_gateway_set_clean(void) {
-    bloom_vars.is_dirty = false;
+void mr_bloom_gateway_add(uint64_t h1, uint64_t h2, uint8_t uplink_index) {
+    _add(h1, h2, uplink_index);
+    _publish();
 }
 
-bool mr_bloom_gateway_is_dirty(void) {
-    return bloom_vars.is_dirty;
-}
-
-bool mr_bloom_gateway_is_available(void) {
-    return bloom_vars.is_available;
+void mr_bloom_gateway_remove(uint64_t h1, uint64_t h2, uint8_t uplink_index) {
+    for (int k = 0; k < MARI_BLOOM_K_HASHES; k++) {
+        uint64_t idx = (h1 + k * h2) & (MARI_BLOOM_M_BITS - 1);  // Fast bitmask instead of division
+        if (bloom_vars.counters[idx] == UINT8_MAX) {
+            continue;  // saturated, the number of nodes setting this bit is unknown
+        }
+        if (--bloom_vars.counters[idx] == 0) {
+            bloom_vars.working[idx / 8] &= ~(1 << (idx % 8));
+        }
+    }
+    if (uplink_index < MARI_MEMBERSHIP_MAX_BYTES) {
+        bloom_vars.fingerprints[uplink_index] = 0;
+    }
+    while (bloom_vars.fingerprints_len > 0 && bloom_vars.fingerprints[bloom_vars.fingerprints_len - 1] == 0) {
+        bloom_vars.fingerprints_len--;
+    }
+    bloom_vars.n_nodes--;
+    _publish();
 }
 
-uint8_t mr_bloom_gateway_copy(uint8_t *output) {
-    memcpy(output, bloom_vars.bloom, MARI_BLOOM_M_BYTES);
-    return MARI_BLOOM_M_BYTES;
+uint8_t mr_bloom_gateway_copy(uint8_t *encoding, uint8_t *output) {
+    const mr_membership_t *snapshot = &bloom_vars.snapshots[bloom_vars.published];
+    *encoding                       = snapshot->encoding;
+    memcpy(output, snapshot->data, snapshot->len);
+    return snapshot->len;
 }
 
+// rebuild the filter from all the assigned cells
 void mr_bloom_gateway_compute(void) {
-    bloom_vars.is_available = false;
-    memset(bloom_vars.bloom, 0, MARI_BLOOM_M_BYTES);
+    memset(bloom_vars.counters, 0, sizeof(bloom_vars.counters));
+    memset(bloom_vars.working, 0, sizeof(bloom_vars.working));
+    memset(bloom_vars.fingerprints, 0, sizeof(bloom_vars.fingerprints));
+    bloom_vars.fingerprints_len = 0;
+    bloom_vars.n_nodes          = 0;
 
-    schedule_t *schedule_ptr = mr_scheduler_get_active_schedule_ptr();
+    const schedule_t *schedule_ptr = mr_scheduler_get_active_schedule_ptr();
 
+    uint8_t uplink_index = 0;
     for (size_t i = 0; i < schedule_ptr->n_cells; i++) {
-        cell_t *cell = &schedule_ptr->cells[i];
-        if (cell->type != SLOT_TYPE_UPLINK) {
+        if (schedule_ptr->cells[i].type != SLOT_TYPE_UPLINK) {
             continue;  // skip non-uplink cells
         }
-        if (cell->assigned_node_id == NULL) {
-            continue;  // skip empty cells
-        }
-
-        uint64_t h1 = cell->bloom_h1;
-        uint64_t h2 = cell->bloom_h2;
-
-        for (int k = 0; k < MARI_BLOOM_K_HASHES; k++) {
-            uint64_t idx = (h1 + k * h2) & (MARI_BLOOM_M_BITS - 1);  // Fast bitmask instead of division
-            bloom_vars.bloom[idx / 8] |= (1 << (idx % 8));
+        const mr_cell_assignment_t *cell = mr_scheduler_get_cell_assignment(i);
+        if (cell->assigned_node_id != 0) {
+            _add(cell->bloom_h1, cell->bloom_h2, uplink_index);
         }
+        uplink_index++;
     }
-    bloom_vars.is_available = true;
-}
-
-void mr_bloom_gateway_event_loop(void) {
-    // check if the bloom filter needs to be re-computed
-    if (mr_bloom_gateway_is_dirty()) {
-        mr_bloom_gateway_compute();
-        mr_bloom_gateway_set_clean();
-    }
+    _publish();
 }
 
 // -------- node ---------
 
-bool mr_bloom_node_contains(uint64_t node_id, const uint8_t *bloom) {
+bool mr_bloom_node_contains(uint64_t node_id, int16_t uplink_index, uint8_t encoding, const uint8_t *membership, uint8_t len) {
     uint64_t h1 = mr_bloom_hash_fnv1a64(node_id);
-    uint64_t h2 = mr_bloom_hash_fnv1a64(node_id ^ MARI_BLOOM_FNV1A_H2_SALT);
 
+    if (encoding == MARI_MEMBERSHIP_FINGERPRINTS) {
+        return uplink_index >= 0 && uplink_index < len && membership[uplink_index] == _fingerprint(h1);
+    }
+
+    if (encoding != MARI_MEMBERSHIP_BLOOM || len == 0 || (len & (len - 1)) != 0) {
+        return false;  // unknown encoding, or not a folded filter
+    }
+
+    uint64_t h2     = mr_bloom_hash_fnv1a64(node_id ^ MARI_BLOOM_FNV1A_H2_SALT);
+    uint32_t m_bits = len * 8;
     for (int k = 0; k < MARI_BLOOM_K_HASHES; k++) {
-        uint64_t idx = (h1 + k * h2) & (MARI_BLOOM_M_BITS - 1);  // Fast bitmask instead of division
-        if ((bloom[idx / 8] & (1 << (idx % 8))) == 0) {
+        uint64_t idx = (h1 + k * h2) & (m_bits - 1);  // Fast bitmask instead of division
+        if ((membership[idx / 8] & (1 << (idx % 8))) == 0) {
             return false;
         }
     }
@@ -123,3 +146,61 @@ bool mr_bloom_node_contains(uint64_t node_id, const uint8_t *bloom) {
 }
 
 //=========================== private ==========================================
+
+static void _add(uint64_t h1, uint64_t h2, uint8_t uplink_index) {
+    for (int k = 0; k < MARI_BLOOM_K_HASHES; k++) {
+        uint64_t idx = (h1 + k * h2) & (MARI_BLOOM_M_BITS - 1);  // Fast bitmask instead of division
+        if (bloom_vars.counters[idx] < UINT8_MAX) {
+            bloom_vars.counters[idx]++;
+        }
+        bloom_vars.working[idx / 8] |= (1 << (idx % 8));
+    }
+    if (uplink_index < MARI_MEMBERSHIP_MAX_BYTES) {
+        bloom_vars.fingerprints[uplink_index] = _fingerprint(h1);
+        if (uplink_index >= bloom_vars.fingerprints_len) {
+            bloom_vars.fingerprints_len = uplink_index + 1;
+        }
+    }
+    bloom_vars.n_nodes++;
+}
+
+// the top byte of the hash, as the bloom filter uses the lowest bits; 0 marks a free cell
+static uint8_t _fingerprint(uint64_t h1) {
+    uint8_t fingerprint = h1 >> 56;
+    return fingerprint == 0 ? 1 : fingerprint;
+}
+
+// smallest power of two number of bytes with MARI_BLOOM_BITS_PER_NODE bits per node
+static uint8_t _bloom_len(uint8_t n_nodes) {
+    uint16_t needed = (n_nodes * MARI_BLOOM_BITS_PER_NODE + 7) / 8;
+    uint16_t len    = MARI_BLOOM_MIN_BYTES;
+    while (len < needed && len < MARI_BLOOM_M_BYTES) {
+        len *= 2;
+    }
+    return len;
+}
+
+static void _publish(void) {
+    // write the snapshot that is not read by the beacons, then switch with a single byte write
+    uint8_t          next     = !bloom_vars.published;
+    mr_membership_t *snapshot = &bloom_vars.snapshots[next];
+
+    // fingerprints are exact, use them unless a filter is shorter, or some uplink cells cannot have one
+    uint8_t bloom_len        = _bloom_len(bloom_vars.n_nodes);
+    bool    fingerprints_fit = mr_scheduler_get_active_schedule_ptr()->max_nodes <= MARI_MEMBERSHIP_MAX_BYTES;
+    if (fingerprints_fit && bloom_vars.fingerprints_len <= bloom_len) {
+        snapshot->encoding = MARI_MEMBERSHIP_FINGERPRINTS;
+        snapshot->len      = bloom_vars.fingerprints_len;
+        memcpy(snapshot->data, bloom_vars.fingerprints, bloom_vars.fingerprints_len);
+    } else {
+        snapshot->encoding = MARI_MEMBERSHIP_BLOOM;
+        snapshot->len      = bloom_len;
+        memcpy(snapshot->data, bloom_vars.working, bloom_len);
+        for (size_t offset = bloom_len; offset < MARI_BLOOM_M_BYTES; offset += bloom_len) {
+            for (size_t i = 0; i < bloom_len; i++) {
+                snapshot->data[i] |= bloom_vars.working[offset + i];
+            }
+        }
+    }
+    bloom_vars.published = next;
+}
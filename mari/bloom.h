@@ -5,6 +5,10 @@
  * @ingroup     mari
  * @brief       Bloom filter header file
  *
+ * Beacons tell the nodes whether they are still joined, using the smallest of
+ * two encodings of the gateway membership: a bloom filter folded to a size
+ * that fits the number of joined nodes, or one fingerprint per uplink cell.
+ *
  * @{
  * @file
  * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
@@ -18,12 +22,39 @@
 
 //=========================== defines =========================================
 
-#define MARI_BLOOM_M_BITS   1024
-#define MARI_BLOOM_M_BYTES  (MARI_BLOOM_M_BITS / 8)
-#define MARI_BLOOM_K_HASHES 2
+#define MARI_BLOOM_M_BITS        1024  // size of the filter kept by the gateway, beacons carry it folded to fewer bits
+#define MARI_BLOOM_M_BYTES       (MARI_BLOOM_M_BITS / 8)
+#define MARI_BLOOM_MIN_BYTES     8
+#define MARI_BLOOM_BITS_PER_NODE 20  // about 1% of false positives with 2 hashes
+#define MARI_BLOOM_K_HASHES      2
 
 #define MARI_BLOOM_FNV1A_H2_SALT 0x5bd1e995
 
+#define MARI_MEMBERSHIP_MAX_BYTES MARI_BLOOM_M_BYTES
+
+typedef enum {
+    MARI_MEMBERSHIP_BLOOM        = 1,  // bloom filter, folded to a power of two number of bytes
+    MARI_MEMBERSHIP_FINGERPRINTS = 2,  // one byte per uplink cell, the fingerprint of its node or 0 when free
+} mr_membership_encoding_t;
+
+// membership of the nodes to a gateway, as sent in the beacons
+typedef struct {
+    uint8_t encoding;  // mr_membership_encoding_t
+    uint8_t len;
+    uint8_t data[MARI_MEMBERSHIP_MAX_BYTES];
+} mr_membership_t;
+
+typedef struct {
+    // used by the gateway
+    uint8_t          counters[MARI_BLOOM_M_BITS];              // number of nodes setting each bit (counting bloom filter), sticky once saturated
+    uint8_t          working[MARI_BLOOM_M_BYTES];              // bits with a non-zero counter
+    uint8_t          fingerprints[MARI_MEMBERSHIP_MAX_BYTES];  // fingerprint of the node assigned to each uplink cell, 0 when free
+    uint8_t          fingerprints_len;                         // last assigned uplink cell + 1
+    uint8_t          n_nodes;                                  // number of nodes in the filter
+    mr_membership_t  snapshots[2];                             // encoded membership, one snapshot being read by the beacons
+    volatile uint8_t published;                                // index of the snapshot read by the beacons
+} mr_bloom_vars_t;
+
 //=========================== variables =======================================
 
 //=========================== prototypes ======================================
@@ -31,14 +62,22 @@
 uint64_t mr_bloom_hash_fnv1a64(uint64_t input);
 
 void    mr_bloom_gateway_init(void);
-void    mr_bloom_gateway_set_dirty(void);
-void    mr_bloom_gateway_set_clean(void);
-bool    mr_bloom_gateway_is_dirty(void);
-bool    mr_bloom_gateway_is_available(void);
-uint8_t mr_bloom_gateway_copy(uint8_t *output);
+void    mr_bloom_gateway_add(uint64_t h1, uint64_t h2, uint8_t uplink_index);
+void    mr_bloom_gateway_remove(uint64_t h1, uint64_t h2, uint8_t uplink_index);
+uint8_t mr_bloom_gateway_copy(uint8_t *encoding, uint8_t *output);
 void    mr_bloom_gateway_compute(void);
-void    mr_bloom_gateway_event_loop(void);
 
-bool mr_bloom_node_contains(uint64_t node_id, const uint8_t *bloom);
+/**
+ * @brief Checks whether a node is part of the membership sent by its gateway.
+ *
+ * @param[in] node_id           ID of the node
+ * @param[in] uplink_index      Position of the cell of the node among the uplink cells, -1 if it has none
+ * @param[in] encoding          Encoding of the membership, see mr_membership_encoding_t
+ * @param[in] membership        Membership, as received in the beacon
+ * @param[in] len               Length of the membership
+ *
+ * @return true if the node is (likely, for a bloom filter) joined to the gateway
+ */
+bool mr_bloom_node_contains(uint64_t node_id, int16_t uplink_index, uint8_t encoding, const uint8_t *membership, uint8_t len);
 
 #endif  // __BLOOM_H
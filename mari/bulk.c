@@ -0,0 +1,336 @@
+/**
+ * @file
+ * @ingroup     bulk
+ *
+ * @brief       Reliable bulk transfer of an image from a gateway to all its nodes
+ *
+ * The gateway multicasts the image in numbered chunks, in the downlink cells
+ * that the queue leaves free. It first sends all the chunks in order. Nodes
+ * append to their keepalives a bitmap of the chunks they miss, starting from
+ * their first hole, and the gateway sends again the union of the reported
+ * holes. So the image takes about one image worth of airtime, plus the
+ * repairs, whatever the number of nodes. Once a node has all the chunks, its
+ * keepalives say so, and the transfer is over when all the joined nodes did.
+ * Nodes that got no chunk at all, such as the ones that joined late, do not
+ * report: when there is nothing left to send, the gateway sends the first
+ * chunk again every few slotframes, and gives up after a number of tries.
+ *
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ *
+ * @copyright Inria, 2025
+ */
+
+#include <nrf.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "packet.h"
+#include "scheduler.h"
+#include "mac.h"
+#include "bulk.h"
+#include "context.h"
+
+//=========================== defines ==========================================
+
+_Static_assert(MARI_PACKET_MAX_SIZE - sizeof(mr_packet_header_t) - sizeof(mr_bulk_chunk_header_t) <= UINT8_MAX, "the chunk size is sent on one byte");
+
+//=========================== variables ========================================
+
+// state of the selected mari instance, see context.h
+#define bulk_vars (mr_ctx->bulk)
+
+//=========================== prototypes =======================================
+
+// whether all the joined nodes have all the chunks
+static bool _gateway_all_done(void);
+
+// ends the transfer of the gateway, with MARI_BULK_COMPLETE or MARI_BULK_ABORTED
+static void _gateway_end(mr_event_t event);
+
+// number of chunks of an image
+static uint16_t _n_chunks(uint32_t image_len, uint8_t chunk_size);
+
+static bool _bit_get(const uint8_t *bitmap, uint16_t index);
+static void _bit_set(uint8_t *bitmap, uint16_t index);
+static void _bit_clear(uint8_t *bitmap, uint16_t index);
+
+//=========================== public ===========================================
+
+void mr_bulk_init(mr_event_cb_t event_callback) {
+    memset(&bulk_vars, 0, sizeof(mr_bulk_vars_t));
+    bulk_vars.event_callback = event_callback;
+}
+
+// ------------ gateway functions ---------
+
+bool mr_bulk_gateway_start(const uint8_t *image, uint32_t image_len) {
+    // the chunks fill the downlink cells of the current schedule, which must leave room for some data after the headers
+    size_t max_len = mr_scheduler_get_max_frame_len(SLOT_TYPE_DOWNLINK);
+    if (max_len <= sizeof(mr_packet_header_t) + sizeof(mr_bulk_chunk_header_t) || max_len - sizeof(mr_packet_header_t) - sizeof(mr_bulk_chunk_header_t) > UINT8_MAX) {
+        return false;
+    }
+    uint8_t chunk_size = max_len - sizeof(mr_packet_header_t) - sizeof(mr_bulk_chunk_header_t);
+    if (bulk_vars.transfer_id != 0 || image_len == 0 || _n_chunks(image_len, chunk_size) > MARI_BULK_MAX_CHUNKS) {
+        return false;
+    }
+
+    bulk_vars.image          = image;
+    bulk_vars.image_len      = image_len;
+    bulk_vars.chunk_size     = chunk_size;
+    bulk_vars.n_chunks       = _n_chunks(image_len, chunk_size);
+    bulk_vars.cursor         = 0;
+    bulk_vars.chunks_sent    = 0;
+    bulk_vars.last_chunk_asn = mr_mac_get_asn();
+    bulk_vars.resends        = 0;
+    memset(bulk_vars.pending, 0, sizeof(bulk_vars.pending));
+    for (uint16_t i = 0; i < bulk_vars.n_chunks; i++) {
+        _bit_set(bulk_vars.pending, i);
+    }
+
+    // a new id, never 0
+    bulk_vars.last_transfer_id = bulk_vars.last_transfer_id == UINT8_MAX ? 1 : bulk_vars.last_transfer_id + 1;
+    bulk_vars.transfer_id      = bulk_vars.last_transfer_id;
+
+    // nodes that had a previous transfer are not done with this one
+    for (size_t i = 0; i < mr_scheduler_get_active_schedule_ptr()->n_cells; i++) {
+        mr_scheduler_get_cell_assignment(i)->bulk_done = false;
+    }
+    return true;
+}
+
+void mr_bulk_gateway_stop(void) {
+    bulk_vars.transfer_id = 0;
+    bulk_vars.image       = NULL;
+}
+
+size_t mr_bulk_gateway_build_chunk(uint8_t *buffer, size_t max_len) {
+    if (bulk_vars.transfer_id == 0 || mr_scheduler_gateway_get_nodes_count() == 0) {
+        return 0;
+    }
+
+    // next pending chunk, going around from the cursor
+    uint16_t index = bulk_vars.cursor;
+    for (uint16_t i = 0; i < bulk_vars.n_chunks && !_bit_get(bulk_vars.pending, index); i++) {
+        index = index + 1 < bulk_vars.n_chunks ? index + 1 : 0;
+    }
+    if (!_bit_get(bulk_vars.pending, index)) {
+        // nothing to repair for now
+        return 0;
+    }
+
+    uint32_t offset   = (uint32_t)index * bulk_vars.chunk_size;
+    uint8_t  data_len = bulk_vars.image_len - offset < bulk_vars.chunk_size ? bulk_vars.image_len - offset : bulk_vars.chunk_size;
+    if (sizeof(mr_packet_header_t) + sizeof(mr_bulk_chunk_header_t) + data_len > max_len) {
+        // the downlink cells got shorter since the transfer started
+        return 0;
+    }
+
+    _bit_clear(bulk_vars.pending, index);
+    bulk_vars.cursor         = index + 1 < bulk_vars.n_chunks ? index + 1 : 0;
+    bulk_vars.last_chunk_asn = mr_mac_get_asn();
+    bulk_vars.chunks_sent++;
+
+    mr_bulk_chunk_header_t chunk = {
+        .transfer_id = bulk_vars.transfer_id,
+        .index       = index,
+        .chunk_size  = bulk_vars.chunk_size,
+        .image_len   = bulk_vars.image_len,
+    };
+    return mr_build_packet_bulk_chunk(buffer, &chunk, bulk_vars.image + offset, data_len);
+}
+
+void mr_bulk_gateway_handle_report(uint64_t node_id, const uint8_t *report, size_t len) {
+    const mr_bulk_report_header_t *header = (const mr_bulk_report_header_t *)report;
+    if (len < sizeof(mr_bulk_report_header_t) || bulk_vars.transfer_id == 0 || header->transfer_id != bulk_vars.transfer_id) {
+        return;
+    }
+    int16_t cell_index = mr_scheduler_gateway_get_node_cell(node_id);
+    if (cell_index < 0) {
+        return;
+    }
+
+    mr_cell_assignment_t *assignment = mr_scheduler_get_cell_assignment(cell_index);
+    assignment->bulk_done            = header->first >= bulk_vars.n_chunks;
+    if (!assignment->bulk_done) {
+        // add the holes of the node to the chunks to send
+        const uint8_t *bitmap = report + sizeof(mr_bulk_report_header_t);
+        size_t         n_bits = (len - sizeof(mr_bulk_report_header_t)) * 8;
+        for (size_t i = 0; i < n_bits && header->first + i < bulk_vars.n_chunks; i++) {
+            if (_bit_get(bitmap, i)) {
+                _bit_set(bulk_vars.pending, header->first + i);
+            }
+        }
+        return;
+    }
+
+    if (_gateway_all_done()) {
+        _gateway_end(MARI_BULK_COMPLETE);
+    }
+}
+
+// called at each slot: a transfer with no chunk to send for a while either is over, or waits for nodes that do not report
+void mr_bulk_gateway_check_idle(uint64_t asn) {
+    if (bulk_vars.transfer_id == 0 || asn - bulk_vars.last_chunk_asn < (uint64_t)mr_scheduler_get_active_schedule_slot_count() * MARI_BULK_IDLE_SLOTFRAMES) {
+        return;
+    }
+    for (uint16_t i = 0; i < (bulk_vars.n_chunks + 7) / 8; i++) {
+        if (bulk_vars.pending[i]) {
+            // the chunks were not sent for lack of room, the transfer is not idle
+            return;
+        }
+    }
+
+    if (_gateway_all_done()) {
+        // the last nodes that were not done left
+        _gateway_end(MARI_BULK_COMPLETE);
+    } else if (bulk_vars.resends >= MARI_BULK_MAX_RESENDS) {
+        // the nodes that are not done cannot get or report the chunks
+        _gateway_end(MARI_BULK_ABORTED);
+    } else {
+        // the nodes that missed all the chunks, or joined after them, do not know about the transfer and do not report:
+        // the first chunk tells them, and they report their holes from then on
+        bulk_vars.resends++;
+        bulk_vars.last_chunk_asn = asn;
+        _bit_set(bulk_vars.pending, 0);
+    }
+}
+
+// ------------ node functions ------------
+
+void mr_bulk_node_handle_chunk(uint64_t gateway_id, const uint8_t *chunk, size_t len) {
+    const mr_bulk_chunk_header_t *header = (const mr_bulk_chunk_header_t *)chunk;
+    if (len < sizeof(mr_bulk_chunk_header_t) || header->transfer_id == 0 || header->chunk_size == 0) {
+        return;
+    }
+
+    if (header->transfer_id != bulk_vars.rx_transfer_id || gateway_id != bulk_vars.rx_gateway_id) {
+        // a new transfer, possibly from another gateway after a handover
+        uint16_t n_chunks = _n_chunks(header->image_len, header->chunk_size);
+        if (n_chunks > MARI_BULK_MAX_CHUNKS) {
+            return;
+        }
+        bulk_vars.rx_gateway_id  = gateway_id;
+        bulk_vars.rx_transfer_id = header->transfer_id;
+        bulk_vars.rx_image_len   = header->image_len;
+        bulk_vars.rx_chunk_size  = header->chunk_size;
+        bulk_vars.rx_n_chunks    = n_chunks;
+        bulk_vars.rx_missing     = n_chunks;
+        memset(bulk_vars.received, 0, sizeof(bulk_vars.received));
+    }
+
+    if (header->chunk_size != bulk_vars.rx_chunk_size || header->image_len != bulk_vars.rx_image_len || header->index >= bulk_vars.rx_n_chunks) {
+        // does not belong to the transfer as it started
+        return;
+    }
+    // all the chunks are full, but the last one, which has the rest of the image
+    uint32_t offset   = (uint32_t)header->index * header->chunk_size;
+    size_t   data_len = len - sizeof(mr_bulk_chunk_header_t);
+    size_t   expected = bulk_vars.rx_image_len - offset < header->chunk_size ? bulk_vars.rx_image_len - offset : header->chunk_size;
+    if (data_len != expected || _bit_get(bulk_vars.received, header->index)) {
+        // truncated, or a repair for another node
+        return;
+    }
+    _bit_set(bulk_vars.received, header->index);
+    bulk_vars.rx_missing--;
+
+    mr_event_data_t event_data = {
+        .data.bulk = {
+            .transfer_id = header->transfer_id,
+            .image_len   = header->image_len,
+            .offset      = offset,
+            .data        = chunk + sizeof(mr_bulk_chunk_header_t),
+            .len         = data_len,
+        }
+    };
+    bulk_vars.event_callback(MARI_BULK_CHUNK, event_data);
+    if (bulk_vars.rx_missing == 0) {
+        event_data.data.bulk.offset = 0;
+        event_data.data.bulk.data   = NULL;
+        event_data.data.bulk.len    = 0;
+        bulk_vars.event_callback(MARI_BULK_COMPLETE, event_data);
+    }
+}
+
+size_t mr_bulk_node_build_report(uint8_t *buffer, size_t max_len) {
+    if (bulk_vars.rx_transfer_id == 0 || bulk_vars.rx_gateway_id != mr_mac_get_synced_gateway() || max_len < sizeof(mr_bulk_report_header_t)) {
+        return 0;
+    }
+
+    mr_bulk_report_header_t header = {
+        .transfer_id = bulk_vars.rx_transfer_id,
+        .first       = bulk_vars.rx_n_chunks,
+    };
+    if (bulk_vars.rx_missing == 0) {
+        // nothing missing, no bitmap
+        memcpy(buffer, &header, sizeof(mr_bulk_report_header_t));
+        return sizeof(mr_bulk_report_header_t);
+    }
+
+    // the bitmap starts at the byte of the first hole
+    size_t n_bytes = (bulk_vars.rx_n_chunks + 7) / 8;
+    size_t first   = 0;
+    while (bulk_vars.received[first] == 0xFF) {
+        first++;
+    }
+    size_t len = n_bytes - first;
+    if (len > MARI_BULK_REPORT_MAX_LEN) {
+        len = MARI_BULK_REPORT_MAX_LEN;
+    }
+    if (len > max_len - sizeof(mr_bulk_report_header_t)) {
+        len = max_len - sizeof(mr_bulk_report_header_t);
+    }
+    if (len == 0) {
+        return 0;
+    }
+
+    header.first    = first * 8;
+    uint8_t *bitmap = buffer + sizeof(mr_bulk_report_header_t);
+    for (size_t i = 0; i < len; i++) {
+        bitmap[i] = ~bulk_vars.received[first + i];
+    }
+    memcpy(buffer, &header, sizeof(mr_bulk_report_header_t));
+    return sizeof(mr_bulk_report_header_t) + len;
+}
+
+//=========================== private ==========================================
+
+static bool _gateway_all_done(void) {
+    const schedule_t *schedule = mr_scheduler_get_active_schedule_ptr();
+    for (size_t i = 0; i < schedule->n_cells; i++) {
+        const mr_cell_assignment_t *assignment = mr_scheduler_get_cell_assignment(i);
+        if (schedule->cells[i].type == SLOT_TYPE_UPLINK && assignment->assigned_node_id != 0 && !assignment->bulk_done) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void _gateway_end(mr_event_t event) {
+    mr_event_data_t event_data = {
+        .data.bulk = {
+            .transfer_id = bulk_vars.transfer_id,
+            .image_len   = bulk_vars.image_len,
+            .chunks_sent = bulk_vars.chunks_sent,
+        }
+    };
+    mr_bulk_gateway_stop();
+    bulk_vars.event_callback(event, event_data);
+}
+
+static uint16_t _n_chunks(uint32_t image_len, uint8_t chunk_size) {
+    uint32_t n_chunks = (image_len + chunk_size - 1) / chunk_size;
+    return n_chunks > MARI_BULK_MAX_CHUNKS ? MARI_BULK_MAX_CHUNKS + 1 : n_chunks;
+}
+
+static bool _bit_get(const uint8_t *bitmap, uint16_t index) {
+    return bitmap[index / 8] & (1 << (index % 8));
+}
+
+static void _bit_set(uint8_t *bitmap, uint16_t index) {
+    bitmap[index / 8] |= 1 << (index % 8);
+}
+
+static void _bit_clear(uint8_t *bitmap, uint16_t index) {
+    bitmap[index / 8] &= ~(1 << (index % 8));
+}
@@ -0,0 +1,68 @@
+#ifndef __BULK_H
+#define __BULK_H
+
+/**
+ * @ingroup     mari
+ * @brief       Reliable bulk transfer of an image from a gateway to all its nodes
+ *
+ * @{
+ * @file
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "models.h"
+
+//=========================== defines =========================================
+
+#define MARI_BULK_MAX_CHUNKS      (2048)                      // chunks of an image, at most
+#define MARI_BULK_BITMAP_BYTES    (MARI_BULK_MAX_CHUNKS / 8)  // one bit per chunk
+#define MARI_BULK_REPORT_MAX_LEN  (16)                        // bytes of the bitmap of missing chunks sent by a node, 128 chunks
+#define MARI_BULK_IDLE_SLOTFRAMES (4)                         // slotframes without a chunk to send, after which the first chunk is sent again
+#define MARI_BULK_MAX_RESENDS     (16)                        // times the first chunk is sent again, before the transfer is given up
+
+typedef struct {
+    // used by the gateway
+    const uint8_t *image;
+    uint32_t       image_len;
+    uint16_t       n_chunks;
+    uint8_t        chunk_size;
+    uint8_t        transfer_id;                      // of the transfer being sent, 0 when none
+    uint8_t        last_transfer_id;                 // so that each transfer gets a new id
+    uint16_t       cursor;                           // chunk from which the next one to send is searched
+    uint16_t       chunks_sent;                      // during the transfer, repairs included
+    uint64_t       last_chunk_asn;                   // when the last chunk was sent, or the transfer started
+    uint8_t        resends;                          // times the first chunk was sent again for the nodes that do not report
+    uint8_t        pending[MARI_BULK_BITMAP_BYTES];  // chunks to send: all of them at first, then the union of the holes reported by the nodes
+
+    // used by the node
+    uint64_t rx_gateway_id;                     // gateway of the transfer being received
+    uint8_t  rx_transfer_id;                    // of the transfer being received, 0 when none
+    uint32_t rx_image_len;
+    uint8_t  rx_chunk_size;                     // of the first chunk of the transfer, which all the others must have
+    uint16_t rx_n_chunks;
+    uint16_t rx_missing;                        // chunks not received yet
+    uint8_t  received[MARI_BULK_BITMAP_BYTES];  // chunks received
+
+    mr_event_cb_t event_callback;
+} mr_bulk_vars_t;
+
+//=========================== prototypes ======================================
+
+void mr_bulk_init(mr_event_cb_t event_callback);
+
+bool   mr_bulk_gateway_start(const uint8_t *image, uint32_t image_len);
+void   mr_bulk_gateway_stop(void);
+size_t mr_bulk_gateway_build_chunk(uint8_t *buffer, size_t max_len);
+void   mr_bulk_gateway_handle_report(uint64_t node_id, const uint8_t *report, size_t len);
+void   mr_bulk_gateway_check_idle(uint64_t asn);
+
+void   mr_bulk_node_handle_chunk(uint64_t gateway_id, const uint8_t *chunk, size_t len);
+size_t mr_bulk_node_build_report(uint8_t *buffer, size_t max_len);
+
+#endif  // __BULK_H
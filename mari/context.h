@@ -0,0 +1,59 @@
+#ifndef __CONTEXT_H
+#define __CONTEXT_H
+
+/**
+ * @ingroup     mari
+ * @brief       State of a mari instance
+ *
+ * All the protocol state lives in a mari_ctx_t, and the mari_* and mr_*
+ * functions operate on the selected one (see mari_ctx_select). A device
+ * simply uses the default instance. Several instances allow running many
+ * stacks in the same address space, each one being selected before its
+ * functions or interrupt handlers are called.
+ *
+ * Schedules are not part of the instance: they are shared, read-only.
+ *
+ * @{
+ * @file
+ * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
+ * @copyright Inria, 2025-now
+ * @}
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "models.h"
+#include "mari.h"
+#include "mac.h"
+#include "association.h"
+#include "scheduler.h"
+#include "queue.h"
+#include "bloom.h"
+#include "bulk.h"
+#include "scan.h"
+
+//=========================== defines =========================================
+
+typedef struct {
+    mr_node_type_t node_type;
+    mr_event_cb_t  app_event_callback;
+} mr_mari_vars_t;
+
+struct mari_ctx {
+    mr_mari_vars_t       mari;
+    mr_mac_vars_t        mac;
+    mr_assoc_vars_t      assoc;
+    mr_scheduler_vars_t  scheduler;
+    mr_scheduler_stats_t scheduler_stats;
+    mr_queue_vars_t      queue;
+    mr_bloom_vars_t      bloom;
+    mr_scan_vars_t       scan;
+    mr_bulk_vars_t       bulk;
+};
+
+//=========================== variables =======================================
+
+extern mari_ctx_t *mr_ctx;  ///< Selected instance, never NULL
+
+#endif  // __CONTEXT_H
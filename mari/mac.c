@@ -13,6 +13,7 @@
 #include <nrf.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 
 #include "mari.h"
@@ -21,10 +22,12 @@
 #include "scan.h"
 #include "scheduler.h"
 #include "association.h"
+#include "bulk.h"
 #include "mr_radio.h"
 #include "mr_timer_hf.h"
 #include "packet.h"
 #include "mr_device.h"
+#include "context.h"
 
 //=========================== debug ============================================
 
@@ -55,54 +58,21 @@ mr_gpio_t pin3 = { .port = 1, .pin = 5 };
 
 //=========================== defines ==========================================
 
-typedef enum {
-    // common
-    STATE_SLEEP,
-
-    // transmitter
-    STATE_TX_OFFSET = 21,
-    STATE_TX_DATA   = 22,
-
-    // receiver
-    STATE_RX_OFFSET      = 31,
-    STATE_RX_DATA_LISTEN = 32,
-    STATE_RX_DATA        = 33,
-
-} mr_mac_state_t;
-
-typedef struct {
-    uint64_t device_id;  ///< Device ID
-
-    mr_mac_state_t state;              ///< State within the slot
-    uint32_t       start_slot_ts;      ///< Timestamp of the start of the slot
-    uint64_t       asn;                ///< Absolute slot number
-    mr_slot_info_t current_slot_info;  ///< Information about the current slot
-
-    mr_event_cb_t mari_event_callback;  ///< Function pointer, stores the application callback
-
-    mr_received_packet_t received_packet;  ///< Last received packet
-
-    bool     is_scanning;           ///< Whether the node is scanning for gateways
-    uint32_t scan_started_ts;       ///< Timestamp of the start of the scan
-    uint32_t scan_expected_end_ts;  ///< Timestamp of the expected end of the scan
-    uint32_t current_scan_item_ts;  ///< Timestamp of the current scan item
-
-    bool is_bg_scanning;           ///< Whether the node is scanning for gateways in the background
-    bool bg_scan_sleep_next_slot;  ///< Whether the next slot is a sleep slot
-
-    ///< This timestamp keeps track of a full handover scan, that is, a scan that
-    ///< Potentially spans multiple background scans (the bg scans are typically very short)
-    uint32_t full_bg_scan_started_ts;
-    uint32_t full_bg_scan_expected_end_ts;  ///< Timestamp of the expected end of the full handover scan
+// magic numbers: measured using the logic analyzer, they include the CPU time spent before the timers are armed
+#ifndef MARI_SYNC_TIME_CPU_AND_TOA
+#define MARI_SYNC_TIME_CPU_AND_TOA (541)  ///< From the start of a slot to the EVENTS_ADDRESS of its beacon, plus CPU time
+#endif
+#ifndef MARI_HANDOVER_TIME_CORRECTION
+#define MARI_HANDOVER_TIME_CORRECTION (206)  ///< Extra CPU time spent when synchronizing during a handover
+#endif
 
-    uint64_t synced_gateway;     ///< ID of the gateway the node is synchronized with
-    uint16_t synced_network_id;  ///< Network ID of the gateway the node is synchronized with
-    uint32_t synced_ts;          ///< Timestamp of the last synchronization
-} mac_vars_t;
+// queued packets are handed to the radio as PDUs, see mr_packet_t
+_Static_assert(offsetof(mr_packet_t, length) == offsetof(mr_radio_pdu_t, length) && offsetof(mr_packet_t, buffer) == offsetof(mr_radio_pdu_t, payload), "mr_packet_t must be laid out as a radio PDU");
 
 //=========================== variables ========================================
 
-mac_vars_t mac_vars = { 0 };
+// state of the selected mari instance, see context.h
+#define mac_vars (mr_ctx->mac)
 
 mr_slot_durations_t slot_durations = {
     .tx_offset = MARI_TS_TX_OFFSET,
@@ -112,6 +82,10 @@ mr_slot_durations_t slot_durations = {
     .rx_offset = MARI_TS_TX_OFFSET - MARI_RX_GUARD_TIME,
     .rx_max    = MARI_RX_GUARD_TIME + MARI_PACKET_TOA_WITH_PADDING,  // same as rx_guard + tx_max
 
+    .ack_tx_offset = MARI_TS_ACK_TX_OFFSET,
+    .ack_rx_offset = MARI_TS_ACK_TX_OFFSET - MARI_RX_GUARD_TIME,
+    .ack_max       = MARI_RX_GUARD_TIME + MARI_ACK_TOA_WITH_PADDING,
+
     .end_guard = MARI_END_GUARD_TIME,
 
     .whole_slot = MARI_WHOLE_SLOT_DURATION,
@@ -124,12 +98,18 @@ static inline void set_slot_state(mr_mac_state_t state);
 static void new_slot_synced(void);
 static void end_slot(void);
 static void node_back_to_scanning(void);
+static void node_out_of_sync(void);
 static void disable_radio_and_intra_slot_timers(void);
 
 static void activity_ti1(void);
 static void activity_ti2(void);
 static void activity_tie1(void);
-static void activity_ti3(void);
+static void activity_ti3(uint32_t ts);
+static void activity_ti4(void);
+static void activity_tie2(void);
+static void activity_ti5(void);
+static void activity_tie3(void);
+static void activity_ti6(void);
 
 static void activity_ri1(void);
 static void activity_ri2(void);
@@ -137,14 +117,24 @@ static void activity_ri3(uint32_t ts);
 static void activity_rie1(void);
 static void activity_ri4(uint32_t ts);
 static void activity_rie2(void);
+static void activity_ri5(void);
+static void activity_ri6(void);
+static void activity_rie3(void);
+static void activity_ri7(void);
 
-static void fix_drift(uint32_t ts);
+static bool should_ack(const mr_packet_header_t *header);
+
+static void     fix_drift(uint32_t ts);
+static uint32_t rx_guard(void);
 
 static void start_scan(void);
 static void end_scan(void);
 static void handle_scan_and_trigger_association(uint32_t now_ts);
 static void activity_scan_start_frame(uint32_t ts);
 static void activity_scan_end_frame(uint32_t ts);
+static void activity_scan_hop(void);
+static void activity_scan_rx(void);
+static void scan_next_channel(void);
 static bool sync_to_gateway(uint32_t now_ts, mr_channel_info_t *selected_gateway, uint32_t handover_time_correction_us);
 
 static void start_or_continue_background_scan(void);
@@ -196,6 +186,15 @@ uint64_t mr_mac_get_asn(void) {
     return mac_vars.asn;
 }
 
+bool mr_mac_is_drift_compensated(void) {
+    // once the frequency offset was refined a few times
+    return MARI_DRIFT_COMPENSATION && mac_vars.drift_windows >= MARI_DRIFT_MIN_WINDOWS;
+}
+
+uint8_t mr_mac_get_channel(void) {
+    return mac_vars.current_slot_info.channel;
+}
+
 uint32_t mr_mac_get_tiner_value(void) {
     return mr_timer_hf_now(MARI_TIMER_DEV);
 }
@@ -225,6 +224,9 @@ static void set_slot_state(mr_mac_state_t state) {
         case STATE_RX_DATA_LISTEN:
         case STATE_TX_DATA:
         case STATE_RX_DATA:
+        case STATE_RX_ACK_LISTEN:
+        case STATE_RX_ACK:
+        case STATE_TX_ACK:
             // DEBUG_GPIO_SET(&pin1);
             break;
         case STATE_SLEEP:
@@ -247,6 +249,8 @@ static void new_slot_synced(void) {
     if (mari_get_node_type() == MARI_GATEWAY) {
         // too long without receiving a packet from certain nodes? disconnect them
         mr_assoc_gateway_clear_old_nodes(mac_vars.asn);
+        // too long without a chunk to send? the bulk transfer is over, or some nodes do not know about it
+        mr_bulk_gateway_check_idle(mac_vars.asn);
     } else if (mari_get_node_type() == MARI_NODE) {
         if (mr_assoc_node_should_leave(mac_vars.asn)) {
             // assoc module determined that the node should leave, so disconnect and back to scanning
@@ -254,6 +258,11 @@ static void new_slot_synced(void) {
             node_back_to_scanning();
             return;
         }
+        if (mac_vars.resync_end_asn != 0 && mac_vars.asn >= mac_vars.resync_end_asn) {
+            // could not re-acquire the timing of the gateway in time, see fix_drift
+            node_out_of_sync();
+            return;
+        }
         if (mr_assoc_node_too_long_synced_without_joining()) {
             // too long synced without being able to join? give up and go back to scanning
             mr_assoc_node_handle_give_up_joining();
@@ -272,6 +281,22 @@ static void new_slot_synced(void) {
 
     mac_vars.current_slot_info = mr_scheduler_tick(mac_vars.asn++);
 
+    // the timer is periodic with the longest slot duration, shorten this tick to the duration of the cell
+    int32_t adjust_us = (int32_t)mac_vars.current_slot_info.duration_us - (int32_t)slot_durations.whole_slot;
+    if (MARI_DRIFT_COMPENSATION && mac_vars.drift_rate != 0) {
+        // and lengthen it by the drift expected over the slot, carrying the fractions of us over to the next slots
+        mac_vars.drift_remainder += mac_vars.drift_rate * (int32_t)mac_vars.current_slot_info.duration_us;
+        int32_t drift_us = mac_vars.drift_remainder / (1 << 24);
+        mac_vars.drift_remainder -= drift_us * (1 << 24);
+        adjust_us += drift_us;
+    }
+    if (adjust_us != 0) {
+        mr_timer_hf_adjust_periodic_us(
+            MARI_TIMER_DEV,
+            MARI_TIMER_INTER_SLOT_CHANNEL,
+            adjust_us);
+    }
+
     if (mac_vars.current_slot_info.radio_action == MARI_RADIO_ACTION_TX) {
         activity_ti1();
     } else if (mac_vars.current_slot_info.radio_action == MARI_RADIO_ACTION_RX) {
@@ -306,6 +331,16 @@ static void node_back_to_scanning(void) {
     start_scan();
 }
 
+static void node_out_of_sync(void) {
+    // FIXME: use `mr_assoc_node_handle_immediate_disconnect` instead
+    mr_event_data_t event_data = { .data.gateway_info.gateway_id = mac_vars.synced_gateway, .tag = MARI_OUT_OF_SYNC };
+    mac_vars.mari_event_callback(MARI_DISCONNECTED, event_data);
+    mr_assoc_set_state(JOIN_STATE_IDLE);
+    set_slot_state(STATE_SLEEP);
+    end_slot();
+    start_scan();
+}
+
 static void end_slot(void) {
     if (mari_get_node_type() == MARI_NODE && !mr_mac_node_is_synced()) {
         // not synced, so we are not in a slot
@@ -342,14 +377,16 @@ static void start_scan(void) {
 
     // mac_vars.assoc_info = mr_assoc_get_info(); // NOTE: why this?
 
+    // listen on each advertising channel in turn, each scan starting from the channel after the previous one
+    mr_timer_hf_set_oneshot_us(
+        MARI_TIMER_DEV,
+        MARI_TIMER_CHANNEL_3,
+        MARI_SCAN_DWELL,
+        &activity_scan_hop);
+
     set_slot_state(STATE_RX_DATA_LISTEN);
-    mr_radio_disable();
-#ifdef MARI_FIXED_SCAN_CHANNEL
-    mr_radio_set_channel(MARI_FIXED_SCAN_CHANNEL);  // not doing channel hopping for now
-#else
-    puts("Channel hopping not implemented yet for scanning");
-#endif
-    mr_radio_rx();
+    scan_next_channel();
+    activity_scan_rx();
 }
 
 static void end_scan(void) {
@@ -369,7 +406,7 @@ static void start_or_continue_background_scan(void) {
     // 1. prepare timestamps and and arm timer
     if (!mac_vars.is_bg_scanning) {
         mac_vars.scan_started_ts      = mac_vars.start_slot_ts;  // reuse the slot start time as reference
-        mac_vars.scan_expected_end_ts = mac_vars.scan_started_ts + MARI_BG_SCAN_DURATION;
+        mac_vars.scan_expected_end_ts = mac_vars.scan_started_ts + MARI_BG_SCAN_DURATION(mac_vars.current_slot_info.duration_us);
     }
 
     if (mac_vars.full_bg_scan_started_ts == 0) {
@@ -379,29 +416,24 @@ static void start_or_continue_background_scan(void) {
     }
 
     // check and save whether the next slot is a potential sleep slot
-    cell_t next_slot                  = mr_scheduler_node_peek_slot(mac_vars.asn);  // remember: the asn was already incremented at new_slot_synced
-    bool   next_uplink_is_sleep_slot  = next_slot.type == SLOT_TYPE_UPLINK && next_slot.assigned_node_id != mr_device_id();
-    bool   next_slot_is_shared_uplink = next_slot.type == SLOT_TYPE_SHARED_UPLINK;
-    mac_vars.bg_scan_sleep_next_slot  = next_uplink_is_sleep_slot || next_slot_is_shared_uplink;
+    mr_slot_info_t next_slot                  = mr_scheduler_node_peek_slot(mac_vars.asn);  // remember: the asn was already incremented at new_slot_synced
+    bool           next_uplink_is_sleep_slot  = next_slot.type == SLOT_TYPE_UPLINK && next_slot.radio_action == MARI_RADIO_ACTION_SLEEP;
+    bool           next_slot_is_shared_uplink = next_slot.type == SLOT_TYPE_SHARED_UPLINK;
+    mac_vars.bg_scan_sleep_next_slot          = next_uplink_is_sleep_slot || next_slot_is_shared_uplink;
 
     // end_background_scan will be called to check if the background scan should be stopped
     mr_timer_hf_set_oneshot_with_ref_us(
         MARI_TIMER_DEV,
-        MARI_TIMER_CHANNEL_1,    // remember that the inter-slot timer is already being used for the slot
-        mac_vars.start_slot_ts,  // in this case, we use the slot start time as reference because we are synced
-        MARI_BG_SCAN_DURATION,   // scan for some time during this slot
+        MARI_TIMER_CHANNEL_1,                                           // remember that the inter-slot timer is already being used for the slot
+        mac_vars.start_slot_ts,                                         // in this case, we use the slot start time as reference because we are synced
+        MARI_BG_SCAN_DURATION(mac_vars.current_slot_info.duration_us),  // scan for some time during this slot
         &end_background_scan);
 
     // 2. turn on the radio, in case it was off (bg scan might be already running since the last slot)
     if (!mac_vars.is_bg_scanning) {
         set_slot_state(STATE_RX_DATA_LISTEN);
-        mr_radio_disable();
-#ifdef MARI_FIXED_SCAN_CHANNEL
-        mr_radio_set_channel(MARI_FIXED_SCAN_CHANNEL);  // not doing channel hopping for now
-#else
-        puts("Channel hopping not implemented yet for scanning");
-#endif
-        mr_radio_rx();
+        scan_next_channel();  // each background scan on the next advertising channel
+        activity_scan_rx();
     }
     mac_vars.is_bg_scanning = true;
 }
@@ -434,10 +466,16 @@ static void activity_ti1(void) {
     set_slot_state(STATE_TX_OFFSET);
 
     // before arming the timers, check if there is a packet to send
-    uint8_t packet[MARI_PACKET_MAX_SIZE];
-    uint8_t packet_len = mr_queue_next_packet(mac_vars.current_slot_info.type, packet);
+    const mr_packet_t *packet  = mr_queue_next_packet(mac_vars.current_slot_info.type);
+    mac_vars.ack_expected_from = 0;
+
+    if (packet != NULL && packet->length > mac_vars.current_slot_info.max_frame_len) {
+        // the schedule made this slot too short for the packet, drop it rather than overrun the next slot
+        mr_queue_drop_too_long(packet);
+        packet = NULL;
+    }
 
-    if (packet_len == 0) {
+    if (packet == NULL) {
         // nothing to tx
         mr_scheduler_stats_register_used_slot(false);
 
@@ -454,6 +492,11 @@ static void activity_ti1(void) {
     }
     mr_scheduler_stats_register_used_slot(true);
 
+    if (mr_queue_needs_ack(packet)) {
+        // the destination acknowledges the frame right after it, in the same slot
+        mac_vars.ack_expected_from = ((const mr_packet_header_t *)packet->buffer)->dst;
+    }
+
     // arm the timers
     mr_timer_hf_set_oneshot_with_ref_diff_us(  // TODO: use PPI instead
         MARI_TIMER_DEV,
@@ -466,13 +509,14 @@ static void activity_ti1(void) {
         MARI_TIMER_DEV,
         MARI_TIMER_CHANNEL_2,
         mac_vars.start_slot_ts,
-        slot_durations.tx_offset + slot_durations.tx_max,
+        slot_durations.tx_offset + MARI_FRAME_TOA_WITH_PADDING(mac_vars.current_slot_info.max_frame_len),
         &activity_tie1);
 
     // prepare the radio for tx
     mr_radio_disable();
     mr_radio_set_channel(mac_vars.current_slot_info.channel);
-    mr_radio_tx_prepare(packet, packet_len);
+    // the radio reads the packet where the queue keeps it, without copying it
+    mr_radio_tx_prepare_pdu((const mr_radio_pdu_t *)packet);
 }
 
 static void activity_ti2(void) {
@@ -492,14 +536,103 @@ static void activity_tie1(void) {
     end_slot();
 }
 
-static void activity_ti3(void) {
-    // ti3: all fine, finished tx, cancel error timers and go to sleep
+static void activity_ti3(uint32_t ts) {
+    // ti3: all fine, finished tx, cancel error timers and go to sleep, unless an ACK is expected
     // called by: radio isr
-    set_slot_state(STATE_SLEEP);
 
     // cancel tte1 timer
     mr_timer_hf_cancel(MARI_TIMER_DEV, MARI_TIMER_CHANNEL_2);
 
+    if (mac_vars.ack_expected_from == 0) {
+        set_slot_state(STATE_SLEEP);
+        end_slot();
+        return;
+    }
+
+    // arm the timers of the ACK, which are relative to the end of the frame
+    set_slot_state(STATE_RX_ACK_OFFSET);
+    mac_vars.ack_ref_ts = ts;
+
+    mr_timer_hf_set_oneshot_with_ref_diff_us(
+        MARI_TIMER_DEV,
+        MARI_TIMER_CHANNEL_1,
+        mac_vars.ack_ref_ts,
+        slot_durations.ack_rx_offset,
+        &activity_ti4);
+
+    mr_timer_hf_set_oneshot_with_ref_diff_us(
+        MARI_TIMER_DEV,
+        MARI_TIMER_CHANNEL_2,
+        mac_vars.ack_ref_ts,
+        slot_durations.ack_tx_offset + slot_durations.rx_guard,
+        &activity_tie2);
+
+    mr_timer_hf_set_oneshot_with_ref_diff_us(
+        MARI_TIMER_DEV,
+        MARI_TIMER_CHANNEL_3,
+        mac_vars.ack_ref_ts,
+        slot_durations.ack_rx_offset + slot_durations.ack_max,
+        &activity_tie3);
+}
+
+static void activity_ti4(void) {
+    // ti4: rx of the ACK begins
+    // called by: timer isr
+    set_slot_state(STATE_RX_ACK_LISTEN);
+
+    mr_radio_disable();
+    mr_radio_set_channel(mac_vars.current_slot_info.channel);
+    mr_radio_rx();
+}
+
+static void activity_tie2(void) {
+    // tie2: didn't receive start of the ACK before rx_guard, the packet will be sent again
+    // called by: timer isr
+    set_slot_state(STATE_SLEEP);
+
+    // cancel timer for ack_max (tie3)
+    mr_timer_hf_cancel(MARI_TIMER_DEV, MARI_TIMER_CHANNEL_3);
+
+    end_slot();
+}
+
+static void activity_ti5(void) {
+    // ti5: the ACK started to arrive
+    // called by: radio isr
+    set_slot_state(STATE_RX_ACK);
+
+    // cancel timer for rx_guard (tie2)
+    mr_timer_hf_cancel(MARI_TIMER_DEV, MARI_TIMER_CHANNEL_2);
+}
+
+static void activity_tie3(void) {
+    // tie3: something went wrong, stayed in rx for the ACK for too long, abort
+    // called by: timer isr
+    set_slot_state(STATE_SLEEP);
+
+    end_slot();
+}
+
+static void activity_ti6(void) {
+    // ti6: finished rx of the ACK, check that it is the expected one and go to sleep
+    // called by: radio isr
+    set_slot_state(STATE_SLEEP);
+
+    // cancel timer for ack_max (tie3)
+    mr_timer_hf_cancel(MARI_TIMER_DEV, MARI_TIMER_CHANNEL_3);
+
+    if (mr_radio_pending_rx_read()) {
+        uint8_t packet[MARI_PACKET_MAX_SIZE];
+        uint8_t packet_len;
+        mr_radio_get_rx_packet(packet, &packet_len);
+
+        const mr_packet_header_t *header = (const mr_packet_header_t *)packet;
+        if (packet_len >= sizeof(mr_packet_header_t) && header->version == MARI_PROTOCOL_VERSION && header->type == MARI_PACKET_ACK && header->dst == mac_vars.device_id && header->src == mac_vars.ack_expected_from) {
+            // delivered, the queue can free the packet
+            mr_queue_in_flight_done();
+        }
+    }
+
     end_slot();
 }
 
@@ -512,25 +645,34 @@ static void activity_ri1(void) {
     // called by: function new_slot_synced
     set_slot_state(STATE_RX_OFFSET);
 
+    // the frame is expected at its EVENTS_ADDRESS, give or take the guard, but never later than with the whole guard
+    // unless the node is re-acquiring the timing of its gateway, which can wait for a frame until the end of the slot
+    uint32_t guard      = rx_guard();
+    uint32_t guard_late = guard + MARI_TS_ADDRESS_DELAY;
+    if (guard <= slot_durations.rx_guard && guard_late > slot_durations.rx_guard) {
+        guard_late = slot_durations.rx_guard;
+    }
+    uint32_t rx_late = guard_late > slot_durations.rx_guard ? guard_late - slot_durations.rx_guard : 0;
+
     mr_timer_hf_set_oneshot_with_ref_diff_us(  // TODO: use PPI instead
         MARI_TIMER_DEV,
         MARI_TIMER_CHANNEL_1,
         mac_vars.start_slot_ts,
-        slot_durations.rx_offset,
+        slot_durations.rx_offset + slot_durations.rx_guard - guard,
         &activity_ri2);
 
     mr_timer_hf_set_oneshot_with_ref_diff_us(
         MARI_TIMER_DEV,
         MARI_TIMER_CHANNEL_2,
         mac_vars.start_slot_ts,
-        slot_durations.tx_offset + slot_durations.rx_guard,
+        slot_durations.tx_offset + guard_late,
         &activity_rie1);
 
     mr_timer_hf_set_oneshot_with_ref_diff_us(
         MARI_TIMER_DEV,
         MARI_TIMER_CHANNEL_3,
         mac_vars.start_slot_ts,
-        slot_durations.rx_offset + slot_durations.rx_max,
+        slot_durations.rx_offset + slot_durations.rx_guard + rx_late + MARI_FRAME_TOA_WITH_PADDING(mac_vars.current_slot_info.max_frame_len),
         &activity_rie2);
 }
 
@@ -563,6 +705,7 @@ static void activity_rie1(void) {
     set_slot_state(STATE_SLEEP);
 
     mr_scheduler_stats_register_used_slot(false);
+    mr_scheduler_stats_register_rx(mac_vars.current_slot_info.channel, MARI_RX_MISSED);
 
     // cancel timer for rx_max (rie2)
     mr_timer_hf_cancel(MARI_TIMER_DEV, MARI_TIMER_CHANNEL_3);
@@ -579,10 +722,12 @@ static void activity_ri4(uint32_t ts) {
     mr_timer_hf_cancel(MARI_TIMER_DEV, MARI_TIMER_CHANNEL_3);
 
     if (!mr_radio_pending_rx_read()) {
-        // no packet received
+        // no packet received, the CRC was invalid
+        mr_scheduler_stats_register_rx(mac_vars.current_slot_info.channel, MARI_RX_CRC_ERROR);
         end_slot();
         return;
     }
+    mr_scheduler_stats_register_rx(mac_vars.current_slot_info.channel, MARI_RX_OK);
 
     mr_radio_get_rx_packet(mac_vars.received_packet.packet, &mac_vars.received_packet.packet_len);
 
@@ -608,9 +753,40 @@ static void activity_ri4(uint32_t ts) {
 
     header->stats.rssi = mr_radio_rssi();
 
+    bool ack = should_ack(header);
+    if (ack) {
+        // arm the timers of the ACK before handling the packet, which can take a while
+        set_slot_state(STATE_TX_ACK_OFFSET);
+        mac_vars.ack_ref_ts = ts;
+        mr_build_packet_ack(mac_vars.ack_packet, header->src);
+
+        mr_timer_hf_set_oneshot_with_ref_diff_us(
+            MARI_TIMER_DEV,
+            MARI_TIMER_CHANNEL_1,
+            mac_vars.ack_ref_ts,
+            slot_durations.ack_rx_offset,  // leaves the radio time to ramp up before ack_tx_offset
+            &activity_ri5);
+
+        mr_timer_hf_set_oneshot_with_ref_diff_us(
+            MARI_TIMER_DEV,
+            MARI_TIMER_CHANNEL_2,
+            mac_vars.ack_ref_ts,
+            slot_durations.ack_tx_offset,
+            &activity_ri6);
+
+        mr_timer_hf_set_oneshot_with_ref_diff_us(
+            MARI_TIMER_DEV,
+            MARI_TIMER_CHANNEL_3,
+            mac_vars.ack_ref_ts,
+            slot_durations.ack_tx_offset + MARI_ACK_TOA_WITH_PADDING,
+            &activity_rie3);
+    }
+
     mr_handle_packet(mac_vars.received_packet.packet, mac_vars.received_packet.packet_len);
 
-    end_slot();
+    if (!ack) {
+        end_slot();
+    }
 }
 
 static void activity_rie2(void) {
@@ -618,36 +794,147 @@ static void activity_rie2(void) {
     // called by: timer isr
     set_slot_state(STATE_SLEEP);
 
+    mr_scheduler_stats_register_rx(mac_vars.current_slot_info.channel, MARI_RX_CRC_ERROR);
+
+    end_slot();
+}
+
+static void activity_ri5(void) {
+    // ri5: prepare the radio for the tx of the ACK
+    // called by: timer isr
+    mr_radio_disable();
+    mr_radio_set_channel(mac_vars.current_slot_info.channel);
+    mr_radio_tx_prepare(mac_vars.ack_packet, sizeof(mac_vars.ack_packet));
+}
+
+static void activity_ri6(void) {
+    // ri6: tx of the ACK actually begins
+    // called by: timer isr
+    set_slot_state(STATE_TX_ACK);
+
+    mr_radio_tx_dispatch();
+}
+
+static void activity_rie3(void) {
+    // rie3: something went wrong, stayed in tx of the ACK for too long, abort
+    // called by: timer isr
+    set_slot_state(STATE_SLEEP);
+
+    end_slot();
+}
+
+static void activity_ri7(void) {
+    // ri7: all fine, finished tx of the ACK, cancel error timers and go to sleep
+    // called by: radio isr
+    set_slot_state(STATE_SLEEP);
+
+    // cancel timer for ack tx too long (rie3)
+    mr_timer_hf_cancel(MARI_TIMER_DEV, MARI_TIMER_CHANNEL_3);
+
     end_slot();
 }
 
+static bool should_ack(const mr_packet_header_t *header) {
+    // only data frames sent to this device alone, from a device it is connected to, as mr_handle_packet checks
+    if (!MARI_ENABLE_ACK || header->type != MARI_PACKET_DATA || header->dst != mac_vars.device_id) {
+        return false;
+    }
+    if (mac_vars.current_slot_info.type != SLOT_TYPE_UPLINK && mac_vars.current_slot_info.type != SLOT_TYPE_DOWNLINK) {
+        return false;  // only these slots leave room for the ACK
+    }
+    if (mari_get_node_type() == MARI_GATEWAY) {
+        return header->network_id == mr_assoc_get_network_id() && mr_assoc_gateway_node_is_joined(header->src);
+    }
+    return mr_assoc_is_joined() && header->src == mac_vars.synced_gateway;
+}
+
 static void fix_drift(uint32_t ts) {
     DEBUG_GPIO_SPIIKE(&pin1);
-    uint32_t time_cpu_periph = 59;  // got this value by looking at the logic analyzer
-
-    uint32_t expected_ts     = mac_vars.start_slot_ts + slot_durations.tx_offset + time_cpu_periph;
+    uint32_t expected_ts     = mac_vars.start_slot_ts + slot_durations.tx_offset + MARI_TS_ADDRESS_DELAY;
     int32_t  clock_drift     = ts - expected_ts;
     uint32_t abs_clock_drift = abs(clock_drift);
 
-    if (abs_clock_drift < 100) {
-        // drift is acceptable
+    if (abs_clock_drift < MARI_MAX_DRIFT_US) {
+        // drift is acceptable, and the node is back in sync if it was re-acquiring the timing
+        mac_vars.resync_end_asn = 0;
         // adjust the slot reference
         mr_timer_hf_adjust_periodic_us(
             MARI_TIMER_DEV,
             MARI_TIMER_INTER_SLOT_CHANNEL,
             clock_drift);
+
+        // the drift accumulated since the previous adjustment tells how fast the clocks drift apart, see rx_guard
+        // the first one after the sync is the error of the sync instead
+        if (mac_vars.drift_samples > 0) {
+            uint32_t elapsed = ts - mac_vars.drift_fix_ts;
+            uint32_t drift   = abs_clock_drift > MARI_RX_GUARD_JITTER ? abs_clock_drift - MARI_RX_GUARD_JITTER : 0;
+            uint32_t rate    = ((uint64_t)drift << 24) / elapsed;
+            mac_vars.drift_rate_peak -= mac_vars.drift_rate_peak / 16;
+            if (rate > mac_vars.drift_rate_peak) {
+                mac_vars.drift_rate_peak = rate;
+            }
+
+            // what is left once the slots were corrected is the error of the estimated frequency offset
+            // the first window gives the estimate, the next ones refine it, filtering out the jitter
+            mac_vars.drift_window += clock_drift;
+            mac_vars.drift_window_us += elapsed;
+            if (MARI_DRIFT_COMPENSATION && mac_vars.drift_window_us >= MARI_DRIFT_MIN_WINDOW) {
+                int32_t error = ((int64_t)mac_vars.drift_window * (1 << 24)) / (int64_t)mac_vars.drift_window_us;
+                mac_vars.drift_rate += mac_vars.drift_windows == 0 ? error : error / (1 << MARI_DRIFT_GAIN_LOG2);
+                if (mac_vars.drift_rate > MARI_DRIFT_MAX_RATE || mac_vars.drift_rate < -MARI_DRIFT_MAX_RATE) {
+                    mac_vars.drift_rate = mac_vars.drift_rate > 0 ? MARI_DRIFT_MAX_RATE : -MARI_DRIFT_MAX_RATE;
+                }
+                if (mac_vars.drift_windows < MARI_DRIFT_MIN_WINDOWS) {
+                    mac_vars.drift_windows++;
+                }
+                mac_vars.drift_window    = 0;
+                mac_vars.drift_window_us = 0;
+            }
+        }
+        if (mac_vars.drift_samples <= MARI_RX_GUARD_MIN_SAMPLES) {
+            mac_vars.drift_samples++;
+        }
+        mac_vars.drift_fix_ts = ts;
+    } else if (MARI_RESYNC_IN_PLACE) {
+        // drift is too high, but the gateway is still heard: keep the association and align the slot reference to this frame,
+        // then listen with a wide guard until a frame confirms the timing, see rx_guard, or give up, see new_slot_synced
+        mr_timer_hf_adjust_periodic_us(
+            MARI_TIMER_DEV,
+            MARI_TIMER_INTER_SLOT_CHANNEL,
+            clock_drift);
+        if (mac_vars.resync_end_asn == 0) {
+            mac_vars.resync_end_asn = mac_vars.asn + (uint64_t)mr_scheduler_get_active_schedule_slot_count() * MARI_RESYNC_MAX_SLOTFRAMES;
+        }
+
+        // the drift rate measured so far did not predict this, measure it again
+        mac_vars.drift_fix_ts    = ts;
+        mac_vars.drift_samples   = 0;
+        mac_vars.drift_window    = 0;
+        mac_vars.drift_window_us = 0;
+        mac_vars.drift_windows   = 0;
     } else {
         // drift is too high, need to re-sync
-        // FIXME: use `mr_assoc_node_handle_immediate_disconnect` instead
-        mr_event_data_t event_data = { .data.gateway_info.gateway_id = mac_vars.synced_gateway, .tag = MARI_OUT_OF_SYNC };
-        mac_vars.mari_event_callback(MARI_DISCONNECTED, event_data);
-        mr_assoc_set_state(JOIN_STATE_IDLE);
-        set_slot_state(STATE_SLEEP);
-        end_slot();
-        start_scan();
+        node_out_of_sync();
     }
 }
 
+static uint32_t rx_guard(void) {
+    uint32_t elapsed = mac_vars.start_slot_ts + slot_durations.tx_offset - mac_vars.drift_fix_ts;
+    if (MARI_RESYNC_IN_PLACE && mari_get_node_type() == MARI_NODE && mr_assoc_is_joined()) {
+        // re-acquiring the timing of the gateway, see fix_drift, or its frames were missed for long enough that it may be lost
+        if (mac_vars.resync_end_asn != 0 || elapsed > mr_scheduler_get_duration_us() * MARI_RESYNC_NO_RX_SLOTFRAMES) {
+            return MARI_RESYNC_RX_GUARD_TIME;
+        }
+    }
+    if (!MARI_ADAPTIVE_RX_GUARD || mari_get_node_type() != MARI_NODE || mac_vars.drift_samples <= MARI_RX_GUARD_MIN_SAMPLES) {
+        // gateways receive from many nodes, each one with its own drift
+        return slot_durations.rx_guard;
+    }
+    // twice the drift expected since the last adjustment, on top of the jitter
+    uint64_t guard = MARI_RX_GUARD_MIN_TIME + (((uint64_t)mac_vars.drift_rate_peak * elapsed * 2) >> 24);
+    return guard < slot_durations.rx_guard ? guard : slot_durations.rx_guard;
+}
+
 // --------------------- handover --------------------
 
 static bool select_gateway_for_handover(uint32_t now_ts, mr_channel_info_t *selected_gateway) {
@@ -695,7 +982,7 @@ static void handle_bg_scan_and_trigger_handover(uint32_t now_ts) {
         slot_durations.whole_slot << 4,  // 16 slots in the future
         &new_slot_synced);
 
-    uint32_t handover_time_correction_us = 206;  // magic number: measured using the logic analyzer
+    uint32_t handover_time_correction_us = MARI_HANDOVER_TIME_CORRECTION;
     if (sync_to_gateway(now_ts, &selected_gateway, handover_time_correction_us)) {
         // found a gateway and synchronized to it
         mr_assoc_node_handle_synced();
@@ -732,6 +1019,15 @@ static void activity_scan_dispatch_new_schedule(void) {
         MARI_TIMER_INTER_SLOT_CHANNEL,
         slot_durations.whole_slot,
         &new_slot_synced);
+
+    // the slot starting now is not ticked, new_slot_synced starts the next one once it is over
+    uint32_t slot_duration = mr_scheduler_get_slot_duration_us(mac_vars.asn - 1);
+    if (slot_duration != slot_durations.whole_slot) {
+        mr_timer_hf_adjust_periodic_us(
+            MARI_TIMER_DEV,
+            MARI_TIMER_INTER_SLOT_CHANNEL,
+            (int32_t)slot_duration - (int32_t)slot_durations.whole_slot);
+    }
 }
 
 static bool sync_to_gateway(uint32_t now_ts, mr_channel_info_t *selected_gateway, uint32_t handover_time_correction_us) {
@@ -740,35 +1036,63 @@ static bool sync_to_gateway(uint32_t now_ts, mr_channel_info_t *selected_gateway
         return false;
     }
 
-    mac_vars.synced_gateway    = selected_gateway->beacon.src;
-    mac_vars.synced_network_id = selected_gateway->beacon.network_id;
-    mac_vars.synced_ts         = now_ts;
+    // the selected gateway may have been scanned a few slots ago, so we need to account for that difference
+    // NOTE: this assumes that the slot durations are the same for gateways and nodes
+    uint32_t time_since_beacon = now_ts - selected_gateway->timestamp;
+    uint64_t asn               = selected_gateway->beacon.asn - 1;  // the beacon carries the asn of the slot after it
+
+    // skip whole slotframes, then walk the slots until the current one, as cells have different durations
+    uint32_t slotframe_count = time_since_beacon / mr_scheduler_get_duration_us();
+    uint32_t slot_start      = slotframe_count * mr_scheduler_get_duration_us();
+    asn += (uint64_t)slotframe_count * mr_scheduler_get_active_schedule_slot_count();
+    while (slot_start + mr_scheduler_get_slot_duration_us(asn) <= time_since_beacon) {
+        slot_start += mr_scheduler_get_slot_duration_us(asn++);
+    }
+    uint32_t time_to_next_slot = slot_start + mr_scheduler_get_slot_duration_us(asn) - time_since_beacon;
 
-    // the selected gateway may have been scanned a few slot_durations ago, so we need to account for that difference
-    // NOTE: this assumes that the slot duration is the same for gateways and nodes
-    uint32_t time_since_beacon      = now_ts - selected_gateway->timestamp;
-    uint64_t asn_count_since_beacon = (time_since_beacon / slot_durations.whole_slot) + 1;  // +1 because we are inside the current slot
-    uint64_t time_into_gateway_slot = time_since_beacon % slot_durations.whole_slot;
+    while (time_to_next_slot < slot_durations.whole_slot / 2) {
+        // too close to the next slot, skip it
+        asn++;
+        time_to_next_slot += mr_scheduler_get_slot_duration_us(asn);
+    }
 
-    uint64_t time_to_skip_one_slot = 0;
-    if (time_into_gateway_slot > slot_durations.whole_slot / 2) {
-        // too close to the next slot, skip this one
-        asn_count_since_beacon++;
-        time_to_skip_one_slot = slot_durations.whole_slot;
+    if (selected_gateway->beacon.switch_countdown != 0) {
+        // the slots were walked with the durations of the active schedule, which is only right before the switch
+        uint64_t switch_asn = selected_gateway->beacon.asn + selected_gateway->beacon.switch_countdown;
+        if (asn + 2 >= switch_asn || !mr_scheduler_node_set_pending_switch(selected_gateway->beacon.next_schedule_id, switch_asn)) {
+            return false;
+        }
     }
+    // hop over the channels of the gateway, from its next map on if one is announced
+    mr_scheduler_node_set_channel_map(selected_gateway->beacon.channel_map, selected_gateway->beacon.asn + selected_gateway->beacon.channel_map_countdown);
 
-    uint64_t time_cpu_and_toa = 541;  // magic number: measured using the logic analyzer
+    mac_vars.synced_gateway    = selected_gateway->beacon.src;
+    mac_vars.synced_network_id = selected_gateway->beacon.network_id;
+    mac_vars.synced_ts         = now_ts;
+
+    // the drift is measured again against this gateway, with the whole guard meanwhile
+    mac_vars.drift_fix_ts    = now_ts;
+    mac_vars.drift_rate_peak = 0;
+    mac_vars.drift_samples   = 0;
+    mac_vars.drift_rate      = 0;
+    mac_vars.drift_remainder = 0;
+    mac_vars.drift_window    = 0;
+    mac_vars.drift_window_us = 0;
+    mac_vars.drift_windows   = 0;
+    mac_vars.resync_end_asn  = 0;
+
+    uint64_t time_cpu_and_toa = MARI_SYNC_TIME_CPU_AND_TOA;
     time_cpu_and_toa += handover_time_correction_us;
 
-    uint32_t time_dispatch_new_schedule = ((slot_durations.whole_slot - time_into_gateway_slot) + time_to_skip_one_slot) - time_cpu_and_toa;
+    uint32_t time_dispatch_new_schedule = time_to_next_slot - time_cpu_and_toa;
     mr_timer_hf_set_oneshot_us(
         MARI_TIMER_DEV,
         MARI_TIMER_CHANNEL_1,
         time_dispatch_new_schedule,
         &activity_scan_dispatch_new_schedule);
 
-    // set the asn to match the gateway's
-    mac_vars.asn = selected_gateway->beacon.asn + asn_count_since_beacon;
+    // set the asn to match the gateway's: the slot after the one starting at dispatch
+    mac_vars.asn = asn + 2;
 
     return true;
 }
@@ -781,11 +1105,13 @@ static void activity_scan_start_frame(uint32_t ts) {
 }
 
 static void activity_scan_end_frame(uint32_t end_frame_ts) {
-    uint8_t packet[MARI_PACKET_MAX_SIZE];
-    uint8_t packet_len;
-    mr_radio_get_rx_packet(packet, &packet_len);
+    if (mr_radio_pending_rx_read()) {
+        uint8_t packet[MARI_PACKET_MAX_SIZE];
+        uint8_t packet_len;
+        mr_radio_get_rx_packet(packet, &packet_len);
 
-    mr_assoc_handle_beacon(packet, packet_len, MARI_FIXED_SCAN_CHANNEL, mac_vars.current_scan_item_ts);
+        mr_assoc_handle_beacon(packet, packet_len, mac_vars.scan_channel, mac_vars.current_scan_item_ts);
+    }
 
     // if there is still enough time before end of scan, re-enable the radio
     bool still_time_for_rx_scan    = mac_vars.is_scanning && (end_frame_ts + MARI_BEACON_TOA_WITH_PADDING < mac_vars.scan_expected_end_ts);
@@ -800,12 +1126,46 @@ static void activity_scan_end_frame(uint32_t end_frame_ts) {
             MARI_TIMER_CHANNEL_2,
             end_frame_ts,
             20,  // arbitrary value, just to give some time for the radio to turn off
-            &mr_radio_rx);
+            &activity_scan_rx);
     } else {
         set_slot_state(STATE_SLEEP);
     }
 }
 
+static void activity_scan_hop(void) {
+    // move the scan to the next advertising channel, so that a jammed one does not hide all the gateways
+    // called by: timer isr
+    if (mac_vars.state == STATE_RX_DATA) {
+        // a beacon is being received on the current channel, hop once it is over
+        mr_timer_hf_set_oneshot_us(MARI_TIMER_DEV, MARI_TIMER_CHANNEL_3, MARI_BEACON_TOA_WITH_PADDING, &activity_scan_hop);
+        return;
+    }
+    mr_timer_hf_set_oneshot_us(MARI_TIMER_DEV, MARI_TIMER_CHANNEL_3, MARI_SCAN_DWELL, &activity_scan_hop);
+
+    scan_next_channel();
+    if (mac_vars.state == STATE_RX_DATA_LISTEN) {
+        activity_scan_rx();
+    }
+}
+
+static void activity_scan_rx(void) {
+    // (re-)enable the radio on the channel of the scan
+    // called by: timer isr, or when the scan starts
+    mr_radio_disable();
+    mr_radio_set_channel(mac_vars.scan_channel);
+    mr_radio_rx();
+}
+
+static void scan_next_channel(void) {
+#if (MARI_FIXED_SCAN_CHANNEL != 0)
+    mac_vars.scan_channel = MARI_FIXED_SCAN_CHANNEL;
+#else
+    // the advertising channels come after the regular ones
+    bool last             = mac_vars.scan_channel < MARI_N_BLE_REGULAR_CHANNELS || mac_vars.scan_channel + 1 == MARI_N_BLE_REGULAR_CHANNELS + MARI_N_BLE_ADVERTISING_CHANNELS;
+    mac_vars.scan_channel = last ? MARI_N_BLE_REGULAR_CHANNELS : mac_vars.scan_channel + 1;
+#endif
+}
+
 // --------------------- tx/rx activities ------------
 
 // --------------------- radio ---------------------
@@ -820,6 +1180,9 @@ static void isr_mac_radio_start_frame(uint32_t ts) {
         case STATE_RX_DATA_LISTEN:
             activity_ri3(ts);
             break;
+        case STATE_RX_ACK_LISTEN:
+            activity_ti5();
+            break;
         default:
             break;
     }
@@ -835,11 +1198,17 @@ static void isr_mac_radio_end_frame(uint32_t ts) {
 
     switch (mac_vars.state) {
         case STATE_TX_DATA:
-            activity_ti3();
+            activity_ti3(ts);
             break;
         case STATE_RX_DATA:
             activity_ri4(ts);
             break;
+        case STATE_RX_ACK:
+            activity_ti6();
+            break;
+        case STATE_TX_ACK:
+            activity_ri7();
+            break;
         default:
             break;
     }
@@ -33,27 +33,69 @@
 #define BLE_2M_US_PER_BYTE          (1000 / BLE_2M_B_MS)  // 4 us
 
 // Intra-slot durations. TOA definitions consider BLE 2M mode.
-#define MARI_TS_TX_OFFSET            (400)                                               // time for radio setup before TX
-#define MARI_RX_GUARD_TIME           (140)                                               // time range relative to MARI_TS_TX_OFFSET for the receiver to start RXing
-#define MARI_END_GUARD_TIME          (MARI_RX_GUARD_TIME + 100)                          // Added 40 us based on measurements witn nRF52 and nRF53
-#define MARI_PACKET_TOA              (BLE_2M_US_PER_BYTE * MARI_BLE_PAYLOAD_MAX_LENGTH)  // Time on air for the maximum payload.
-#define MARI_PACKET_TOA_WITH_PADDING (MARI_PACKET_TOA + 120)                             // Add padding based on experiments. Also, it takes 28 us until event ADDRESS is triggered (when the packet actually starts traveling over the air)
+#define MARI_TS_TX_OFFSET                (400)                                                       // time for radio setup before TX
+#define MARI_RX_GUARD_TIME               (140)                                                       // time range relative to MARI_TS_TX_OFFSET for the receiver to start RXing
+#define MARI_TS_ADDRESS_DELAY            (59)                                                        // from MARI_TS_TX_OFFSET to the EVENTS_ADDRESS of the frame, got this value by looking at the logic analyzer
+#define MARI_END_GUARD_TIME              (MARI_RX_GUARD_TIME + 100)                                  // Added 40 us based on measurements witn nRF52 and nRF53
+#define MARI_FRAME_TOA_WITH_PADDING(len) (BLE_2M_US_PER_BYTE * (len) + 120)                          // Add padding based on experiments. Also, it takes 28 us until event ADDRESS is triggered (when the packet actually starts traveling over the air)
+#define MARI_PACKET_TOA                  (BLE_2M_US_PER_BYTE * MARI_BLE_PAYLOAD_MAX_LENGTH)          // Time on air for the maximum payload.
+#define MARI_PACKET_TOA_WITH_PADDING     (MARI_FRAME_TOA_WITH_PADDING(MARI_BLE_PAYLOAD_MAX_LENGTH))  // Time on air for the maximum payload, with padding.
 
 // Duration of some packets
-#define MARI_BEACON_TOA              (BLE_2M_US_PER_BYTE * sizeof(mr_beacon_packet_header_t))  // Time on air for the beacon packet
-#define MARI_BEACON_TOA_WITH_PADDING (MARI_BEACON_TOA + 60)                                    // Add padding based on experiments.
-
-#define MARI_WHOLE_SLOT_DURATION (MARI_TS_TX_OFFSET + MARI_PACKET_TOA_WITH_PADDING + MARI_END_GUARD_TIME)  // Complete slot duration
+#define MARI_BEACON_TOA(membership_len) (BLE_2M_US_PER_BYTE * (MARI_BEACON_HEADER_LEN + (membership_len)))  // Time on air for a beacon packet
+#define MARI_BEACON_TOA_WITH_PADDING    (MARI_BEACON_TOA(MARI_MEMBERSHIP_MAX_BYTES) + 60)                     // Add padding based on experiments. Longest beacon, as the membership length is not known in advance.
+
+// In-slot acknowledgement of unicast frames (see MARI_ENABLE_ACK), timed from the end of the acknowledged frame
+#define MARI_TS_ACK_TX_OFFSET     (MARI_RX_GUARD_TIME + 60)                                    // time for the receiver to turn around, the sender listens from MARI_RX_GUARD_TIME before
+#define MARI_ACK_TOA_WITH_PADDING (MARI_FRAME_TOA_WITH_PADDING(sizeof(mr_packet_header_t)))  // Time on air for an ACK, with padding.
+#if MARI_ENABLE_ACK
+#define MARI_ACK_DURATION (MARI_TS_ACK_TX_OFFSET + MARI_ACK_TOA_WITH_PADDING)  // added to the uplink and downlink slots
+#else
+#define MARI_ACK_DURATION (0)
+#endif
+
+// Each type of cell of a schedule lasts as long as its longest frame needs, see mr_frame_lengths_t
+#define MARI_SLOT_DURATION(frame_len)     (MARI_TS_TX_OFFSET + MARI_FRAME_TOA_WITH_PADDING(frame_len) + MARI_END_GUARD_TIME)  // Duration of a slot for frames up to frame_len bytes
+#define MARI_ACK_SLOT_DURATION(frame_len) (MARI_SLOT_DURATION(frame_len) + MARI_ACK_DURATION)                                 // Same, for the slots where unicast frames are acknowledged
+#define MARI_WHOLE_SLOT_DURATION          (MARI_ACK_SLOT_DURATION(MARI_BLE_PAYLOAD_MAX_LENGTH))                               // Duration of the longest slot
 
 #define MARI_MAX_TIME_NO_RX_DESYNC (MARI_WHOLE_SLOT_DURATION * MARI_SCAN_MAX_SLOTS)  // us, arbitrary value for now
 
 // default scan duration in us
 #define MARI_SCAN_MAX_SLOTS    (MARI_N_CELLS_MAX)                                // how many slots to scan for. should probably be the size of the largest schedule
 #define MARI_SCAN_MAX_DURATION (MARI_SCAN_MAX_SLOTS * MARI_WHOLE_SLOT_DURATION)  // how many slots to scan for. should probably be the size of the largest schedule
-
-#define MARI_BG_SCAN_DURATION (MARI_WHOLE_SLOT_DURATION - (MARI_END_GUARD_TIME * 2))
-
-#define MARI_MAX_SLOTFRAMES_NO_RX_LEAVE (5)  // how many slotframes to wait before leaving the network if nothing is received
+#define MARI_SCAN_DWELL        (MARI_SCAN_MAX_DURATION / MARI_N_BLE_ADVERTISING_CHANNELS)  // the scan listens on each advertising channel in turn, for this long
+
+#define MARI_BG_SCAN_DURATION(slot_duration) ((slot_duration) - (MARI_END_GUARD_TIME * 2))
+
+// Receive guard of the nodes, sized from the drift measured against their gateway instead of the worst case
+#ifndef MARI_ADAPTIVE_RX_GUARD
+#define MARI_ADAPTIVE_RX_GUARD 1
+#endif
+#define MARI_RX_GUARD_MIN_TIME    (30)  // us, smallest guard, for the jitter of the timers and of the radio
+#define MARI_RX_GUARD_JITTER      (2)   // us of a measured drift that are only jitter, left out of the drift rate
+#define MARI_RX_GUARD_MIN_SAMPLES (4)   // drift measurements after a sync before the guard adapts
+
+// Frequency offset of the nodes from their gateway, estimated from the drift measurements and corrected at each slot
+#ifndef MARI_DRIFT_COMPENSATION
+#define MARI_DRIFT_COMPENSATION 1
+#endif
+#define MARI_DRIFT_MAX_RATE    (100 * (1 << 24) / 1000000)  // highest offset that is corrected, 100 ppm, in us per 2^24 us
+#define MARI_DRIFT_MIN_WINDOW  (100 * 1000)                 // us over which the drift measurements are summed, for the jitter to be negligible
+#define MARI_DRIFT_GAIN_LOG2   (2)                          // each window moves the estimate by 1/4 of the rate it measured
+#define MARI_DRIFT_MIN_WINDOWS (3)                          // windows after which the offset is considered corrected
+
+// Nodes that lost the timing of their gateway re-acquire it in place, with a wider guard, instead of scanning again
+#ifndef MARI_RESYNC_IN_PLACE
+#define MARI_RESYNC_IN_PLACE 1
+#endif
+#define MARI_MAX_DRIFT_US             (100)                  // us, highest drift of the frames of the gateway for the node to be in sync
+#define MARI_RESYNC_RX_GUARD_TIME     (MARI_END_GUARD_TIME)  // us, guard while re-acquiring, as wide as the slot allows
+#define MARI_RESYNC_MAX_SLOTFRAMES    (2)                    // slotframes to re-acquire the timing after a frame drifted too much, before scanning again
+#define MARI_RESYNC_NO_RX_SLOTFRAMES  (2)                    // slotframes without a frame of the gateway after which the node also listens with the wider guard
+
+#define MARI_MAX_SLOTFRAMES_NO_RX_LEAVE             (5)   // how many slotframes to wait before leaving the network if nothing is received
+#define MARI_MAX_SLOTFRAMES_NO_RX_LEAVE_COMPENSATED (10)  // same, for a node whose frequency offset is corrected, which stays in sync for longer; also how long the gateway keeps the cell of a silent node
 
 /* Duration of intra-slot sections */
 typedef struct {
@@ -66,11 +108,81 @@ typedef struct {
     uint32_t rx_offset;  ///< Offset for the receiver to start receiving.
     uint32_t rx_max;     ///< Maximum time the receiver can be active.
 
+    // acknowledgement, from the end of the acknowledged frame
+    uint32_t ack_tx_offset;  ///< Offset for the receiver of the frame to start sending the ACK.
+    uint32_t ack_rx_offset;  ///< Offset for the sender of the frame to start listening for the ACK.
+    uint32_t ack_max;        ///< Maximum time the ACK can take.
+
     // common
     uint32_t end_guard;   ///< Time to wait after the end of the slot, so that the radio can fully turn off. Can be overriden with a large value to facilitate debugging. Must be at minimum rx_guard.
-    uint32_t whole_slot;  ///< Total duration of the slot
+    uint32_t whole_slot;  ///< Total duration of the longest slot, the duration of each cell is in mr_slot_info_t
 } mr_slot_durations_t;
 
+typedef enum {
+    // common
+    STATE_SLEEP,
+
+    // transmitter
+    STATE_TX_OFFSET     = 21,
+    STATE_TX_DATA       = 22,
+    STATE_RX_ACK_OFFSET = 23,
+    STATE_RX_ACK_LISTEN = 24,
+    STATE_RX_ACK        = 25,
+
+    // receiver
+    STATE_RX_OFFSET      = 31,
+    STATE_RX_DATA_LISTEN = 32,
+    STATE_RX_DATA        = 33,
+    STATE_TX_ACK_OFFSET  = 34,
+    STATE_TX_ACK         = 35,
+
+} mr_mac_state_t;
+
+typedef struct {
+    uint64_t device_id;  ///< Device ID
+
+    mr_mac_state_t state;              ///< State within the slot
+    uint32_t       start_slot_ts;      ///< Timestamp of the start of the slot
+    uint64_t       asn;                ///< Absolute slot number
+    mr_slot_info_t current_slot_info;  ///< Information about the current slot
+
+    mr_event_cb_t mari_event_callback;  ///< Function pointer, stores the application callback
+
+    mr_received_packet_t received_packet;  ///< Last received packet
+
+    uint64_t ack_expected_from;                       ///< Destination of the frame being sent, which acknowledges it, 0 if no ACK is expected
+    uint32_t ack_ref_ts;                              ///< End of the frame being acknowledged, reference of the ACK timers
+    uint8_t  ack_packet[sizeof(mr_packet_header_t)];  ///< ACK sent by the receiver of a frame
+
+    bool     is_scanning;           ///< Whether the node is scanning for gateways
+    uint32_t scan_started_ts;       ///< Timestamp of the start of the scan
+    uint32_t scan_expected_end_ts;  ///< Timestamp of the expected end of the scan
+    uint32_t current_scan_item_ts;  ///< Timestamp of the current scan item
+    uint8_t  scan_channel;          ///< Advertising channel the scan listens on, the next one at each dwell and background scan
+
+    bool is_bg_scanning;           ///< Whether the node is scanning for gateways in the background
+    bool bg_scan_sleep_next_slot;  ///< Whether the next slot is a sleep slot
+
+    ///< This timestamp keeps track of a full handover scan, that is, a scan that
+    ///< Potentially spans multiple background scans (the bg scans are typically very short)
+    uint32_t full_bg_scan_started_ts;
+    uint32_t full_bg_scan_expected_end_ts;  ///< Timestamp of the expected end of the full handover scan
+
+    uint64_t synced_gateway;     ///< ID of the gateway the node is synchronized with
+    uint16_t synced_network_id;  ///< Network ID of the gateway the node is synchronized with
+    uint32_t synced_ts;          ///< Timestamp of the last synchronization
+
+    uint32_t drift_fix_ts;     ///< Timestamp of the frame of the gateway the slot reference was last adjusted to
+    uint32_t drift_rate_peak;  ///< Highest rate at which the clocks drift apart, decaying, in us per 2^24 us
+    uint8_t  drift_samples;    ///< Drift measurements since the sync, up to MARI_RX_GUARD_MIN_SAMPLES + 1
+    int32_t  drift_rate;       ///< Estimated frequency offset from the gateway, in us per 2^24 us, positive when the clock of the node is fast
+    int32_t  drift_remainder;  ///< Correction not applied yet, less than 1 us, in 2^-24 us
+    int32_t  drift_window;     ///< Sum of the drift measured since the last estimate, in us
+    uint32_t drift_window_us;  ///< Time since the last estimate
+    uint8_t  drift_windows;    ///< Estimates since the sync, up to MARI_DRIFT_MIN_WINDOWS
+    uint64_t resync_end_asn;   ///< ASN at which the node gives up re-acquiring the timing of its gateway, 0 when in sync
+} mr_mac_vars_t;
+
 //=========================== variables ========================================
 
 extern mr_slot_durations_t slot_durations;
@@ -82,6 +194,8 @@ uint64_t mr_mac_get_synced_ts(void);
 uint64_t mr_mac_get_synced_gateway(void);
 uint16_t mr_mac_get_synced_network_id(void);
 uint64_t mr_mac_get_asn(void);
+uint8_t  mr_mac_get_channel(void);
+bool     mr_mac_is_drift_compensated(void);
 uint32_t mr_mac_get_tiner_value(void);
 bool     mr_mac_node_is_synced(void);
 
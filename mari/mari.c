@@ -24,18 +24,20 @@
 #include "association.h"
 #include "queue.h"
 #include "bloom.h"
+#include "bulk.h"
 #include "mari.h"
+#include "context.h"
 
 //=========================== defines ==========================================
 
-typedef struct {
-    mr_node_type_t node_type;
-    mr_event_cb_t  app_event_callback;
-} mari_vars_t;
-
 //=========================== variables ========================================
 
-static mari_vars_t _mari_vars = { 0 };
+static mari_ctx_t _mari_default_ctx = { 0 };
+
+mari_ctx_t *mr_ctx = &_mari_default_ctx;
+
+// state of the selected mari instance, see context.h
+#define _mari_vars (mr_ctx->mari)
 
 //=========================== prototypes =======================================
 
@@ -47,7 +49,7 @@ static void mr_mari_force_gateway_startup_random_delay(void);
 
 // -------- common --------
 
-void mari_init(mr_node_type_t node_type, uint16_t net_id, schedule_t *app_schedule, mr_event_cb_t app_event_callback) {
+void mari_init(mr_node_type_t node_type, uint16_t net_id, const schedule_t *app_schedule, mr_event_cb_t app_event_callback) {
     _mari_vars.node_type          = node_type;
     _mari_vars.app_event_callback = app_event_callback;
 
@@ -58,6 +60,8 @@ void mari_init(mr_node_type_t node_type, uint16_t net_id, schedule_t *app_schedu
     // initialize stateful mari modules
     mr_assoc_init(net_id, event_callback);
     mr_scheduler_init(app_schedule);
+    mr_queue_init(event_callback);
+    mr_bulk_init(event_callback);
     if (node_type == MARI_GATEWAY) {
         mr_bloom_gateway_init();
     }
@@ -70,8 +74,44 @@ void mari_init(mr_node_type_t node_type, uint16_t net_id, schedule_t *app_schedu
     mr_mac_init(event_callback);
 }
 
-void mari_tx(uint8_t *packet, uint8_t length) {
-    mr_queue_add(packet, length);
+void mari_ctx_init(mari_ctx_t *ctx) {
+    memset(ctx, 0, sizeof(mari_ctx_t));
+}
+
+void mari_ctx_select(mari_ctx_t *ctx) {
+    mr_ctx = ctx ? ctx : &_mari_default_ctx;
+}
+
+mari_ctx_t *mari_ctx_current(void) {
+    return mr_ctx;
+}
+
+mr_tx_status_t mari_tx(uint8_t *packet, uint8_t length) {
+    return mr_queue_add(packet, length);
+}
+
+uint8_t *mari_tx_reserve(void) {
+    return mr_queue_reserve();
+}
+
+mr_tx_status_t mari_tx_commit(uint8_t length) {
+    return mr_queue_commit(length);
+}
+
+void mari_get_queue_stats(mr_queue_stats_t *stats) {
+    mr_queue_get_stats(stats);
+}
+
+uint8_t mari_queue_depth(void) {
+    return mr_queue_depth();
+}
+
+uint8_t mari_queue_free(void) {
+    return mr_queue_free();
+}
+
+void mari_set_queue_watermarks(uint8_t high, uint8_t low) {
+    mr_queue_set_watermarks(high, low);
 }
 
 mr_node_type_t mari_get_node_type(void) {
@@ -92,12 +132,26 @@ size_t mari_gateway_count_nodes(void) {
     return mr_scheduler_gateway_get_nodes_count();
 }
 
+bool mari_gateway_bulk_start(const uint8_t *image, uint32_t image_len) {
+    return mr_bulk_gateway_start(image, image_len);
+}
+
+void mari_gateway_bulk_stop(void) {
+    mr_bulk_gateway_stop();
+}
+
 // -------- node ----------
 
-void mari_node_tx_payload(uint8_t *payload, uint8_t payload_len) {
-    uint8_t packet[MARI_PACKET_MAX_SIZE] = { 0 };
-    uint8_t len                          = mr_build_packet_data(packet, mari_node_gateway_id(), payload, payload_len);
-    mr_queue_add(packet, len);
+mr_tx_status_t mari_node_tx_payload(uint8_t *payload, uint8_t payload_len) {
+    if (payload_len > MARI_PACKET_MAX_SIZE - sizeof(mr_packet_header_t)) {
+        return MARI_TX_TOO_LONG;
+    }
+    // build the packet right in the queue
+    uint8_t *packet = mr_queue_reserve();
+    if (packet == NULL) {
+        return MARI_TX_QUEUE_FULL;
+    }
+    return mr_queue_commit(mr_build_packet_data(packet, mari_node_gateway_id(), payload, payload_len));
 }
 
 bool mari_node_is_connected(void) {
@@ -137,6 +191,9 @@ bool mr_handle_packet(uint8_t *packet, uint8_t length) {
         }
 
         bool from_joined_node = mr_assoc_gateway_node_is_joined(header->src);
+        if (from_joined_node) {
+            mr_scheduler_stats_register_uplink_received(header->src);
+        }
 
         switch (header->type) {
             case MARI_PACKET_JOIN_REQUEST:
@@ -147,10 +204,9 @@ bool mr_handle_packet(uint8_t *packet, uint8_t length) {
                 // NOTE: we accept re-joins because of possible collisions on the join response (downlink)
                 int16_t cell_id = mr_scheduler_gateway_assign_next_available_uplink_cell(header->src, mr_mac_get_asn());
                 if (cell_id >= 0) {
-                    // at the packet level, max_nodes is limited to 256 (using uint8_t cell_id)
-                    mr_queue_set_join_response(header->src, (uint8_t)cell_id);
-                    // set the dirty flag that will trigger the event loop to compute the bloom filter
-                    mr_bloom_gateway_set_dirty();
+                    // at the packet level, max_nodes is limited to 256 (using uint8_t uplink_index)
+                    // the uplink index, unlike the cell index, stays the same if the schedule is switched before the node gets it
+                    mr_queue_set_join_response(header->src, mr_scheduler_get_uplink_index(cell_id));
                     _mari_vars.app_event_callback(MARI_NODE_JOINED, (mr_event_data_t){ .data.node_info.node_id = header->src });
                 } else {
                     _mari_vars.app_event_callback(MARI_ERROR, (mr_event_data_t){ .tag = MARI_GATEWAY_FULL });
@@ -182,6 +238,10 @@ bool mr_handle_packet(uint8_t *packet, uint8_t length) {
                     return false;
                 }
                 mr_assoc_gateway_keep_node_alive(header->src, mr_mac_get_asn());  // keep track of when the last packet was received
+                if (length > sizeof(mr_packet_header_t)) {
+                    // the node reports how far it is in the bulk transfer
+                    mr_bulk_gateway_handle_report(header->src, packet + sizeof(mr_packet_header_t), length - sizeof(mr_packet_header_t));
+                }
                 mr_event_data_t event_data = {
                     .data.node_info = { .node_id = header->src }
                 };
@@ -202,7 +262,7 @@ bool mr_handle_packet(uint8_t *packet, uint8_t length) {
 
         switch (header->type) {
             case MARI_PACKET_BEACON:
-                mr_assoc_handle_beacon(packet, length, MARI_FIXED_SCAN_CHANNEL, mr_mac_get_asn());
+                mr_assoc_handle_beacon(packet, length, mr_mac_get_channel(), mr_mac_get_asn());
                 break;
             case MARI_PACKET_JOIN_RESPONSE:
             {
@@ -214,9 +274,9 @@ bool mr_handle_packet(uint8_t *packet, uint8_t length) {
                     // ignore if not for me
                     return false;
                 }
-                // the first byte after the header contains the cell_id
-                uint8_t cell_id = packet[sizeof(mr_packet_header_t)];
-                if (mr_scheduler_node_assign_myself_to_cell(cell_id)) {
+                // the first byte after the header contains the uplink index of the cell
+                uint8_t uplink_index = packet[sizeof(mr_packet_header_t)];
+                if (mr_scheduler_node_assign_myself_to_uplink(uplink_index)) {
                     mr_assoc_node_handle_joined(header->src);
                 } else {
                     _mari_vars.app_event_callback(MARI_ERROR, (mr_event_data_t){ 0 });
@@ -241,6 +301,51 @@ bool mr_handle_packet(uint8_t *packet, uint8_t length) {
                 mr_assoc_node_keep_gateway_alive(mr_mac_get_asn());
                 break;
             }
+            case MARI_PACKET_AGGREGATED:
+            {
+                if (!from_my_joined_gateway) {
+                    // ignore data packets from other gateways
+                    return false;
+                }
+                // the application gets the sub-packets for this node as regular data packets, one after the other:
+                // each one is moved right after the header, which is rewritten, so that header and payload are contiguous
+                // moving a sub-packet to the front never overwrites the next ones, only the previous ones, already delivered
+                size_t offset = sizeof(mr_packet_header_t);
+                while (offset + sizeof(mr_aggregated_header_t) <= length) {
+                    mr_aggregated_header_t sub_header;
+                    memcpy(&sub_header, packet + offset, sizeof(mr_aggregated_header_t));
+                    offset += sizeof(mr_aggregated_header_t);
+                    if (offset + sub_header.len > length) {
+                        // truncated sub-packet
+                        break;
+                    }
+                    if (sub_header.dst == mr_device_id()) {
+                        memmove(packet + sizeof(mr_packet_header_t), packet + offset, sub_header.len);
+                        header->type = MARI_PACKET_DATA;
+                        header->dst  = mr_device_id();
+
+                        mr_event_data_t event_data = {
+                            .data.new_packet = {
+                                .len         = sizeof(mr_packet_header_t) + sub_header.len,
+                                .header      = header,
+                                .payload     = packet + sizeof(mr_packet_header_t),
+                                .payload_len = sub_header.len }
+                        };
+                        _mari_vars.app_event_callback(MARI_NEW_PACKET, event_data);
+                    }
+                    offset += sub_header.len;
+                }
+                mr_assoc_node_keep_gateway_alive(mr_mac_get_asn());
+                break;
+            }
+            case MARI_PACKET_BULK:
+                if (!from_my_joined_gateway) {
+                    // ignore chunks from other gateways
+                    return false;
+                }
+                mr_bulk_node_handle_chunk(header->src, packet + sizeof(mr_packet_header_t), length - sizeof(mr_packet_header_t));
+                mr_assoc_node_keep_gateway_alive(mr_mac_get_asn());
+                break;
             case MARI_PACKET_KEEPALIVE:
                 if (!from_my_joined_gateway) {
                     // ignore keep-alives from other gateways
@@ -257,28 +362,12 @@ bool mr_handle_packet(uint8_t *packet, uint8_t length) {
 }
 
 void mari_event_loop(void) {
-    // process the event loop
-    switch (mari_get_node_type()) {
-        case MARI_GATEWAY:
-            mr_bloom_gateway_event_loop();
-            break;
-        case MARI_NODE:
-            break;
-    }
+    // nothing to process for now: the bloom filter of the gateway is updated as nodes join and leave
 }
 
 //=========================== callbacks ===========================================
 
 static void event_callback(mr_event_t event, mr_event_data_t event_data) {
-    // handle some events internally
-    switch (event) {
-        case MARI_NODE_LEFT:
-            mr_bloom_gateway_set_dirty();
-            break;
-        default:
-            break;
-    }
-
     // forward the event to the application callback
     if (_mari_vars.app_event_callback) {
         _mari_vars.app_event_callback(event, event_data);
@@ -18,23 +18,84 @@
 
 //=========================== defines ==========================================
 
-#define MARI_MAX_NODES         101  // FIXME: find a way to sync with the pre-stored schedules
+#define MARI_MAX_NODES         102  // the most nodes of a built-in schedule, checked by 01mari_schedgen -c at each host build
 #define MARI_BROADCAST_ADDRESS 0xFFFFFFFFFFFFFFFF
 
+typedef struct mari_ctx mari_ctx_t;  ///< State of a mari instance, see context.h
+
 //=========================== prototypes ==========================================
 
-void           mari_init(mr_node_type_t node_type, uint16_t net_id, schedule_t *app_schedule, mr_event_cb_t app_event_callback);
+void           mari_init(mr_node_type_t node_type, uint16_t net_id, const schedule_t *app_schedule, mr_event_cb_t app_event_callback);
 void           mari_event_loop(void);
-void           mari_tx(uint8_t *packet, uint8_t length);
+mr_tx_status_t mari_tx(uint8_t *packet, uint8_t length);
 mr_node_type_t mari_get_node_type(void);
 void           mari_set_node_type(mr_node_type_t node_type);
 
+/**
+ * @brief Zero-copy alternative to mari_tx: builds a packet right in the queue
+ *
+ * mari_tx_reserve gives a buffer of MARI_PACKET_MAX_SIZE bytes, or NULL if the
+ * queue is full. The packet is queued once mari_tx_commit is called with its length.
+ */
+uint8_t       *mari_tx_reserve(void);
+mr_tx_status_t mari_tx_commit(uint8_t length);
+
+/**
+ * @brief Gets the counters of the packet queue, cleared by mari_init
+ */
+void mari_get_queue_stats(mr_queue_stats_t *stats);
+
+/**
+ * @brief Number of packets queued, and number of packets that can still be queued
+ */
+uint8_t mari_queue_depth(void);
+uint8_t mari_queue_free(void);
+
+/**
+ * @brief Sets the depths at which MARI_QUEUE_HIGH and MARI_QUEUE_LOW are emitted, after mari_init
+ *
+ * MARI_QUEUE_HIGH is emitted when the depth reaches `high`, then MARI_QUEUE_LOW once it goes
+ * back down to `low`, so that applications can stop queueing in between.
+ */
+void mari_set_queue_watermarks(uint8_t high, uint8_t low);
+
 size_t mari_gateway_get_nodes(uint64_t *nodes);
 size_t mari_gateway_count_nodes(void);
 
-void     mari_node_tx_payload(uint8_t *payload, uint8_t payload_len);
-bool     mari_node_is_connected(void);
-uint64_t mari_node_gateway_id(void);
+/**
+ * @brief Starts sending an image to all the joined nodes, in the downlink cells that the queue leaves free
+ *
+ * Nodes get the image chunk by chunk through MARI_BULK_CHUNK events, then MARI_BULK_COMPLETE.
+ * The gateway gets MARI_BULK_COMPLETE once all its nodes have the whole image, or MARI_BULK_ABORTED
+ * if some of them still do not after MARI_BULK_MAX_RESENDS tries. The image must stay valid until
+ * then, or until mari_gateway_bulk_stop.
+ *
+ * @return false if a transfer is already running, if the downlink cells are too short for chunks,
+ *         or if the image does not fit in MARI_BULK_MAX_CHUNKS chunks
+ */
+bool mari_gateway_bulk_start(const uint8_t *image, uint32_t image_len);
+void mari_gateway_bulk_stop(void);
+
+mr_tx_status_t mari_node_tx_payload(uint8_t *payload, uint8_t payload_len);
+bool           mari_node_is_connected(void);
+uint64_t       mari_node_gateway_id(void);
+
+// -------- instances --------
+
+/**
+ * @brief Clears an instance, before it is selected and initialized with mari_init
+ *
+ * Not needed for instances that are statically allocated, or allocated with calloc.
+ */
+void mari_ctx_init(mari_ctx_t *ctx);
+
+/**
+ * @brief Selects the instance that the mari functions operate on, NULL selects the default one
+ *
+ * The instance must also be selected before its timer and radio interrupts are handled.
+ */
+void        mari_ctx_select(mari_ctx_t *ctx);
+mari_ctx_t *mari_ctx_current(void);
 
 // -------- internal api --------
 bool mr_handle_packet(uint8_t *packet, uint8_t length);
@@ -15,6 +15,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <nrf.h>
 #include <stdbool.h>
 
@@ -27,17 +28,24 @@
 
 // #ifndef MARI_FIXED_CHANNEL
 #define MARI_FIXED_CHANNEL      0   // to hardcode the channel, use a valid value other than 0
-#define MARI_FIXED_SCAN_CHANNEL 37  // to hardcode the channel, use a valid value other than 0
+#define MARI_FIXED_SCAN_CHANNEL 0   // to hardcode the channel, use a valid value other than 0, otherwise beacons and scans hop over 37, 38 and 39
 // #endif
 
 #define MARI_N_CELLS_MAX 149
 
 #define MARI_ENABLE_BACKGROUND_SCAN 1
 
+#ifndef MARI_ENABLE_ACK
+#define MARI_ENABLE_ACK 0  // whether unicast data frames are acknowledged within their slot, and sent again when not (same value on all devices)
+#endif
+
 #define MARI_PACKET_MAX_SIZE 255
 
 #define MARI_STATS_SCHED_USAGE_SIZE 4  // supports schedules with up to 256 cells
 
+#define MARI_UPLINK_BITMAP_BYTES 13  // one bit per uplink index, enough for MARI_MAX_NODES
+#define MARI_CHANNEL_MAP_BYTES   5   // one bit per data channel, as in the BLE channel maps
+
 //=========================== types ============================================
 
 // -------- types sent over the air --------
@@ -48,6 +56,9 @@ typedef enum {
     MARI_PACKET_JOIN_RESPONSE = 4,
     MARI_PACKET_KEEPALIVE     = 8,
     MARI_PACKET_DATA          = 16,
+    MARI_PACKET_AGGREGATED    = 32,
+    MARI_PACKET_BULK          = 64,
+    MARI_PACKET_ACK           = 128,
 } mr_packet_type_t;
 
 typedef struct __attribute__((packed)) {
@@ -64,7 +75,7 @@ typedef struct __attribute__((packed)) {
     mr_packet_statistics_t stats;
 } mr_packet_header_t;
 
-// beacon packet
+// beacon packet, only the first MARI_BEACON_HEADER_LEN bytes and the membership length are sent
 typedef struct __attribute__((packed)) {
     uint8_t          version;
     mr_packet_type_t type;
@@ -73,9 +84,38 @@ typedef struct __attribute__((packed)) {
     uint64_t         src;
     uint8_t          remaining_capacity;
     uint8_t          active_schedule_id;
-    uint8_t          bloom_filter[MARI_BLOOM_M_BYTES];
+    uint8_t          next_schedule_id;                           // schedule used from asn + switch_countdown on, when a switch is announced
+    uint16_t         switch_countdown;                           // slots until the schedule switch, 0 when none is announced
+    uint8_t          uplink_received[MARI_UPLINK_BITMAP_BYTES];  // bit set for each uplink index whose frame the gateway received in the previous slotframe
+    uint8_t          channel_map[MARI_CHANNEL_MAP_BYTES];        // bit set for each data channel used from asn + channel_map_countdown on
+    uint16_t         channel_map_countdown;                      // slots until the channel map applies, 0 when it is already in use
+    uint8_t          membership_encoding;                        // mr_membership_encoding_t, the length is given by the packet length
+    uint8_t          membership[MARI_MEMBERSHIP_MAX_BYTES];
 } mr_beacon_packet_header_t;
 
+#define MARI_BEACON_HEADER_LEN (offsetof(mr_beacon_packet_header_t, membership))
+#define MARI_BEACON_MAX_LEN    (sizeof(mr_beacon_packet_header_t))
+
+// aggregated downlink packet: a general header sent to broadcast, followed by sub-packets for different nodes, each one with this header
+typedef struct __attribute__((packed)) {
+    uint64_t dst;
+    uint8_t  len;  // length of the payload that follows
+} mr_aggregated_header_t;
+
+// chunk of a bulk transfer, multicast by the gateway: a general header sent to broadcast, then this header, then the data
+typedef struct __attribute__((packed)) {
+    uint8_t  transfer_id;
+    uint16_t index;       // the chunk is at index * chunk_size in the image
+    uint8_t  chunk_size;  // length of all the chunks but the last one
+    uint32_t image_len;
+} mr_bulk_chunk_header_t;
+
+// report of a node on a bulk transfer, appended to its keepalives, then a bitmap of the missing chunks from `first` on
+typedef struct __attribute__((packed)) {
+    uint8_t  transfer_id;
+    uint16_t first;  // first chunk of the bitmap, a multiple of 8, or the number of chunks once the node has them all
+} mr_bulk_report_header_t;
+
 // -------- types used internally --------
 
 typedef enum {
@@ -91,6 +131,11 @@ typedef enum {
     MARI_NODE_LEFT,
     MARI_KEEPALIVE,
     MARI_ERROR,
+    MARI_QUEUE_HIGH,     // the queue filled up to its high watermark, see mari_set_queue_watermarks
+    MARI_QUEUE_LOW,      // the queue drained down to its low watermark, after a MARI_QUEUE_HIGH
+    MARI_BULK_CHUNK,     // node only: a chunk of a bulk transfer was received for the first time
+    MARI_BULK_COMPLETE,  // node: all the chunks were received, gateway: all the joined nodes have them
+    MARI_BULK_ABORTED,   // gateway only: the transfer was given up, some joined nodes never got or reported all the chunks
 } mr_event_t;
 
 typedef enum {
@@ -104,6 +149,9 @@ typedef enum {
     MARI_HANDOVER_FAILED   = 7,
 } mr_event_tag_t;
 
+// a received data packet, len bytes from header, with the payload right after the header
+// it points into the buffer of the received frame, which the next MARI_NEW_PACKET or the next frame overwrites
+// an aggregated packet gives one MARI_NEW_PACKET per sub-packet for the node, in a row: copy the packet in the callback
 typedef struct {
     uint8_t             len;
     mr_packet_header_t *header;
@@ -120,10 +168,42 @@ typedef struct {
         struct {
             uint64_t gateway_id;
         } gateway_info;
+        struct {
+            uint8_t depth;
+        } queue_info;
+        struct {
+            uint8_t        transfer_id;
+            uint32_t       image_len;
+            uint32_t       offset;       // of the chunk in the image
+            const uint8_t *data;         // of the chunk
+            uint8_t        len;          // of the chunk
+            uint16_t       chunks_sent;  // gateway only: chunks sent during the transfer, repairs included
+        } bulk;
     } data;
     mr_event_tag_t tag;
 } mr_event_data_t;
 
+// result of queueing a packet for transmission
+typedef enum {
+    MARI_TX_OK         = 0,
+    MARI_TX_QUEUE_FULL = 1,  // no free packet in the queue
+    MARI_TX_LANE_FULL  = 2,  // gateway only: too many packets queued for the same node
+    MARI_TX_NOT_JOINED = 3,  // gateway only: the destination is not joined
+    MARI_TX_TOO_LONG   = 4,  // the packet does not fit in MARI_PACKET_MAX_SIZE, or in the frames of the cells that carry it
+} mr_tx_status_t;
+
+// counters of the packet queue, see mari_get_queue_stats
+typedef struct {
+    uint32_t dropped_full;        ///< Packets dropped because the queue, or the lane of their destination, was full
+    uint32_t dropped_not_joined;  ///< Gateway only: packets dropped because their destination was not joined, or left while they were queued
+    uint32_t flushed;             ///< Packets dropped when the queue was reset, e.g. when the node left its gateway
+    uint32_t retried;             ///< Packets sent again because they were not acknowledged, see MARI_ENABLE_ACK
+    uint32_t dropped_no_ack;      ///< Packets dropped after MARI_QUEUE_MAX_RETRIES attempts without acknowledgement
+    uint32_t dropped_too_long;    ///< Packets dropped because they are longer than the frames of the cells that carry them
+    uint8_t  depth;               ///< Packets currently queued
+    uint8_t  high_watermark;      ///< Most packets queued at once
+} mr_queue_stats_t;
+
 typedef enum {
     MARI_RADIO_ACTION_SLEEP = 'S',
     MARI_RADIO_ACTION_RX    = 'R',
@@ -141,24 +221,40 @@ typedef struct {
     mr_radio_action_t radio_action;
     uint8_t           channel;
     slot_type_t       type;
+    uint8_t           max_frame_len;  // longest frame that fits in the slot
+    uint16_t          duration_us;    // duration of the slot, see MARI_SLOT_DURATION
 } mr_slot_info_t;
 
 typedef struct {
     slot_type_t type;
     uint8_t     channel_offset;
-    uint64_t    assigned_node_id;
-    uint64_t    last_received_asn;  ///< ASN marking the last time the node was heard from
-    uint64_t    bloom_h1;           ///< H1 hash of the node ID, used to compute the bloom filter
-    uint64_t    bloom_h2;           ///< H2 hash of the node ID, used to compute the bloom filter
 } cell_t;
 
+// state of a cell in a given mari instance, kept apart so that schedules can be shared read-only
+typedef struct {
+    uint64_t assigned_node_id;
+    uint64_t last_received_asn;  ///< ASN marking the last time the node was heard from
+    uint64_t bloom_h1;           ///< H1 hash of the node ID, used to compute the bloom filter
+    uint64_t bloom_h2;           ///< H2 hash of the node ID, used to compute the bloom filter
+    bool     bulk_done;          ///< Whether the node reported that it has all the chunks of the bulk transfer
+} mr_cell_assignment_t;
+
+// longest frame sent in each type of cell, which sets the duration of the cell, 0 for the default of the type (see scheduler.c)
+typedef struct {
+    uint8_t beacon;
+    uint8_t shared_uplink;
+    uint8_t downlink;
+    uint8_t uplink;
+} mr_frame_lengths_t;
+
 typedef struct {
-    uint8_t id;                       // unique identifier for the schedule
-    uint8_t max_nodes;                // maximum number of nodes that can be scheduled, equivalent to the number of uplink slot_durations
-    uint8_t backoff_n_min;            // minimum exponent for the backoff algorithm
-    uint8_t backoff_n_max;            // maximum exponent for the backoff algorithm
-    size_t  n_cells;                  // number of cells in this schedule
-    cell_t  cells[MARI_N_CELLS_MAX];  // cells in this schedule. NOTE(FIXME?): the first 3 cells must be beacons
+    uint8_t            id;                       // unique identifier for the schedule
+    uint8_t            max_nodes;                // maximum number of nodes that can be scheduled, equivalent to the number of uplink slot_durations
+    uint8_t            backoff_n_min;            // minimum exponent for the backoff algorithm
+    uint8_t            backoff_n_max;            // maximum exponent for the backoff algorithm
+    mr_frame_lengths_t max_frame_len;            // per slot type, packets longer than that are not sent
+    size_t             n_cells;                  // number of cells in this schedule
+    cell_t             cells[MARI_N_CELLS_MAX];  // cells in this schedule. NOTE(FIXME?): the first 3 cells must be beacons
 } schedule_t;
 
 typedef struct {
@@ -13,6 +13,9 @@
 #include "association.h"
 #include "packet.h"
 #include "mac.h"
+#include "mari.h"
+
+_Static_assert(MARI_UPLINK_BITMAP_BYTES * 8 >= MARI_MAX_NODES, "the beacons need one bit per uplink index");
 
 //=========================== prototypes =======================================
 
@@ -30,6 +33,11 @@ size_t mr_build_packet_keepalive(uint8_t *buffer, uint64_t dst) {
     return _set_header(buffer, dst, MARI_PACKET_KEEPALIVE);
 }
 
+size_t mr_build_packet_ack(uint8_t *buffer, uint64_t dst) {
+    // just the header: the source tells which frame is acknowledged, there is one per slot
+    return _set_header(buffer, dst, MARI_PACKET_ACK);
+}
+
 size_t mr_build_packet_join_request(uint8_t *buffer, uint64_t dst) {
     return _set_header(buffer, dst, MARI_PACKET_JOIN_REQUEST);
 }
@@ -48,10 +56,36 @@ size_t mr_build_packet_beacon(uint8_t *buffer, uint16_t net_id, uint64_t asn, ui
         .remaining_capacity = remaining_capacity,
         .active_schedule_id = active_schedule_id,
     };
-    // add bloom filter
-    mr_bloom_gateway_copy(beacon.bloom_filter);
-    memcpy(buffer, &beacon, sizeof(mr_beacon_packet_header_t));
-    return sizeof(mr_beacon_packet_header_t);
+    beacon.switch_countdown = mr_scheduler_get_pending_switch(asn, &beacon.next_schedule_id);
+    memcpy(beacon.uplink_received, mr_scheduler_get_uplink_received(), MARI_UPLINK_BITMAP_BYTES);
+    beacon.channel_map_countdown = mr_scheduler_get_pending_channel_map(asn, beacon.channel_map);
+    // add the membership right after the header, its length depends on the encoding
+    uint8_t membership_len = mr_bloom_gateway_copy(&beacon.membership_encoding, buffer + MARI_BEACON_HEADER_LEN);
+    memcpy(buffer, &beacon, MARI_BEACON_HEADER_LEN);
+    return MARI_BEACON_HEADER_LEN + membership_len;
+}
+
+size_t mr_build_packet_aggregated(uint8_t *buffer) {
+    // the destinations are in the sub-packets
+    return _set_header(buffer, MARI_BROADCAST_ADDRESS, MARI_PACKET_AGGREGATED);
+}
+
+size_t mr_build_packet_bulk_chunk(uint8_t *buffer, const mr_bulk_chunk_header_t *chunk, const uint8_t *data, uint8_t data_len) {
+    // multicast: every node of the gateway takes the chunk, if it misses it
+    size_t header_len = _set_header(buffer, MARI_BROADCAST_ADDRESS, MARI_PACKET_BULK);
+    memcpy(buffer + header_len, chunk, sizeof(mr_bulk_chunk_header_t));
+    memcpy(buffer + header_len + sizeof(mr_bulk_chunk_header_t), data, data_len);
+    return header_len + sizeof(mr_bulk_chunk_header_t) + data_len;
+}
+
+size_t mr_append_packet_aggregated(uint8_t *buffer, size_t len, uint64_t dst, const uint8_t *payload, uint8_t payload_len) {
+    mr_aggregated_header_t sub_header = {
+        .dst = dst,
+        .len = payload_len,
+    };
+    memcpy(buffer + len, &sub_header, sizeof(mr_aggregated_header_t));
+    memcpy(buffer + len + sizeof(mr_aggregated_header_t), payload, payload_len);
+    return len + sizeof(mr_aggregated_header_t) + payload_len;
 }
 
 size_t mr_build_uart_packet_gateway_info(uint8_t *buffer) {
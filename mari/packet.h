@@ -21,7 +21,7 @@
 
 //=========================== defines ==========================================
 
-#define MARI_PROTOCOL_VERSION 2
+#define MARI_PROTOCOL_VERSION 6
 
 #define MARI_NET_ID_PATTERN_ANY 0
 #define MARI_NET_ID_DEFAULT     1
@@ -36,8 +36,16 @@ size_t mr_build_packet_join_response(uint8_t *buffer, uint64_t dst);
 
 size_t mr_build_packet_keepalive(uint8_t *buffer, uint64_t dst);
 
+size_t mr_build_packet_ack(uint8_t *buffer, uint64_t dst);
+
 size_t mr_build_packet_beacon(uint8_t *buffer, uint16_t net_id, uint64_t asn, uint8_t remaining_capacity, uint8_t active_schedule_id);
 
+size_t mr_build_packet_aggregated(uint8_t *buffer);
+
+size_t mr_build_packet_bulk_chunk(uint8_t *buffer, const mr_bulk_chunk_header_t *chunk, const uint8_t *data, uint8_t data_len);
+
+size_t mr_append_packet_aggregated(uint8_t *buffer, size_t len, uint64_t dst, const uint8_t *payload, uint8_t payload_len);
+
 size_t mr_build_uart_packet_gateway_info(uint8_t *buffer);
 
 #endif
@@ -4,6 +4,16 @@
  *
  * @brief       Packet queue management
  *
+ * Packets are linked into lanes by their index. With MARI_QUEUE_BYTE_RING,
+ * the packets themselves are stored back to back in a byte ring, in chunks
+ * made of a state byte followed by the mr_packet_t, cut to its length. A
+ * chunk is reserved for the longest packet, then cut down on commit, leaving
+ * the rest as freed space if other chunks were reserved after it. As lanes
+ * are not served in the order the chunks were reserved, a freed chunk is only
+ * reclaimed once all the older ones are freed too. A chunk that does not fit
+ * before the end of the ring starts over at the beginning, so that the radio
+ * can always read a packet in one piece.
+ *
  * @author Geovane Fedrecheski <geovane.fedrecheski@inria.fr>
  *
  * @copyright Inria, 2024
@@ -19,145 +29,359 @@
 #include "scheduler.h"
 #include "association.h"
 #include "bloom.h"
+#include "bulk.h"
 #include "mari.h"
 #include "queue.h"
+#include "context.h"
 
 //=========================== defines ==========================================
 
-typedef struct {
-    uint8_t length;
-    uint8_t buffer[MARI_PACKET_MAX_SIZE];
-} mr_packet_t;
+//=========================== variables ========================================
 
-typedef struct {
-    uint8_t     current;  ///< Current position in the queue
-    uint8_t     last;     ///< Position of the last item added in the queue
-    mr_packet_t packets[MARI_PACKET_QUEUE_SIZE];
-} mari_packet_queue_t;
+// state of the selected mari instance, see context.h
+#define queue_vars (mr_ctx->queue)
 
-typedef struct {
-    mari_packet_queue_t packet_queue;
-    bool                queue_locked;  ///< Simple lock to prevent concurrent access
-    mr_packet_t         join_packet;
-} queue_vars_t;
+#if MARI_QUEUE_BYTE_RING
+// state byte of a chunk of the ring
+#define MARI_QUEUE_CHUNK_USED (1)                                                      // reserved, queued, or being sent
+#define MARI_QUEUE_CHUNK_FREE (2)                                                      // freed, but not reclaimed yet
+#define MARI_QUEUE_CHUNK_SKIP (3)                                                      // the rest of the ring is not used, the next chunk is at the beginning
+#define MARI_QUEUE_CHUNK_PAD  (4)                                                      // a byte left over by a chunk cut down after others were reserved
+#define MARI_QUEUE_CHUNK_MAX  (MARI_QUEUE_CHUNK_HEADER_LEN + MARI_PACKET_MAX_SIZE)  // a reserved chunk, before it is cut down to its packet
+#endif
 
-//=========================== variables ========================================
+//=========================== prototypes =======================================
 
-static queue_vars_t queue_vars = { 0 };
+// next downlink packet of the gateway, aggregating the queued data packets that fit together
+static const mr_packet_t *_next_downlink_packet(void);
 
-//=========================== prototypes =======================================
+// next uplink packet of the node, taken out of the queue
+static const mr_packet_t *_next_uplink_packet(void);
+
+// frees the packet that the radio was sending, if it comes from the queue
+static void _release_in_flight(void);
+
+// whether the packet is sent to a single device, which acknowledges it
+static bool _is_unicast_data(const mr_packet_t *packet);
+
+// whether the packet is kept after being sent, until an ACK or a beacon tells that it was received
+static bool _needs_confirmation(const mr_packet_t *packet);
+
+// puts a packet back at the head of its lane, to be sent again first
+static void _requeue(uint8_t index);
+
+// drops the queued packets, keeping the one the application is building
+static void _flush(void);
+
+// takes a packet from the free list, MARI_QUEUE_NONE if the queue is full
+static uint8_t _take_free(void);
+
+// queues a packet taken with _take_free, which is freed if the packet is dropped
+static mr_tx_status_t _enqueue(uint8_t index, uint8_t length);
+
+// waits for the queue to be unlocked, then locks it
+static void _lock(void);
+
+// locks the queue if it is unlocked, returns false otherwise
+static bool _try_lock(void);
+
+// unlocks the queue
+static void _unlock(void);
+
+// tells the application that the queue crossed one of its watermarks
+static void _emit_watermark_event(mr_event_t event);
+
+// lane of a packet to be queued, MARI_QUEUE_NONE if it should be dropped
+static uint8_t _lane_of(const uint8_t *packet, uint8_t length);
+
+// packet to be sent next according to the deficit round-robin, MARI_QUEUE_NONE if there is none
+static uint8_t _peek_next(void);
+
+// removes the packet to be sent next from its lane, it must be freed once used
+static uint8_t _pop_next(void);
+
+// removes the first packet of the lane being served, right after _peek_next found it
+static uint8_t _unlink_next(void);
+
+// adds a lane at the end of the round-robin
+static void _append_active(uint8_t lane);
+
+// removes the lane being served from the round-robin
+static void _remove_first_active(void);
+
+// gives a packet back to the free list
+static void _free(uint8_t index);
+
+// a queued packet, by its index
+static mr_packet_t *_packet(uint8_t index);
+
+#if MARI_QUEUE_BYTE_RING
+// takes room for a chunk at the head of the ring, returns false if there is not enough room
+static bool _ring_alloc(uint8_t index);
+
+// cuts the chunk of the packet being committed down to its length
+static void _ring_shrink(uint8_t index);
+
+// reclaims the chunks that are freed, starting from the oldest one
+static void _ring_reclaim(void);
+#endif
+
+// whether a queued packet can be sent as a sub-packet of an aggregated packet
+static bool _is_aggregatable(const mr_packet_t *queued);
+
+// length it takes as a sub-packet of an aggregated packet
+static size_t _aggregated_len(const mr_packet_t *queued);
+
+// appends a queued packet as a sub-packet of an aggregated packet
+static size_t _append_aggregated(uint8_t *packet, size_t len, const mr_packet_t *queued);
 
 //=========================== public ===========================================
 
-uint8_t mr_queue_next_packet(slot_type_t slot_type, uint8_t *packet) {
-    uint8_t len = 0;
+// the returned packet is sent by the radio from where it is, and stays unchanged until the next call
+const mr_packet_t *mr_queue_next_packet(slot_type_t slot_type) {
+    mr_packet_t       *tx_packet = &queue_vars.tx_packet;
+    const mr_packet_t *queued    = NULL;
+    tx_packet->length            = 0;
+
+    // the MAC does not wait for the application: if the queue is being updated, queued packets are sent in a later slot
+    bool locked = _try_lock();
+    if (locked && (slot_type == SLOT_TYPE_UPLINK || slot_type == SLOT_TYPE_DOWNLINK)) {
+        // the packet sent in the previous cell of this type is done with, unless it has to be sent again
+        // (a node learns it from the beacons, which come before its next uplink cell)
+        _release_in_flight();
+    }
 
     if (mari_get_node_type() == MARI_GATEWAY) {
         if (slot_type == SLOT_TYPE_BEACON) {
             // prepare a beacon packet with current asn, remaining capacity and active schedule id
-            len = mr_build_packet_beacon(
-                packet,
+            tx_packet->length = mr_build_packet_beacon(
+                tx_packet->buffer,
                 mr_assoc_get_network_id(),
                 mr_mac_get_asn(),
                 mr_scheduler_gateway_remaining_capacity(),
                 mr_scheduler_get_active_schedule_id());
         } else if (slot_type == SLOT_TYPE_DOWNLINK) {
             if (mr_queue_has_join_packet()) {
-                len = mr_queue_get_join_packet(packet);
-            } else {
+                tx_packet->length = mr_queue_get_join_packet(tx_packet->buffer);
+            } else if (locked) {
                 // load a packet from the queue, if any is available
-                len = mr_queue_peek(packet);
-                if (len) {
-                    // actually pop the packet from the queue
-                    mr_queue_pop();
-                }
+                queued = _next_downlink_packet();
+            }
+            if (queued == NULL && tx_packet->length == 0) {
+                // the cells that the application leaves free carry the bulk transfer, if any
+                tx_packet->length = mr_bulk_gateway_build_chunk(tx_packet->buffer, mr_scheduler_get_max_frame_len(SLOT_TYPE_DOWNLINK));
             }
         }
     } else if (mari_get_node_type() == MARI_NODE) {
         if (slot_type == SLOT_TYPE_SHARED_UPLINK) {
             if (mr_assoc_node_ready_to_join()) {
                 mr_assoc_node_start_joining();
-                len = mr_queue_get_join_packet(packet);
+                tx_packet->length = mr_queue_get_join_packet(tx_packet->buffer);
             }
         } else if (slot_type == SLOT_TYPE_UPLINK) {
             // load a packet from the queue, if any is available
-            len = mr_queue_peek(packet);
-            if (len) {
-                // actually pop the packet from the queue
-                mr_queue_pop();
-            } else if (MARI_AUTO_UPLINK_KEEPALIVE) {
+            if (locked) {
+                queued = _next_uplink_packet();
+            }
+            if (queued == NULL && MARI_AUTO_UPLINK_KEEPALIVE) {
                 // send a keepalive packet
-                len = mr_build_packet_keepalive(packet, mr_mac_get_synced_gateway());
+                tx_packet->length = mr_build_packet_keepalive(tx_packet->buffer, mr_mac_get_synced_gateway());
+                // with the chunks of the bulk transfer that are missing, if any
+                tx_packet->length += mr_bulk_node_build_report(tx_packet->buffer + tx_packet->length, mr_scheduler_get_max_frame_len(SLOT_TYPE_UPLINK) - tx_packet->length);
             }
         }
     }
 
-    return len;
+    if (locked) {
+        _unlock();
+    }
+    if (queue_vars.drained) {
+        // the queue drained while the lock was held, tell the application now that it can queue again
+        queue_vars.drained = false;
+        _emit_watermark_event(MARI_QUEUE_LOW);
+    }
+    if (queued != NULL) {
+        return queued;
+    }
+    return tx_packet->length ? tx_packet : NULL;
 }
 
-void mr_queue_add(uint8_t *packet, uint8_t length) {
-    // lock is asymetrical: add (called from application) can wait in busy loop
-    while (queue_vars.queue_locked) {
-        // wait for the queue to be unlocked
+// whether the MAC has to wait for an ACK after sending the packet given by mr_queue_next_packet
+bool mr_queue_needs_ack(const mr_packet_t *packet) {
+    uint8_t in_flight = queue_vars.packet_queue.in_flight;
+    return MARI_ENABLE_ACK && in_flight != MARI_QUEUE_NONE && packet == _packet(in_flight) && _is_unicast_data(packet);
+}
+
+// called when the packet sent is acknowledged, or listed as received by a beacon, or cannot be sent: it is freed rather than sent again
+void mr_queue_in_flight_done(void) {
+    queue_vars.packet_queue.in_flight_done = true;
+}
+
+// called when the packet given by mr_queue_next_packet is longer than the frames of the slot, e.g. after a schedule switch
+void mr_queue_drop_too_long(const mr_packet_t *packet) {
+    uint8_t in_flight = queue_vars.packet_queue.in_flight;
+    if (in_flight == MARI_QUEUE_NONE || packet != _packet(in_flight)) {
+        // built by the MAC for this slot only, nothing to free
+        return;
+    }
+    queue_vars.packet_queue.in_flight_done = true;
+    queue_vars.stats.dropped_too_long++;
+}
+
+void mr_queue_init(mr_event_cb_t event_callback) {
+    queue_vars.event_callback = event_callback;
+    queue_vars.watermark_high = MARI_QUEUE_WATERMARK_HIGH;
+    queue_vars.watermark_low  = MARI_QUEUE_WATERMARK_LOW;
+
+    // the MAC is not running yet: the queue is built empty without the lock
+    mari_packet_queue_t *queue = &queue_vars.packet_queue;
+    for (size_t i = 0; i < MARI_PACKET_QUEUE_SIZE; i++) {
+        queue->next[i] = i + 1 < MARI_PACKET_QUEUE_SIZE ? i + 1 : MARI_QUEUE_NONE;
+    }
+    queue->free = 0;
+    for (size_t i = 0; i < MARI_QUEUE_N_LANES; i++) {
+        queue->lanes[i] = (mr_queue_lane_t){ .head = MARI_QUEUE_NONE, .tail = MARI_QUEUE_NONE };
+    }
+    queue->reserved  = MARI_QUEUE_NONE;
+    queue->in_flight = MARI_QUEUE_NONE;
+#if MARI_QUEUE_BYTE_RING
+    queue->ring_head = 0;
+    queue->ring_tail = 0;
+    queue->ring_used = 0;
+#endif
+    atomic_flag_clear_explicit(&queue_vars.lock, memory_order_release);
+    queue_vars.reset_pending = false;
+    mr_queue_reset();
+    mr_queue_reset_stats();
+}
+
+// takes a packet of its own, so that a packet being built between mr_queue_reserve and mr_queue_commit is left alone
+mr_tx_status_t mr_queue_add(uint8_t *packet, uint8_t length) {
+    uint8_t index = _take_free();
+    if (index == MARI_QUEUE_NONE) {
+        return MARI_TX_QUEUE_FULL;
+    }
+    memcpy(_packet(index)->buffer, packet, length);
+    return _enqueue(index, length);
+}
+
+// gives the application a free packet to build in place, NULL if the queue is full
+// the packet is only queued by mr_queue_commit, and the same packet is given back until then
+uint8_t *mr_queue_reserve(void) {
+    mari_packet_queue_t *queue = &queue_vars.packet_queue;
+
+    if (queue->reserved == MARI_QUEUE_NONE) {
+        // the packet belongs to the application until committed
+        queue->reserved = _take_free();
     }
-    queue_vars.queue_locked = true;
 
-    // enqueue for transmission
-    memcpy(queue_vars.packet_queue.packets[queue_vars.packet_queue.last].buffer, packet, length);
-    queue_vars.packet_queue.packets[queue_vars.packet_queue.last].length = length;
-    // increment the `last` index
-    queue_vars.packet_queue.last = (queue_vars.packet_queue.last + 1) % MARI_PACKET_QUEUE_SIZE;
+    if (queue->reserved == MARI_QUEUE_NONE) {
+        return NULL;
+    }
+    return _packet(queue->reserved)->buffer;
+}
 
-    queue_vars.queue_locked = false;
+// queues the packet built in the buffer given by mr_queue_reserve, which is freed if the packet is dropped
+mr_tx_status_t mr_queue_commit(uint8_t length) {
+    mari_packet_queue_t *queue = &queue_vars.packet_queue;
+    uint8_t              index = queue->reserved;
+    if (index == MARI_QUEUE_NONE) {
+        // nothing was reserved, because the queue was full
+        return MARI_TX_QUEUE_FULL;
+    }
+    queue->reserved = MARI_QUEUE_NONE;
+    return _enqueue(index, length);
 }
 
 uint8_t mr_queue_peek(uint8_t *packet) {
     // lock is asymetrical: peek (called from MAC) can simply give up if the queue is locked
-    if (queue_vars.queue_locked) {
+    if (!_try_lock()) {
         // simply give up if the queue is locked (will try again next slot)
         return 0;
     }
 
-    if (queue_vars.packet_queue.current == queue_vars.packet_queue.last) {
-        return 0;
+    uint8_t len   = 0;
+    uint8_t index = _peek_next();
+    if (index != MARI_QUEUE_NONE) {
+        // the packet stays in the queue, as this is just a peek
+        len = _packet(index)->length;
+        memcpy(packet, _packet(index)->buffer, len);
     }
-
-    memcpy(packet, queue_vars.packet_queue.packets[queue_vars.packet_queue.current].buffer, queue_vars.packet_queue.packets[queue_vars.packet_queue.current].length);
-    // do not increment the `current` index here, as this is just a peek
-    return queue_vars.packet_queue.packets[queue_vars.packet_queue.current].length;
+    _unlock();
+    return len;
 }
 
 bool mr_queue_pop(void) {
     // lock is asymetrical: just as with peek
-    if (queue_vars.queue_locked) {
+    if (!_try_lock()) {
         // simply give up if the queue is locked (will try again next slot)
         return false;
     }
 
-    if (queue_vars.packet_queue.current == queue_vars.packet_queue.last) {
-        return false;
-    } else {
-        // increment the `current` index
-        queue_vars.packet_queue.current = (queue_vars.packet_queue.current + 1) % MARI_PACKET_QUEUE_SIZE;
-        return true;
+    uint8_t index = _pop_next();
+    if (index != MARI_QUEUE_NONE) {
+        _free(index);
     }
+    _unlock();
+    return index != MARI_QUEUE_NONE;
 }
 
+// called by the MAC: if the application holds the lock, the queue is flushed as soon as it is released
 void mr_queue_reset(void) {
-    queue_vars.packet_queue.current = 0;
-    queue_vars.packet_queue.last    = 0;
-    queue_vars.join_packet.length   = 0;
-    queue_vars.queue_locked         = false;
+    queue_vars.join_packet.length = 0;
     memset(queue_vars.join_packet.buffer, 0, sizeof(queue_vars.join_packet.buffer));
+
+    if (!_try_lock()) {
+        queue_vars.reset_pending = true;
+        return;
+    }
+    _flush();
+    _unlock();
+
+    if (queue_vars.drained) {
+        queue_vars.drained = false;
+        _emit_watermark_event(MARI_QUEUE_LOW);
+    }
+}
+
+void mr_queue_get_stats(mr_queue_stats_t *stats) {
+    _lock();
+    *stats = queue_vars.stats;
+    _unlock();
+}
+
+void mr_queue_reset_stats(void) {
+    _lock();
+    uint8_t depth                   = queue_vars.stats.depth;
+    queue_vars.stats                = (mr_queue_stats_t){ 0 };
+    queue_vars.stats.depth          = depth;
+    queue_vars.stats.high_watermark = depth;
+    _unlock();
+}
+
+uint8_t mr_queue_depth(void) {
+    return queue_vars.stats.depth;
+}
+
+uint8_t mr_queue_free(void) {
+    // packets that are neither queued, being built by the application, nor being sent
+    // NOTE: with MARI_QUEUE_BYTE_RING, the ring may run out of room before
+    const mari_packet_queue_t *queue = &queue_vars.packet_queue;
+    return MARI_PACKET_QUEUE_SIZE - queue_vars.stats.depth - (queue->reserved != MARI_QUEUE_NONE) - (queue->in_flight != MARI_QUEUE_NONE);
+}
+
+void mr_queue_set_watermarks(uint8_t high, uint8_t low) {
+    queue_vars.watermark_high = high;
+    queue_vars.watermark_low  = low;
 }
 
 void mr_queue_set_join_request(uint64_t node_id) {
     queue_vars.join_packet.length = mr_build_packet_join_request(queue_vars.join_packet.buffer, node_id);
 }
 
-void mr_queue_set_join_response(uint64_t node_id, uint8_t assigned_cell_id) {
+void mr_queue_set_join_response(uint64_t node_id, uint8_t assigned_uplink_index) {
     uint8_t len                          = mr_build_packet_join_response(queue_vars.join_packet.buffer, node_id);
-    queue_vars.join_packet.buffer[len++] = assigned_cell_id;
+    queue_vars.join_packet.buffer[len++] = assigned_uplink_index;
     queue_vars.join_packet.length        = len;
 }
 
@@ -176,3 +400,443 @@ uint8_t mr_queue_get_join_packet(uint8_t *packet) {
 
     return len;
 }
+
+//=========================== private ==========================================
+
+static const mr_packet_t *_next_downlink_packet(void) {
+    uint8_t first = _peek_next();
+    if (first == MARI_QUEUE_NONE) {
+        return NULL;
+    }
+    _unlink_next();
+    const mr_packet_t *queued  = _packet(first);
+    uint8_t            next    = _peek_next();
+    size_t             max_len = mr_scheduler_get_max_frame_len(SLOT_TYPE_DOWNLINK);
+
+    bool aggregate = MARI_DOWNLINK_AGGREGATION && next != MARI_QUEUE_NONE && _is_aggregatable(queued) && _is_aggregatable(_packet(next)) && sizeof(mr_packet_header_t) + _aggregated_len(queued) + _aggregated_len(_packet(next)) <= max_len;
+    if (!aggregate) {
+        // a single packet, sent as it was queued, from where it is
+        queue_vars.packet_queue.in_flight      = first;
+        queue_vars.packet_queue.in_flight_done = false;
+        return queued;
+    }
+
+    // greedily pack the next packets of the round-robin, in order, as long as they fit
+    uint8_t *packet = queue_vars.tx_packet.buffer;
+    size_t   len    = mr_build_packet_aggregated(packet);
+    len             = _append_aggregated(packet, len, queued);
+    _free(first);
+    for (; next != MARI_QUEUE_NONE; next = _peek_next()) {
+        queued = _packet(next);
+        if (!_is_aggregatable(queued) || len + _aggregated_len(queued) > max_len) {
+            break;
+        }
+        _unlink_next();
+        len = _append_aggregated(packet, len, queued);
+        _free(next);
+    }
+    queue_vars.tx_packet.length = len;
+    return &queue_vars.tx_packet;
+}
+
+static const mr_packet_t *_next_uplink_packet(void) {
+    uint8_t index = _pop_next();
+    if (index == MARI_QUEUE_NONE) {
+        return NULL;
+    }
+    queue_vars.packet_queue.in_flight      = index;
+    queue_vars.packet_queue.in_flight_done = false;
+    return _packet(index);
+}
+
+static void _release_in_flight(void) {
+    mari_packet_queue_t *queue = &queue_vars.packet_queue;
+    uint8_t              index = queue->in_flight;
+    if (index == MARI_QUEUE_NONE) {
+        return;
+    }
+    queue->in_flight = MARI_QUEUE_NONE;
+
+    if (queue->in_flight_done || !_needs_confirmation(_packet(index))) {
+        _free(index);
+    } else if (queue->retries[index] >= MARI_QUEUE_MAX_RETRIES) {
+        queue_vars.stats.dropped_no_ack++;
+        _free(index);
+    } else {
+        // not acknowledged: send it again at the next opportunity of its lane
+        queue->retries[index]++;
+        queue_vars.stats.retried++;
+        _requeue(index);
+    }
+}
+
+static bool _is_unicast_data(const mr_packet_t *packet) {
+    const mr_packet_header_t *header = (const mr_packet_header_t *)packet->buffer;
+    return packet->length >= sizeof(mr_packet_header_t) && header->type == MARI_PACKET_DATA && header->dst != MARI_BROADCAST_ADDRESS;
+}
+
+static bool _needs_confirmation(const mr_packet_t *packet) {
+    if (!_is_unicast_data(packet)) {
+        return false;
+    }
+    return MARI_ENABLE_ACK || (MARI_UPLINK_BITMAP_RETRY && mari_get_node_type() == MARI_NODE);
+}
+
+static void _requeue(uint8_t index) {
+    mari_packet_queue_t *queue = &queue_vars.packet_queue;
+    uint8_t              lane  = _lane_of(_packet(index)->buffer, _packet(index)->length);
+    if (lane == MARI_QUEUE_NONE) {
+        // the destination left meanwhile
+        queue_vars.stats.dropped_not_joined++;
+        _free(index);
+        return;
+    }
+
+    queue->next[index] = queue->lanes[lane].head;
+    if (queue->lanes[lane].count == 0) {
+        queue->lanes[lane].tail = index;
+        _append_active(lane);
+    }
+    queue->lanes[lane].head = index;
+    queue->lanes[lane].count++;
+    queue_vars.stats.depth++;
+}
+
+static void _flush(void) {
+    mari_packet_queue_t *queue = &queue_vars.packet_queue;
+    for (size_t i = 0; i < queue->active_count; i++) {
+        uint8_t index = queue->lanes[queue->active[(queue->active_first + i) % MARI_QUEUE_N_LANES]].head;
+        while (index != MARI_QUEUE_NONE) {
+            uint8_t next = queue->next[index];
+            _free(index);
+            index = next;
+        }
+    }
+    for (size_t i = 0; i < MARI_QUEUE_N_LANES; i++) {
+        queue->lanes[i] = (mr_queue_lane_t){ .head = MARI_QUEUE_NONE, .tail = MARI_QUEUE_NONE };
+    }
+    queue->active_first  = 0;
+    queue->active_count  = 0;
+    queue->round_started = false;
+    // the radio may still be sending the packet in flight: it is freed with the next packet, and not sent again
+    queue->in_flight_done = true;
+
+    // the packets still queued are dropped
+    queue_vars.stats.flushed += queue_vars.stats.depth;
+    queue_vars.stats.depth = 0;
+
+    if (queue_vars.saturated) {
+        // the MARI_QUEUE_LOW is emitted once the lock is released
+        queue_vars.saturated = false;
+        queue_vars.drained   = true;
+    }
+}
+
+static uint8_t _take_free(void) {
+    mari_packet_queue_t *queue = &queue_vars.packet_queue;
+
+    _lock();
+    uint8_t index    = queue->free;
+    bool    has_room = index != MARI_QUEUE_NONE;
+#if MARI_QUEUE_BYTE_RING
+    has_room = has_room && _ring_alloc(index);
+#endif
+    if (has_room) {
+        queue->free = queue->next[index];
+    } else {
+        queue_vars.stats.dropped_full++;
+        index = MARI_QUEUE_NONE;
+    }
+    _unlock();
+    return index;
+}
+
+static mr_tx_status_t _enqueue(uint8_t index, uint8_t length) {
+    mari_packet_queue_t *queue = &queue_vars.packet_queue;
+    _packet(index)->length     = length;
+    queue->retries[index]      = 0;
+
+    _lock();
+#if MARI_QUEUE_BYTE_RING
+    _ring_shrink(index);
+#endif
+
+    // a packet longer than the frames of the cells that carry it would never be sent
+    slot_type_t slot_type = mari_get_node_type() == MARI_GATEWAY ? SLOT_TYPE_DOWNLINK : SLOT_TYPE_UPLINK;
+    if (length > mr_scheduler_get_max_frame_len(slot_type)) {
+        queue_vars.stats.dropped_too_long++;
+        _free(index);
+        _unlock();
+        return MARI_TX_TOO_LONG;
+    }
+
+    uint8_t lane      = _lane_of(_packet(index)->buffer, length);
+    bool    lane_full = lane != MARI_QUEUE_NONE && mari_get_node_type() == MARI_GATEWAY && queue->lanes[lane].count >= MARI_QUEUE_LANE_MAX;
+    if (lane == MARI_QUEUE_NONE || lane_full) {
+        if (lane_full) {
+            queue_vars.stats.dropped_full++;
+        } else {
+            queue_vars.stats.dropped_not_joined++;
+        }
+        _free(index);
+        _unlock();
+        return lane_full ? MARI_TX_LANE_FULL : MARI_TX_NOT_JOINED;
+    }
+
+    // enqueue for transmission at the end of the lane, which becomes active if it was empty
+    queue->next[index] = MARI_QUEUE_NONE;
+    if (queue->lanes[lane].count == 0) {
+        queue->lanes[lane].head = index;
+        _append_active(lane);
+    } else {
+        queue->next[queue->lanes[lane].tail] = index;
+    }
+    queue->lanes[lane].tail = index;
+    queue->lanes[lane].count++;
+    queue_vars.stats.depth++;
+    if (queue_vars.stats.depth > queue_vars.stats.high_watermark) {
+        queue_vars.stats.high_watermark = queue_vars.stats.depth;
+    }
+    bool saturating = !queue_vars.saturated && queue_vars.stats.depth >= queue_vars.watermark_high;
+    if (saturating) {
+        queue_vars.saturated = true;
+    }
+    _unlock();
+
+    if (saturating) {
+        _emit_watermark_event(MARI_QUEUE_HIGH);
+    }
+    return MARI_TX_OK;
+}
+
+static void _lock(void) {
+    // lock is asymetrical: the application can wait in busy loop, while the MAC gives up
+    while (!_try_lock()) {
+        // wait for the queue to be unlocked
+    }
+}
+
+static bool _try_lock(void) {
+    // the MAC interrupts the application, not the other way around: a test-and-set is enough (LDREX/STREX on target)
+    if (atomic_flag_test_and_set_explicit(&queue_vars.lock, memory_order_acquire)) {
+        return false;
+    }
+    if (queue_vars.reset_pending) {
+        // the MAC asked for a reset after the last holder of the lock checked for it
+        queue_vars.reset_pending = false;
+        _flush();
+    }
+    return true;
+}
+
+static void _unlock(void) {
+    if (queue_vars.reset_pending) {
+        // the MAC asked for a reset while the lock was held
+        queue_vars.reset_pending = false;
+        _flush();
+    }
+    // makes the updates of the queue visible before the lock is released
+    atomic_flag_clear_explicit(&queue_vars.lock, memory_order_release);
+}
+
+static uint8_t _lane_of(const uint8_t *packet, uint8_t length) {
+    const mr_packet_header_t *header = (const mr_packet_header_t *)packet;
+    if (mari_get_node_type() != MARI_GATEWAY || length < sizeof(mr_packet_header_t) || header->dst == MARI_BROADCAST_ADDRESS) {
+        return MARI_QUEUE_SHARED_LANE;
+    }
+    // packets for nodes that are not joined would only waste downlink cells
+    int16_t uplink_index = mr_scheduler_gateway_get_node_uplink_index(header->dst);
+    return uplink_index >= 0 ? (uint8_t)uplink_index : MARI_QUEUE_NONE;
+}
+
+static uint8_t _peek_next(void) {
+    mari_packet_queue_t *queue = &queue_vars.packet_queue;
+
+    while (queue->active_count > 0) {
+        uint8_t          lane_index = queue->active[queue->active_first];
+        mr_queue_lane_t *lane       = &queue->lanes[lane_index];
+        uint8_t          index      = lane->head;
+
+        if (lane_index != MARI_QUEUE_SHARED_LANE && mr_scheduler_gateway_get_uplink_node(lane_index) != ((const mr_packet_header_t *)_packet(index)->buffer)->dst) {
+            // the node left, or its cell now belongs to another node: purge the packet
+            _free(_unlink_next());
+            queue_vars.stats.dropped_not_joined++;
+            continue;
+        }
+
+        if (!queue->round_started) {
+            lane->deficit += MARI_QUEUE_DRR_QUANTUM;
+            queue->round_started = true;
+        }
+        if (lane->deficit >= _packet(index)->length) {
+            return index;
+        }
+
+        // the lane used its quantum, it moves to the end of the round-robin
+        _remove_first_active();
+        _append_active(lane_index);
+    }
+    return MARI_QUEUE_NONE;
+}
+
+static uint8_t _pop_next(void) {
+    if (_peek_next() == MARI_QUEUE_NONE) {
+        return MARI_QUEUE_NONE;
+    }
+    return _unlink_next();
+}
+
+static uint8_t _unlink_next(void) {
+    mari_packet_queue_t *queue = &queue_vars.packet_queue;
+    mr_queue_lane_t     *lane  = &queue->lanes[queue->active[queue->active_first]];
+    uint8_t              index = lane->head;
+
+    lane->deficit = lane->deficit > _packet(index)->length ? lane->deficit - _packet(index)->length : 0;
+    lane->head    = queue->next[index];
+    lane->count--;
+    queue_vars.stats.depth--;
+    if (queue_vars.saturated && queue_vars.stats.depth <= queue_vars.watermark_low) {
+        queue_vars.saturated = false;
+        queue_vars.drained   = true;
+    }
+    if (lane->count == 0) {
+        // an empty lane leaves the round-robin, and does not keep its deficit
+        lane->head    = MARI_QUEUE_NONE;
+        lane->tail    = MARI_QUEUE_NONE;
+        lane->deficit = 0;
+        _remove_first_active();
+    }
+    return index;
+}
+
+static void _append_active(uint8_t lane) {
+    mari_packet_queue_t *queue    = &queue_vars.packet_queue;
+    uint8_t              position = (queue->active_first + queue->active_count) % MARI_QUEUE_N_LANES;
+    queue->active[position]       = lane;
+    queue->active_count++;
+}
+
+static void _remove_first_active(void) {
+    mari_packet_queue_t *queue = &queue_vars.packet_queue;
+    queue->active_first        = (queue->active_first + 1) % MARI_QUEUE_N_LANES;
+    queue->active_count--;
+    queue->round_started = false;
+}
+
+static void _free(uint8_t index) {
+    queue_vars.packet_queue.next[index] = queue_vars.packet_queue.free;
+    queue_vars.packet_queue.free        = index;
+#if MARI_QUEUE_BYTE_RING
+    queue_vars.packet_queue.ring[queue_vars.packet_queue.offsets[index]] = MARI_QUEUE_CHUNK_FREE;
+    _ring_reclaim();
+#endif
+}
+
+static mr_packet_t *_packet(uint8_t index) {
+#if MARI_QUEUE_BYTE_RING
+    return (mr_packet_t *)&queue_vars.packet_queue.ring[queue_vars.packet_queue.offsets[index] + 1];
+#else
+    return &queue_vars.packet_queue.packets[index];
+#endif
+}
+
+#if MARI_QUEUE_BYTE_RING
+static bool _ring_alloc(uint8_t index) {
+    mari_packet_queue_t *queue = &queue_vars.packet_queue;
+
+    if (queue->ring_used == 0) {
+        // an empty ring starts over, to have as much room as possible in one piece
+        queue->ring_head = 0;
+        queue->ring_tail = 0;
+    }
+
+    if (queue->ring_head >= queue->ring_tail && queue->ring_used < MARI_QUEUE_RING_SIZE) {
+        // the room is from the head to the end of the ring, then from the beginning to the tail
+        if (MARI_QUEUE_RING_SIZE - queue->ring_head < MARI_QUEUE_CHUNK_MAX) {
+            if (queue->ring_tail < MARI_QUEUE_CHUNK_MAX) {
+                return false;
+            }
+            // skip the end of the ring
+            queue->ring[queue->ring_head] = MARI_QUEUE_CHUNK_SKIP;
+            queue->ring_used += MARI_QUEUE_RING_SIZE - queue->ring_head;
+            queue->ring_head = 0;
+        }
+    } else if (queue->ring_tail - queue->ring_head < MARI_QUEUE_CHUNK_MAX) {
+        // the room is from the head to the tail
+        return false;
+    }
+
+    queue->offsets[index]         = queue->ring_head;
+    queue->ring[queue->ring_head] = MARI_QUEUE_CHUNK_USED;
+    queue->ring_used += MARI_QUEUE_CHUNK_MAX;
+    queue->ring_head = (queue->ring_head + MARI_QUEUE_CHUNK_MAX) % MARI_QUEUE_RING_SIZE;
+    return true;
+}
+
+static void _ring_shrink(uint8_t index) {
+    mari_packet_queue_t *queue = &queue_vars.packet_queue;
+    uint16_t             len   = MARI_QUEUE_CHUNK_HEADER_LEN + _packet(index)->length;
+    uint16_t             end   = queue->offsets[index] + len;
+    uint16_t             rest  = MARI_QUEUE_CHUNK_MAX - len;
+
+    if ((queue->offsets[index] + MARI_QUEUE_CHUNK_MAX) % MARI_QUEUE_RING_SIZE == queue->ring_head) {
+        // the chunk is the last one reserved, so it ends at the head
+        queue->ring_used -= rest;
+        queue->ring_head = end % MARI_QUEUE_RING_SIZE;
+        return;
+    }
+
+    // mr_queue_add reserved other chunks meanwhile: the rest of the chunk stays in the ring, as freed space
+    if (rest >= MARI_QUEUE_CHUNK_HEADER_LEN) {
+        queue->ring[end]                               = MARI_QUEUE_CHUNK_FREE;
+        ((mr_packet_t *)&queue->ring[end + 1])->length = rest - MARI_QUEUE_CHUNK_HEADER_LEN;
+    } else {
+        memset(&queue->ring[end], MARI_QUEUE_CHUNK_PAD, rest);
+    }
+}
+
+static void _ring_reclaim(void) {
+    mari_packet_queue_t *queue = &queue_vars.packet_queue;
+
+    while (queue->ring_used > 0) {
+        uint16_t len;
+        switch (queue->ring[queue->ring_tail]) {
+            case MARI_QUEUE_CHUNK_FREE:
+                len = MARI_QUEUE_CHUNK_HEADER_LEN + ((mr_packet_t *)&queue->ring[queue->ring_tail + 1])->length;
+                break;
+            case MARI_QUEUE_CHUNK_SKIP:
+                len = MARI_QUEUE_RING_SIZE - queue->ring_tail;
+                break;
+            case MARI_QUEUE_CHUNK_PAD:
+                len = 1;
+                break;
+            default:
+                // the oldest chunk is still used
+                return;
+        }
+        queue->ring_used -= len;
+        queue->ring_tail = (queue->ring_tail + len) % MARI_QUEUE_RING_SIZE;
+    }
+}
+#endif
+
+static bool _is_aggregatable(const mr_packet_t *queued) {
+    const mr_packet_header_t *header = (const mr_packet_header_t *)queued->buffer;
+    // broadcast packets are received by all the nodes anyway
+    return queued->length >= sizeof(mr_packet_header_t) && header->type == MARI_PACKET_DATA && header->dst != MARI_BROADCAST_ADDRESS;
+}
+
+static size_t _aggregated_len(const mr_packet_t *queued) {
+    return sizeof(mr_aggregated_header_t) + queued->length - sizeof(mr_packet_header_t);
+}
+
+static size_t _append_aggregated(uint8_t *packet, size_t len, const mr_packet_t *queued) {
+    const mr_packet_header_t *header = (const mr_packet_header_t *)queued->buffer;
+    return mr_append_packet_aggregated(packet, len, header->dst, queued->buffer + sizeof(mr_packet_header_t), queued->length - sizeof(mr_packet_header_t));
+}
+
+static void _emit_watermark_event(mr_event_t event) {
+    if (queue_vars.event_callback) {
+        queue_vars.event_callback(event, (mr_event_data_t){ .data.queue_info.depth = queue_vars.stats.depth });
+    }
+}
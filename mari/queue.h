@@ -14,26 +14,115 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 
 #include "models.h"
 
 //=========================== defines =========================================
 
-#define MARI_PACKET_QUEUE_SIZE (32)  // must be a power of 2
+#ifndef MARI_QUEUE_BYTE_RING
+#define MARI_QUEUE_BYTE_RING 0  // whether packets are stored back to back in a byte ring, rather than in slots of MARI_PACKET_MAX_SIZE bytes
+#endif
+
+#if MARI_QUEUE_BYTE_RING
+#define MARI_PACKET_QUEUE_SIZE      (64)    // packets shared by all the lanes, at most 255
+#define MARI_QUEUE_RING_SIZE        (2048)  // bytes of the ring, each packet takes its length + MARI_QUEUE_CHUNK_HEADER_LEN
+#define MARI_QUEUE_CHUNK_HEADER_LEN (3)     // state of the chunk, then the pdu_header and length of mr_packet_t
+#else
+#define MARI_PACKET_QUEUE_SIZE (32)  // packets shared by all the lanes, at most 255
+#endif
 
 #define MARI_AUTO_UPLINK_KEEPALIVE 1  // whether to send a keepalive packet when there is nothing to send
+#define MARI_DOWNLINK_AGGREGATION  1  // whether the gateway packs queued data packets for different nodes into one downlink packet
+#define MARI_QUEUE_MAX_RETRIES     3  // times a unicast packet that was not acknowledged is sent again, see MARI_ENABLE_ACK
+#define MARI_UPLINK_BITMAP_RETRY   1  // whether a node sends an uplink data packet again when the beacons of its gateway do not list it as received
+
+// on the gateway, each node has its own lane, indexed by the uplink index of its cell, which a schedule switch keeps,
+// and the lanes are served with deficit round-robin
+// broadcast packets go to the shared lane, which is also the only lane used by nodes
+#define MARI_QUEUE_N_LANES     (MARI_N_CELLS_MAX + 1)
+#define MARI_QUEUE_SHARED_LANE (MARI_N_CELLS_MAX)
+#define MARI_QUEUE_LANE_MAX    (MARI_PACKET_QUEUE_SIZE / 2)  // packets a lane of the gateway can hold, so that a burst to one node leaves room for the others
+#define MARI_QUEUE_DRR_QUANTUM (MARI_PACKET_MAX_SIZE)        // bytes a lane can send per round, at least one packet
+#define MARI_QUEUE_NONE        (0xFF)                        // no packet, or no lane
+
+// default depths at which MARI_QUEUE_HIGH and MARI_QUEUE_LOW are emitted, see mari_set_queue_watermarks
+#define MARI_QUEUE_WATERMARK_HIGH (MARI_PACKET_QUEUE_SIZE * 3 / 4)
+#define MARI_QUEUE_WATERMARK_LOW  (MARI_PACKET_QUEUE_SIZE / 4)
+
+// laid out as a radio PDU, so that the radio can send a packet from where it is queued (see mr_radio_tx_prepare_pdu)
+typedef struct {
+    uint8_t pdu_header;  ///< Header of the radio PDU, always 0
+    uint8_t length;
+    uint8_t buffer[MARI_PACKET_MAX_SIZE];
+} mr_packet_t;
+
+typedef struct {
+    uint8_t  head;     ///< First packet of the lane, MARI_QUEUE_NONE when empty
+    uint8_t  tail;     ///< Last packet of the lane
+    uint8_t  count;    ///< Number of packets in the lane
+    uint16_t deficit;  ///< Bytes the lane can still send in the current round
+} mr_queue_lane_t;
+
+typedef struct {
+#if MARI_QUEUE_BYTE_RING
+    uint8_t  ring[MARI_QUEUE_RING_SIZE];        ///< Packets, back to back, in the order they were reserved, see queue.c
+    uint16_t offsets[MARI_PACKET_QUEUE_SIZE];  ///< Where the chunk of each packet starts in the ring
+    uint16_t ring_head;                        ///< Where the next chunk goes
+    uint16_t ring_tail;                        ///< Oldest chunk that is not freed yet
+    uint16_t ring_used;                        ///< Bytes from ring_tail to ring_head, including the end of the ring when skipped
+#else
+    mr_packet_t packets[MARI_PACKET_QUEUE_SIZE];
+#endif
+    uint8_t         next[MARI_PACKET_QUEUE_SIZE];     ///< Next packet in the same lane, or in the free list
+    uint8_t         free;                             ///< First packet of the free list
+    mr_queue_lane_t lanes[MARI_QUEUE_N_LANES];
+    uint8_t         active[MARI_QUEUE_N_LANES];       ///< Lanes that have packets, in round-robin order
+    uint8_t         active_first;                     ///< Position in `active` of the lane being served
+    uint8_t         active_count;
+    bool            round_started;                    ///< Whether the lane being served got its quantum for this round
+    uint8_t         reserved;                         ///< Packet being built by the application, between mr_queue_reserve and mr_queue_commit
+    uint8_t         in_flight;                        ///< Packet being sent by the radio, freed when the next packet is requested
+    bool            in_flight_done;                   ///< Whether the packet being sent was acknowledged, or is not to be sent again
+    uint8_t         retries[MARI_PACKET_QUEUE_SIZE];  ///< Times each packet was sent again
+} mari_packet_queue_t;
+
+typedef struct {
+    mari_packet_queue_t packet_queue;
+    atomic_flag         lock;            ///< Taken by the application to update the queue, and tried by the MAC, which gives up if it is taken
+    mr_queue_stats_t    stats;
+    uint8_t             watermark_high;  ///< Depth at which MARI_QUEUE_HIGH is emitted
+    uint8_t             watermark_low;   ///< Depth at which MARI_QUEUE_LOW is emitted, once saturated
+    bool                saturated;       ///< Whether the depth reached watermark_high, and did not go back to watermark_low yet
+    bool                drained;         ///< Whether the MAC has a MARI_QUEUE_LOW to emit, once it released the lock
+    bool                reset_pending;   ///< Whether the MAC asked for a reset while the lock was held, done when it is released
+    mr_event_cb_t       event_callback;
+    mr_packet_t         join_packet;
+    mr_packet_t         tx_packet;       ///< Packets built by the MAC itself: beacons, keepalives, join and aggregated packets
+} mr_queue_vars_t;
 
 //=========================== prototypes ======================================
 
-void    mr_queue_add(uint8_t *packet, uint8_t length);
-uint8_t mr_queue_next_packet(slot_type_t slot_type, uint8_t *packet);
-uint8_t mr_queue_peek(uint8_t *packet);
-bool    mr_queue_pop(void);
-void    mr_queue_reset(void);
+void               mr_queue_init(mr_event_cb_t event_callback);
+mr_tx_status_t     mr_queue_add(uint8_t *packet, uint8_t length);
+uint8_t           *mr_queue_reserve(void);
+mr_tx_status_t     mr_queue_commit(uint8_t length);
+const mr_packet_t *mr_queue_next_packet(slot_type_t slot_type);
+bool               mr_queue_needs_ack(const mr_packet_t *packet);
+void               mr_queue_in_flight_done(void);
+void               mr_queue_drop_too_long(const mr_packet_t *packet);
+uint8_t            mr_queue_peek(uint8_t *packet);
+bool               mr_queue_pop(void);
+void               mr_queue_reset(void);
+void               mr_queue_get_stats(mr_queue_stats_t *stats);
+void               mr_queue_reset_stats(void);
+uint8_t            mr_queue_depth(void);
+uint8_t            mr_queue_free(void);
+void               mr_queue_set_watermarks(uint8_t high, uint8_t low);
 
 // void mr_queue_set_join_packet(uint64_t node_id, mr_packet_type_t packet_type);
 void mr_queue_set_join_request(uint64_t node_id);
-void mr_queue_set_join_response(uint64_t node_id, uint8_t assigned_cell_id);
+void mr_queue_set_join_response(uint64_t node_id, uint8_t assigned_uplink_index);
 
 bool    mr_queue_has_join_packet(void);
 uint8_t mr_queue_get_join_packet(uint8_t *packet);
@@ -16,14 +16,12 @@
 #include <stdbool.h>
 
 #include "scan.h"
+#include "context.h"
 
 //=========================== variables =======================================
 
-typedef struct {
-    mr_gateway_scan_t scans[MARI_MAX_SCAN_LIST_SIZE];
-} scan_vars_t;
-
-scan_vars_t scan_vars = { 0 };
+// state of the selected mari instance, see context.h
+#define scan_vars (mr_ctx->scan)
 
 //=========================== prototypes ======================================
 
@@ -101,8 +99,8 @@ bool mr_scan_select(mr_channel_info_t *best_channel_info, uint32_t ts_scan_start
             continue;
         }
         // compute average rssi, only including the rssi readings that are not too old
-        int8_t avg_rssi = 0;
-        int8_t n_rssi   = 0;
+        int16_t avg_rssi = 0;  // sum of up to one reading per channel, wider than a reading
+        int8_t  n_rssi   = 0;
         for (size_t j = 0; j < MARI_N_BLE_ADVERTISING_CHANNELS; j++) {
             if (scan_vars.scans[i].channel_info[j].timestamp == 0) {  // no scan info reading here
                 continue;
@@ -146,8 +144,12 @@ inline void _save_rssi(size_t idx, mr_beacon_packet_header_t beacon, int8_t rssi
         .asn                = beacon.asn,
         .src                = beacon.src,
         .remaining_capacity = beacon.remaining_capacity,
-        .active_schedule_id = beacon.active_schedule_id
+        .active_schedule_id = beacon.active_schedule_id,
+        .next_schedule_id   = beacon.next_schedule_id,
+        .switch_countdown   = beacon.switch_countdown,
     };
+    memcpy(scan_beacon.channel_map, beacon.channel_map, MARI_CHANNEL_MAP_BYTES);
+    scan_beacon.channel_map_countdown = beacon.channel_map_countdown;
 
     scan_vars.scans[idx].channel_info[channel_idx].rssi         = rssi;
     scan_vars.scans[idx].channel_info[channel_idx].timestamp    = ts_scan;
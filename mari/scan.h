@@ -37,6 +37,10 @@ typedef struct __attribute__((packed)) {
     uint64_t         src;
     uint8_t          remaining_capacity;
     uint8_t          active_schedule_id;
+    uint8_t          next_schedule_id;
+    uint16_t         switch_countdown;
+    uint8_t          channel_map[MARI_CHANNEL_MAP_BYTES];
+    uint16_t         channel_map_countdown;
 } mr_beacon_scan_header_t;
 
 typedef struct {
@@ -51,6 +55,10 @@ typedef struct {
     mr_channel_info_t channel_info[MARI_N_BLE_ADVERTISING_CHANNELS];  // channels 37, 38, 39
 } mr_gateway_scan_t;
 
+typedef struct {
+    mr_gateway_scan_t scans[MARI_MAX_SCAN_LIST_SIZE];
+} mr_scan_vars_t;
+
 //=========================== prototypes ======================================
 
 void mr_scan_add(mr_beacon_packet_header_t beacon, int8_t rssi, uint8_t channel, uint32_t ts_scan, uint64_t asn_scan);
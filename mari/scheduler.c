@@ -19,49 +19,78 @@
 
 #include "scheduler.h"
 #include "bloom.h"
+#include "context.h"
 #include "all_schedules.c"
 #include "association.c"
 
 //=========================== defines ==========================================
 
+// longest frame of each type of cell, when not set by the schedule
+#define MARI_DEFAULT_BEACON_FRAME_LEN        (MARI_BEACON_MAX_LEN)
+#define MARI_DEFAULT_SHARED_UPLINK_FRAME_LEN (sizeof(mr_packet_header_t))  // only join requests are sent there
+#define MARI_DEFAULT_FRAME_LEN               (MARI_PACKET_MAX_SIZE)
+
+#define MARI_ALL_CHANNELS (((uint64_t)1 << MARI_N_BLE_REGULAR_CHANNELS) - 1)  // channel map with every data channel
+
 //=========================== variables ========================================
 
-typedef struct {
-    // counters and indexes
-    schedule_t *active_schedule_ptr;  // pointer to the currently active schedule
-    uint32_t    slotframe_counter;    // used to cycle beacon channels through slotframes (when listening for beacons at uplink slot_durations)
+// state of the selected mari instance, see context.h
+#define _schedule_vars  (mr_ctx->scheduler)
+#define _schedule_stats (mr_ctx->scheduler_stats)
 
-    uint8_t num_assigned_uplink_nodes;  // number of nodes with assigned uplink slots
+//========================== prototypes ========================================
 
-    size_t current_cell_index;  // index of the current cell
+// compute the radio action when the node is a gateway
+mr_radio_action_t _compute_gateway_action(cell_t cell);
 
-    // static data
-    schedule_t *available_schedules[MARI_N_SCHEDULES];
-    size_t      available_schedules_len;
-} schedule_vars_t;
+// compute the radio action when the node is an end device
+mr_radio_action_t _compute_node_action(cell_t cell, const mr_cell_assignment_t *assignment);
 
-typedef struct {
-    uint64_t sched_usage[MARI_STATS_SCHED_USAGE_SIZE];
-} schedule_stats_t;
+// fill the slot table from the active schedule, for the current node type
+void _build_slot_table(void);
 
-static schedule_vars_t _schedule_vars = { 0 };
+// find where an ASN falls, incrementally from the position of the next tick when possible
+mr_slot_position_t _get_position(uint64_t asn);
 
-static schedule_stats_t _schedule_stats = { 0 };
+// channel used at a given position in a given slot
+uint8_t _get_channel(const mr_slot_position_t *position, const mr_slot_entry_t *slot);
 
-//========================== prototypes ========================================
+// hash of a node id into the node index
+size_t _node_index_hash(uint64_t node_id);
 
-// compute the radio action when the node is a gateway
-void _compute_gateway_action(cell_t cell, mr_slot_info_t *slot_info);
+// add an assigned cell to the node index
+void _node_index_add(size_t cell_index);
 
-// compute the radio action when the node is an end device
-void _compute_node_action(cell_t cell, mr_slot_info_t *slot_info);
+// remove an assigned cell from the node index, before its node id is cleared
+void _node_index_remove(size_t cell_index);
+
+// find an available schedule by its id, NULL if none
+const schedule_t *_find_schedule(uint8_t schedule_id);
+
+// uplink cells that can be assigned: those of the active schedule, and of the pending one
+uint8_t _assignable_uplinks(void);
+
+// move to the pending schedule, keeping each node at its uplink index
+void _switch_schedule(void);
+
+// gateway only: announce a switch when the nodes fit a shorter schedule, or no longer fit the active one
+void _gateway_plan_switch(uint64_t asn);
+
+// leave a set of data channels out of the hopping sequence
+void _set_unused_channels(uint64_t unused_channels);
+
+// gateway only: once enough uplink cells were sampled, announce a map without the channels on which they fail
+void _gateway_plan_channel_map(uint64_t asn);
+
+// forget the per-channel outcomes of the uplink cells
+void _reset_channel_stats(void);
 
 // encode the schedule usage stats
 void _encode_schedule_usage_stats(uint8_t cell_index, uint8_t radio_action);
 
 //=========================== public ===========================================
 
-void mr_scheduler_init(schedule_t *application_schedule) {
+void mr_scheduler_init(const schedule_t *application_schedule) {
 
     if (_schedule_vars.available_schedules_len == MARI_N_SCHEDULES)
         return;  // FIXME: this is just to simplify debugging (allows calling init multiple times)
@@ -77,68 +106,151 @@ void mr_scheduler_init(schedule_t *application_schedule) {
     if (application_schedule != NULL) {
         _schedule_vars.available_schedules[_schedule_vars.available_schedules_len++] = application_schedule;
         _schedule_vars.active_schedule_ptr                                           = application_schedule;
+        _build_slot_table();
     }
 }
 
 bool mr_scheduler_set_schedule(uint8_t schedule_id) {
-    for (size_t i = 0; i < MARI_N_SCHEDULES; i++) {
-        if (_schedule_vars.available_schedules[i]->id == schedule_id) {
-            _schedule_vars.active_schedule_ptr = _schedule_vars.available_schedules[i];
-            return true;
-        }
+    const schedule_t *schedule = _find_schedule(schedule_id);
+    if (schedule == NULL) {
+        return false;
+    }
+    // a switch announced by the previous gateway does not apply anymore, nor does its channel map
+    _schedule_vars.pending_schedule_ptr = NULL;
+    _schedule_vars.sparse_slotframes    = 0;
+    _schedule_vars.channel_map_pending  = false;
+    _set_unused_channels(0);
+    if (_schedule_vars.active_schedule_ptr != schedule) {
+        // assignments refer to cells of the previous schedule
+        memset(_schedule_vars.assignments, 0, sizeof(_schedule_vars.assignments));
+        memset(_schedule_vars.node_index, 0, sizeof(_schedule_vars.node_index));
+        _schedule_vars.node_cell = 0;
+        mr_bloom_gateway_init();
+        _schedule_vars.num_assigned_uplink_nodes = 0;
+        _schedule_vars.active_schedule_ptr       = schedule;
+        _build_slot_table();
     }
-    return false;
+    return true;
 }
 
 uint32_t mr_scheduler_get_duration_us(void) {
-    return MARI_WHOLE_SLOT_DURATION * _schedule_vars.active_schedule_ptr->n_cells;
+    return _schedule_vars.slotframe_duration_us;
+}
+
+uint32_t mr_scheduler_get_slot_duration_us(uint64_t asn) {
+    return _schedule_vars.slots[asn % _schedule_vars.active_schedule_ptr->n_cells].duration_us;
+}
+
+uint8_t mr_scheduler_get_max_frame_len(slot_type_t slot_type) {
+    const mr_frame_lengths_t *max_frame_len = &_schedule_vars.active_schedule_ptr->max_frame_len;
+
+    switch (slot_type) {
+        case SLOT_TYPE_BEACON:
+            return max_frame_len->beacon ? max_frame_len->beacon : MARI_DEFAULT_BEACON_FRAME_LEN;
+        case SLOT_TYPE_SHARED_UPLINK:
+            return max_frame_len->shared_uplink ? max_frame_len->shared_uplink : MARI_DEFAULT_SHARED_UPLINK_FRAME_LEN;
+        case SLOT_TYPE_DOWNLINK:
+            return max_frame_len->downlink ? max_frame_len->downlink : MARI_DEFAULT_FRAME_LEN;
+        case SLOT_TYPE_UPLINK:
+            return max_frame_len->uplink ? max_frame_len->uplink : MARI_DEFAULT_FRAME_LEN;
+        default:
+            return MARI_DEFAULT_FRAME_LEN;
+    }
 }
 
 // ------------ node functions ------------
 
 // to be called at the NODE when processing a JOIN_RESPONSE
-bool mr_scheduler_node_assign_myself_to_cell(uint16_t cell_index) {
-    for (size_t i = 0; i < _schedule_vars.active_schedule_ptr->n_cells; i++) {
-        cell_t *cell = &_schedule_vars.active_schedule_ptr->cells[i];
-        if (cell->type == SLOT_TYPE_UPLINK && i == cell_index) {
-            cell->assigned_node_id = mr_device_id();
-            return true;
-        }
+bool mr_scheduler_node_assign_myself_to_uplink(uint8_t uplink_index) {
+    if (uplink_index >= _schedule_vars.active_schedule_ptr->max_nodes) {
+        return false;
     }
-    return false;
+    size_t i                                       = _schedule_vars.uplink_cells[uplink_index];
+    _schedule_vars.assignments[i].assigned_node_id = mr_device_id();
+    _schedule_vars.slots[i].radio_action           = MARI_RADIO_ACTION_TX;
+    _schedule_vars.node_cell                       = i + 1;
+    return true;
 }
 
 void mr_scheduler_node_deassign_myself_from_schedule(void) {
     for (size_t i = 0; i < _schedule_vars.active_schedule_ptr->n_cells; i++) {
-        cell_t *cell = &_schedule_vars.active_schedule_ptr->cells[i];
-        if (cell->type == SLOT_TYPE_UPLINK && cell->assigned_node_id == mr_device_id()) {
-            cell->assigned_node_id  = NULL;
-            cell->last_received_asn = 0;
+        mr_cell_assignment_t *assignment = &_schedule_vars.assignments[i];
+        if (assignment->assigned_node_id == mr_device_id()) {
+            assignment->assigned_node_id         = 0;
+            assignment->last_received_asn        = 0;
+            _schedule_vars.slots[i].radio_action = MARI_RADIO_ACTION_SLEEP;
         }
     }
+    _schedule_vars.node_cell = 0;
+}
+
+int16_t mr_scheduler_node_get_uplink_index(void) {
+    if (_schedule_vars.node_cell == 0) {
+        return -1;
+    }
+    return _schedule_vars.slots[_schedule_vars.node_cell - 1].uplink_index;
+}
+
+bool mr_scheduler_node_set_pending_switch(uint8_t schedule_id, uint64_t switch_asn) {
+    const schedule_t *schedule = _find_schedule(schedule_id);
+    if (schedule == NULL) {
+        return false;
+    }
+    if (schedule != _schedule_vars.active_schedule_ptr) {
+        _schedule_vars.pending_schedule_ptr = schedule;
+        _schedule_vars.switch_asn           = switch_asn;
+    }
+    return true;
+}
+
+void mr_scheduler_node_set_channel_map(const uint8_t *channel_map, uint64_t map_asn) {
+    // little-endian, as the rest of the packets
+    uint64_t used_channels = 0;
+    memcpy(&used_channels, channel_map, MARI_CHANNEL_MAP_BYTES);
+    uint64_t unused_channels = ~used_channels & MARI_ALL_CHANNELS;
+    if (unused_channels == _schedule_vars.unused_channels) {
+        // already in use, e.g. announced by the beacons heard before the change
+        _schedule_vars.channel_map_pending = false;
+        return;
+    }
+    _schedule_vars.pending_unused_channels = unused_channels;
+    _schedule_vars.channel_map_asn         = map_asn;
+    _schedule_vars.channel_map_pending     = true;
 }
 
 // ------------ gateway functions ---------
 
 // to be called at the GATEWAY when processing a JOIN_REQUEST
 int16_t mr_scheduler_gateway_assign_next_available_uplink_cell(uint64_t node_id, uint64_t asn) {
+    int16_t cell_index = mr_scheduler_gateway_get_node_cell(node_id);
+    if (cell_index >= 0) {
+        // the node re-connected before the gateway could detect it was gone,
+        // probably because of a collision on the join response (donwlink)
+        // so we can just keep the same cell_id, but we still need to update the last_received_asn
+        _schedule_vars.assignments[cell_index].last_received_asn = asn;
+        return cell_index;
+    }
+
+    // while a switch to a smaller schedule is pending, only the cells that it keeps are assigned
+    uint8_t n_uplinks = _assignable_uplinks();
     for (size_t i = 0; i < _schedule_vars.active_schedule_ptr->n_cells; i++) {
-        cell_t *cell = &_schedule_vars.active_schedule_ptr->cells[i];
-        if (cell->type == SLOT_TYPE_UPLINK && cell->assigned_node_id == 0) {
+        const cell_t         *cell       = &_schedule_vars.active_schedule_ptr->cells[i];
+        mr_cell_assignment_t *assignment = &_schedule_vars.assignments[i];
+        if (cell->type == SLOT_TYPE_UPLINK && _schedule_vars.slots[i].uplink_index >= n_uplinks) {
+            break;
+        }
+        if (cell->type == SLOT_TYPE_UPLINK && assignment->assigned_node_id == 0) {
             // the cell is available, so we can assign it to the node
-            cell->assigned_node_id  = node_id;
-            cell->last_received_asn = asn;
+            assignment->assigned_node_id  = node_id;
+            assignment->last_received_asn = asn;
+            assignment->bulk_done         = false;
             // pre-compute the bloom filter hashes
-            cell->bloom_h1 = mr_bloom_hash_fnv1a64(node_id);
-            cell->bloom_h2 = mr_bloom_hash_fnv1a64(node_id ^ MARI_BLOOM_FNV1A_H2_SALT);
+            assignment->bloom_h1 = mr_bloom_hash_fnv1a64(node_id);
+            assignment->bloom_h2 = mr_bloom_hash_fnv1a64(node_id ^ MARI_BLOOM_FNV1A_H2_SALT);
+            _node_index_add(i);
+            mr_bloom_gateway_add(assignment->bloom_h1, assignment->bloom_h2, _schedule_vars.slots[i].uplink_index);
             _schedule_vars.num_assigned_uplink_nodes++;
             return i;
-        } else if (cell->type == SLOT_TYPE_UPLINK && cell->assigned_node_id == node_id) {
-            // the node re-connected before the gateway could detect it was gone,
-            // probably because of a collision on the join response (donwlink)
-            // so we can just keep the same cell_id, but we still need to update the last_received_asn
-            cell->last_received_asn = asn;
-            return i;
         }
     }
     return -1;
@@ -149,9 +261,54 @@ inline void mr_scheduler_gateway_decrease_nodes_counter(void) {
     _schedule_vars.num_assigned_uplink_nodes--;
 }
 
+int16_t mr_scheduler_gateway_get_node_uplink_index(uint64_t node_id) {
+    int16_t cell_index = mr_scheduler_gateway_get_node_cell(node_id);
+    return cell_index >= 0 ? _schedule_vars.slots[cell_index].uplink_index : -1;
+}
+
+uint64_t mr_scheduler_gateway_get_uplink_node(uint8_t uplink_index) {
+    if (uplink_index >= _schedule_vars.active_schedule_ptr->max_nodes) {
+        return 0;
+    }
+    return _schedule_vars.assignments[_schedule_vars.uplink_cells[uplink_index]].assigned_node_id;
+}
+
+uint8_t mr_scheduler_get_uplink_index(size_t cell_index) {
+    return _schedule_vars.slots[cell_index].uplink_index;
+}
+
+int16_t mr_scheduler_gateway_get_node_cell(uint64_t node_id) {
+    if (node_id == 0) {
+        return -1;
+    }
+    // linear probing: the node is either found, or an empty entry ends the search
+    for (size_t i = _node_index_hash(node_id);; i = (i + 1) & (MARI_NODE_INDEX_SIZE - 1)) {
+        uint8_t entry = _schedule_vars.node_index[i];
+        if (entry == 0) {
+            return -1;
+        }
+        if (_schedule_vars.assignments[entry - 1].assigned_node_id == node_id) {
+            return entry - 1;
+        }
+    }
+}
+
+void mr_scheduler_gateway_deassign_cell(size_t cell_index) {
+    mr_cell_assignment_t *assignment = &_schedule_vars.assignments[cell_index];
+    if (assignment->assigned_node_id == 0) {
+        return;
+    }
+    _node_index_remove(cell_index);
+    mr_bloom_gateway_remove(assignment->bloom_h1, assignment->bloom_h2, _schedule_vars.slots[cell_index].uplink_index);
+    assignment->assigned_node_id  = 0;
+    assignment->last_received_asn = 0;
+    mr_scheduler_gateway_decrease_nodes_counter();
+}
+
 // to be called at the GATEWAY to build a beacon
 uint8_t mr_scheduler_gateway_remaining_capacity(void) {
-    return _schedule_vars.active_schedule_ptr->max_nodes - _schedule_vars.num_assigned_uplink_nodes;
+    uint8_t n_uplinks = _assignable_uplinks();
+    return n_uplinks > _schedule_vars.num_assigned_uplink_nodes ? n_uplinks - _schedule_vars.num_assigned_uplink_nodes : 0;
 }
 
 // to be called at the GATEWAY to build a beacon
@@ -162,9 +319,9 @@ uint8_t mr_scheduler_gateway_get_nodes_count(void) {
 uint8_t mr_scheduler_gateway_get_nodes(uint64_t *nodes) {
     uint8_t count = 0;
     for (size_t i = 0; i < _schedule_vars.active_schedule_ptr->n_cells; i++) {
-        cell_t *cell = &_schedule_vars.active_schedule_ptr->cells[i];
-        if (cell->type == SLOT_TYPE_UPLINK && cell->assigned_node_id != NULL) {
-            nodes[count++] = cell->assigned_node_id;
+        const cell_t *cell = &_schedule_vars.active_schedule_ptr->cells[i];
+        if (cell->type == SLOT_TYPE_UPLINK && _schedule_vars.assignments[i].assigned_node_id != 0) {
+            nodes[count++] = _schedule_vars.assignments[i].assigned_node_id;
         }
     }
     return count;
@@ -173,29 +330,62 @@ uint8_t mr_scheduler_gateway_get_nodes(uint64_t *nodes) {
 // ------------ general functions ---------
 
 mr_slot_info_t mr_scheduler_tick(uint64_t asn) {
+    if (_schedule_vars.pending_schedule_ptr != NULL && asn >= _schedule_vars.switch_asn) {
+        // the gateway and its nodes switch at the same slot
+        _switch_schedule();
+    }
+    if (_schedule_vars.channel_map_pending && asn >= _schedule_vars.channel_map_asn) {
+        // same for the channel map
+        _set_unused_channels(_schedule_vars.pending_unused_channels);
+        _schedule_vars.channel_map_pending = false;
+        _reset_channel_stats();
+    }
+
     // get the current cell
-    _schedule_vars.current_cell_index = asn % (_schedule_vars.active_schedule_ptr)->n_cells;
-    cell_t cell                       = (_schedule_vars.active_schedule_ptr)->cells[_schedule_vars.current_cell_index];
+    mr_slot_position_t     position = _get_position(asn);
+    const mr_slot_entry_t *slot     = &_schedule_vars.slots[position.cell_index];
+
+    _schedule_vars.current_cell_index = position.cell_index;
 
     mr_slot_info_t slot_info = {
-        .radio_action = MARI_RADIO_ACTION_SLEEP,
-        .channel      = mr_scheduler_get_channel(cell.type, asn, cell.channel_offset),
-        .type         = cell.type,  // FIXME: only for debugging, remove before merge
+        .radio_action  = slot->radio_action,
+        .channel       = _get_channel(&position, slot),
+        .type          = slot->type,  // FIXME: only for debugging, remove before merge
+        .max_frame_len = slot->max_frame_len,
+        .duration_us   = slot->duration_us,
     };
-    if (mari_get_node_type() == MARI_GATEWAY) {
-        _compute_gateway_action(cell, &slot_info);
-    } else {
-        _compute_node_action(cell, &slot_info);
-        if (cell.type == SLOT_TYPE_SHARED_UPLINK) {
-            mr_assoc_node_tick_backoff();
-        }
+    if (mari_get_node_type() == MARI_NODE && slot->type == SLOT_TYPE_SHARED_UPLINK) {
+        mr_assoc_node_tick_backoff();
     }
 
+    // prepare the position of the next tick
+    uint16_t n_cells = (_schedule_vars.active_schedule_ptr)->n_cells;
+
+    _schedule_vars.next_position.asn            = asn + 1;
+    _schedule_vars.next_position.cell_index     = position.cell_index + 1 == n_cells ? 0 : position.cell_index + 1;
+    _schedule_vars.next_position.channel        = position.channel + 1 == MARI_N_BLE_REGULAR_CHANNELS ? 0 : position.channel + 1;
+    _schedule_vars.next_position.beacon_channel = position.beacon_channel + 1 == MARI_N_BLE_ADVERTISING_CHANNELS ? 0 : position.beacon_channel + 1;
+    _schedule_vars.next_position_valid          = true;
+
     // if the slotframe wrapped, keep track of how many slotframes have passed (used to cycle beacon channels)
     if (asn != 0 && _schedule_vars.current_cell_index == 0) {
         _schedule_vars.slotframe_counter++;
     }
 
+    if (mari_get_node_type() == MARI_GATEWAY && position.cell_index == 0) {
+        // the beacons of this slotframe tell the nodes which uplink frames of the previous one were received
+        memcpy(_schedule_stats.uplink_received_previous, _schedule_stats.uplink_received, MARI_UPLINK_BITMAP_BYTES);
+        memset(_schedule_stats.uplink_received, 0, MARI_UPLINK_BITMAP_BYTES);
+    }
+
+    if (MARI_AUTO_SCHEDULE && mari_get_node_type() == MARI_GATEWAY && position.cell_index == 0 && _schedule_vars.pending_schedule_ptr == NULL) {
+        _gateway_plan_switch(asn);
+    }
+
+    if (MARI_CHANNEL_BLACKLISTING && mari_get_node_type() == MARI_GATEWAY && position.cell_index == 0 && !_schedule_vars.channel_map_pending) {
+        _gateway_plan_channel_map(asn);
+    }
+
     return slot_info;
 }
 
@@ -207,7 +397,7 @@ uint8_t mr_scheduler_get_channel(slot_type_t slot_type, uint64_t asn, uint8_t ch
     return MARI_FIXED_CHANNEL;
 #endif
     if (slot_type == SLOT_TYPE_BEACON) {
-#ifdef MARI_FIXED_SCAN_CHANNEL
+#if (MARI_FIXED_SCAN_CHANNEL != 0)
         return MARI_FIXED_SCAN_CHANNEL;
 #else
         // special handling in case the cell is a beacon
@@ -216,11 +406,13 @@ uint8_t mr_scheduler_get_channel(slot_type_t slot_type, uint64_t asn, uint8_t ch
     } else {
         // As per RFC 7554:
         //   frequency = F {(ASN + channelOffset) mod nFreq}
-        return (asn + channel_offset) % MARI_N_BLE_REGULAR_CHANNELS;
+        // with the unused channels mapped to used ones, as BLE does
+        uint8_t channel = (asn + channel_offset) % MARI_N_BLE_REGULAR_CHANNELS;
+        return _schedule_vars.unused_channels >> channel & 1 ? _schedule_vars.channel_remap[channel] : channel;
     }
 }
 
-schedule_t *mr_scheduler_get_active_schedule_ptr(void) {
+const schedule_t *mr_scheduler_get_active_schedule_ptr(void) {
     return _schedule_vars.active_schedule_ptr;
 }
 
@@ -232,11 +424,44 @@ uint8_t mr_scheduler_get_active_schedule_slot_count(void) {
     return _schedule_vars.active_schedule_ptr->n_cells;
 }
 
-cell_t mr_scheduler_node_peek_slot(uint64_t asn) {
-    size_t cell_index = (asn) % (_schedule_vars.active_schedule_ptr)->n_cells;
-    cell_t cell       = (_schedule_vars.active_schedule_ptr)->cells[cell_index];
+uint16_t mr_scheduler_get_pending_switch(uint64_t asn, uint8_t *schedule_id) {
+    if (_schedule_vars.pending_schedule_ptr == NULL || asn >= _schedule_vars.switch_asn) {
+        *schedule_id = _schedule_vars.active_schedule_ptr->id;
+        return 0;
+    }
+    *schedule_id = _schedule_vars.pending_schedule_ptr->id;
+    return _schedule_vars.switch_asn - asn;
+}
 
-    return cell;
+uint16_t mr_scheduler_get_pending_channel_map(uint64_t asn, uint8_t *channel_map) {
+    bool     pending         = _schedule_vars.channel_map_pending && asn < _schedule_vars.channel_map_asn;
+    uint64_t unused_channels = pending ? _schedule_vars.pending_unused_channels : _schedule_vars.unused_channels;
+    uint64_t used_channels   = ~unused_channels & MARI_ALL_CHANNELS;
+    memcpy(channel_map, &used_channels, MARI_CHANNEL_MAP_BYTES);
+    return pending ? _schedule_vars.channel_map_asn - asn : 0;
+}
+
+uint64_t mr_scheduler_get_channel_map(void) {
+    return ~_schedule_vars.unused_channels & MARI_ALL_CHANNELS;
+}
+
+mr_cell_assignment_t *mr_scheduler_get_cell_assignment(size_t cell_index) {
+    return &_schedule_vars.assignments[cell_index];
+}
+
+mr_slot_info_t mr_scheduler_node_peek_slot(uint64_t asn) {
+    mr_slot_position_t     position = _get_position(asn);
+    const mr_slot_entry_t *slot     = &_schedule_vars.slots[position.cell_index];
+
+    mr_slot_info_t slot_info = {
+        .radio_action  = slot->radio_action,
+        .channel       = _get_channel(&position, slot),
+        .type          = slot->type,
+        .max_frame_len = slot->max_frame_len,
+        .duration_us   = slot->duration_us,
+    };
+
+    return slot_info;
 }
 
 void mr_scheduler_stats_register_used_slot(bool used) {
@@ -260,38 +485,371 @@ uint64_t *mr_scheduler_get_schedule_usage(void) {
     return _schedule_stats.sched_usage;
 }
 
+void mr_scheduler_stats_register_uplink_received(uint64_t src) {
+    uint8_t                cell_index = _schedule_vars.current_cell_index;
+    const mr_slot_entry_t *slot       = &_schedule_vars.slots[cell_index];
+    if (slot->type != SLOT_TYPE_UPLINK || _schedule_vars.assignments[cell_index].assigned_node_id != src) {
+        // not sent by the node of the cell, e.g. by a node of another gateway
+        return;
+    }
+    _schedule_stats.uplink_received[slot->uplink_index / 8] |= 1 << (slot->uplink_index % 8);
+}
+
+const uint8_t *mr_scheduler_get_uplink_received(void) {
+    return _schedule_stats.uplink_received_previous;
+}
+
+void mr_scheduler_stats_register_rx(uint8_t channel, mr_rx_outcome_t outcome) {
+    uint8_t cell_index = _schedule_vars.current_cell_index;
+    if (_schedule_vars.slots[cell_index].type != SLOT_TYPE_UPLINK || _schedule_vars.assignments[cell_index].assigned_node_id == 0 || channel >= MARI_N_BLE_REGULAR_CHANNELS) {
+        // nothing is expected in the other cells
+        return;
+    }
+    switch (outcome) {
+        case MARI_RX_OK:
+            _schedule_stats.channel_rx_ok[channel]++;
+            break;
+        case MARI_RX_CRC_ERROR:
+            _schedule_stats.channel_crc_errors[channel]++;
+            break;
+        case MARI_RX_MISSED:
+            _schedule_stats.channel_missed[channel]++;
+            break;
+    }
+    _schedule_stats.channel_samples++;
+}
+
 //=========================== private ==========================================
 
-void _compute_gateway_action(cell_t cell, mr_slot_info_t *slot_info) {
+mr_radio_action_t _compute_gateway_action(cell_t cell) {
     switch (cell.type) {
         case SLOT_TYPE_BEACON:
         case SLOT_TYPE_DOWNLINK:
-            slot_info->radio_action = MARI_RADIO_ACTION_TX;
-            break;
+            return MARI_RADIO_ACTION_TX;
         case SLOT_TYPE_SHARED_UPLINK:
         case SLOT_TYPE_UPLINK:
-            slot_info->radio_action = MARI_RADIO_ACTION_RX;
-            break;
+            return MARI_RADIO_ACTION_RX;
+        default:
+            return MARI_RADIO_ACTION_SLEEP;
     }
 }
 
-void _compute_node_action(cell_t cell, mr_slot_info_t *slot_info) {
+mr_radio_action_t _compute_node_action(cell_t cell, const mr_cell_assignment_t *assignment) {
     switch (cell.type) {
         case SLOT_TYPE_BEACON:
         case SLOT_TYPE_DOWNLINK:
-            slot_info->radio_action = MARI_RADIO_ACTION_RX;
-            break;
+            return MARI_RADIO_ACTION_RX;
         case SLOT_TYPE_SHARED_UPLINK:
-            slot_info->radio_action = MARI_RADIO_ACTION_TX;
-            break;
+            return MARI_RADIO_ACTION_TX;
         case SLOT_TYPE_UPLINK:
-            if (cell.assigned_node_id == mr_device_id()) {
-                slot_info->radio_action = MARI_RADIO_ACTION_TX;
-            } else {
-                slot_info->radio_action = MARI_RADIO_ACTION_SLEEP;
+            if (assignment->assigned_node_id == mr_device_id()) {
+                return MARI_RADIO_ACTION_TX;
             }
-            break;
+            return MARI_RADIO_ACTION_SLEEP;
         default:
+            return MARI_RADIO_ACTION_SLEEP;
+    }
+}
+
+size_t _node_index_hash(uint64_t node_id) {
+    // multiplicative hashing of the folded id, the top bits are the best mixed
+    uint32_t folded = (uint32_t)node_id ^ (uint32_t)(node_id >> 32);
+    return (uint32_t)(folded * 0x9E3779B1UL) >> (32 - MARI_NODE_INDEX_BITS);
+}
+
+void _node_index_add(size_t cell_index) {
+    size_t i = _node_index_hash(_schedule_vars.assignments[cell_index].assigned_node_id);
+    while (_schedule_vars.node_index[i] != 0) {
+        i = (i + 1) & (MARI_NODE_INDEX_SIZE - 1);
+    }
+    _schedule_vars.node_index[i] = cell_index + 1;
+}
+
+void _node_index_remove(size_t cell_index) {
+    size_t i = _node_index_hash(_schedule_vars.assignments[cell_index].assigned_node_id);
+    while (_schedule_vars.node_index[i] != cell_index + 1) {
+        if (_schedule_vars.node_index[i] == 0) {
+            return;  // not indexed
+        }
+        i = (i + 1) & (MARI_NODE_INDEX_SIZE - 1);
+    }
+
+    // shift back the entries that follow, so that no probe sequence is broken (no tombstones needed)
+    for (size_t j = (i + 1) & (MARI_NODE_INDEX_SIZE - 1); _schedule_vars.node_index[j] != 0; j = (j + 1) & (MARI_NODE_INDEX_SIZE - 1)) {
+        size_t home = _node_index_hash(_schedule_vars.assignments[_schedule_vars.node_index[j] - 1].assigned_node_id);
+        // the entry at j can move to i only if its home is not cyclically in (i, j]
+        if (((j - home) & (MARI_NODE_INDEX_SIZE - 1)) >= ((j - i) & (MARI_NODE_INDEX_SIZE - 1))) {
+            _schedule_vars.node_index[i] = _schedule_vars.node_index[j];
+            i                            = j;
+        }
+    }
+    _schedule_vars.node_index[i] = 0;
+}
+
+void _build_slot_table(void) {
+    const schedule_t *schedule = _schedule_vars.active_schedule_ptr;
+    bool              gateway  = mari_get_node_type() == MARI_GATEWAY;
+
+    uint8_t uplink_index                 = 0;
+    _schedule_vars.slotframe_duration_us = 0;
+    for (size_t i = 0; i < schedule->n_cells; i++) {
+        cell_t cell                            = schedule->cells[i];
+        _schedule_vars.slots[i].type           = cell.type;
+        _schedule_vars.slots[i].channel_offset = cell.channel_offset % MARI_N_BLE_REGULAR_CHANNELS;
+        _schedule_vars.slots[i].radio_action   = gateway ? _compute_gateway_action(cell) : _compute_node_action(cell, &_schedule_vars.assignments[i]);
+        _schedule_vars.slots[i].uplink_index   = uplink_index;
+        _schedule_vars.slots[i].max_frame_len  = mr_scheduler_get_max_frame_len(cell.type);
+        // unicast frames are sent in uplink and downlink cells, which also fit their ACK
+        bool unicast                           = cell.type == SLOT_TYPE_UPLINK || cell.type == SLOT_TYPE_DOWNLINK;
+        _schedule_vars.slots[i].duration_us    = unicast ? MARI_ACK_SLOT_DURATION(_schedule_vars.slots[i].max_frame_len) : MARI_SLOT_DURATION(_schedule_vars.slots[i].max_frame_len);
+        _schedule_vars.slotframe_duration_us += _schedule_vars.slots[i].duration_us;
+        if (cell.type == SLOT_TYPE_UPLINK) {
+            _schedule_vars.uplink_cells[uplink_index++] = i;
+        }
+    }
+    // the number of cells changed, the position of the next tick must be computed again
+    _schedule_vars.next_position_valid = false;
+}
+
+const schedule_t *_find_schedule(uint8_t schedule_id) {
+    for (size_t i = 0; i < _schedule_vars.available_schedules_len; i++) {
+        if (_schedule_vars.available_schedules[i]->id == schedule_id) {
+            return _schedule_vars.available_schedules[i];
+        }
+    }
+    return NULL;
+}
+
+uint8_t _assignable_uplinks(void) {
+    const schedule_t *pending = _schedule_vars.pending_schedule_ptr;
+    uint8_t           active  = _schedule_vars.active_schedule_ptr->max_nodes;
+    return pending != NULL && pending->max_nodes < active ? pending->max_nodes : active;
+}
+
+void _switch_schedule(void) {
+    const schedule_t *from = _schedule_vars.active_schedule_ptr;
+    const schedule_t *to   = _schedule_vars.pending_schedule_ptr;
+
+    // gather the assignments by uplink index at the beginning of the table, no uplink index is above its cell index
+    size_t n_uplinks = 0;
+    for (size_t i = 0; i < from->n_cells; i++) {
+        if (from->cells[i].type == SLOT_TYPE_UPLINK) {
+            _schedule_vars.assignments[n_uplinks++] = _schedule_vars.assignments[i];
+        }
+    }
+    // nodes beyond the uplink cells of the new schedule lose their cell, the gateway only switches when there are none
+    if (n_uplinks > to->max_nodes) {
+        n_uplinks = to->max_nodes;
+    }
+    memset(&_schedule_vars.assignments[n_uplinks], 0, (MARI_N_CELLS_MAX - n_uplinks) * sizeof(mr_cell_assignment_t));
+
+    // spread them over the cells of the new schedule, from the end, so that none is overwritten before it is moved
+    size_t uplink_index = to->max_nodes;
+    for (size_t i = to->n_cells; i-- > 0;) {
+        if (to->cells[i].type == SLOT_TYPE_UPLINK) {
+            _schedule_vars.assignments[i] = _schedule_vars.assignments[--uplink_index];
+        } else {
+            memset(&_schedule_vars.assignments[i], 0, sizeof(mr_cell_assignment_t));
+        }
+    }
+
+    _schedule_vars.active_schedule_ptr  = to;
+    _schedule_vars.pending_schedule_ptr = NULL;
+    _schedule_vars.sparse_slotframes    = 0;
+    _build_slot_table();
+
+    // the cells of the nodes moved
+    memset(_schedule_vars.node_index, 0, sizeof(_schedule_vars.node_index));
+    _schedule_vars.node_cell                 = 0;
+    _schedule_vars.num_assigned_uplink_nodes = 0;
+    for (size_t i = 0; i < to->n_cells; i++) {
+        uint64_t node_id = _schedule_vars.assignments[i].assigned_node_id;
+        if (node_id == 0) {
+            continue;
+        }
+        if (mari_get_node_type() == MARI_GATEWAY) {
+            _node_index_add(i);
+            _schedule_vars.num_assigned_uplink_nodes++;
+        } else if (node_id == mr_device_id()) {
+            _schedule_vars.node_cell = i + 1;
+        }
+    }
+    if (mari_get_node_type() == MARI_GATEWAY) {
+        mr_bloom_gateway_compute();
+    }
+}
+
+void _gateway_plan_switch(uint64_t asn) {
+    const schedule_t *active  = _schedule_vars.active_schedule_ptr;
+    uint8_t           n_nodes = _schedule_vars.num_assigned_uplink_nodes;
+
+    // a smaller schedule must have the cells of all the nodes, up to the last assigned one
+    uint8_t n_used = 0;
+    for (size_t i = 0; i < active->n_cells; i++) {
+        if (_schedule_vars.assignments[i].assigned_node_id != 0) {
+            n_used = _schedule_vars.slots[i].uplink_index + 1;
+        }
+    }
+
+    // the shortest schedule with room for the nodes, or else the biggest one
+    const schedule_t *shortest = NULL;
+    const schedule_t *biggest  = active;
+    for (size_t i = 0; i < _schedule_vars.available_schedules_len; i++) {
+        const schedule_t *schedule = _schedule_vars.available_schedules[i];
+        if (schedule->max_nodes >= n_nodes + MARI_AUTO_SCHEDULE_TARGET_FREE && schedule->max_nodes >= n_used && (shortest == NULL || schedule->n_cells < shortest->n_cells)) {
+            shortest = schedule;
+        }
+        if (schedule->max_nodes > biggest->max_nodes) {
+            biggest = schedule;
+        }
+    }
+
+    const schedule_t *next = NULL;
+    if (active->max_nodes < n_nodes + MARI_AUTO_SCHEDULE_MIN_FREE) {
+        // crowded: grow right away, so that nodes can keep joining
+        _schedule_vars.sparse_slotframes = 0;
+        next                             = shortest != NULL && shortest->max_nodes > active->max_nodes ? shortest : biggest;
+    } else if (shortest != NULL && shortest->n_cells < active->n_cells) {
+        // sparse: shrink only if it lasts, nodes often join in bursts
+        if (++_schedule_vars.sparse_slotframes >= MARI_AUTO_SCHEDULE_DOWN_SLOTFRAMES) {
+            next = shortest;
+        }
+    } else {
+        _schedule_vars.sparse_slotframes = 0;
+    }
+    if (next == NULL || next == active) {
+        return;
+    }
+
+    // leave time for the nodes to hear a beacon, and start the new schedule with its first cell
+    uint64_t switch_asn = asn + MARI_SCHEDULE_SWITCH_LEAD_SLOTFRAMES * active->n_cells;
+    switch_asn += (next->n_cells - switch_asn % next->n_cells) % next->n_cells;
+
+    _schedule_vars.pending_schedule_ptr = next;
+    _schedule_vars.switch_asn           = switch_asn;
+}
+
+void _set_unused_channels(uint64_t unused_channels) {
+    uint8_t used[MARI_N_BLE_REGULAR_CHANNELS];
+    uint8_t n_used = 0;
+    for (uint8_t channel = 0; channel < MARI_N_BLE_REGULAR_CHANNELS; channel++) {
+        if (!(unused_channels >> channel & 1)) {
+            used[n_used++] = channel;
+        }
+    }
+    if (n_used == 0) {
+        // not a valid map, keep hopping over all the channels
+        unused_channels = 0;
+    }
+    // as the BLE channel selection algorithm #1: an unused channel is replaced by the used one at its index modulo their number
+    for (uint8_t channel = 0; channel < MARI_N_BLE_REGULAR_CHANNELS; channel++) {
+        _schedule_vars.channel_remap[channel] = unused_channels >> channel & 1 ? used[channel % n_used] : channel;
+    }
+    _schedule_vars.unused_channels = unused_channels;
+}
+
+void _reset_channel_stats(void) {
+    memset(_schedule_stats.channel_rx_ok, 0, sizeof(_schedule_stats.channel_rx_ok));
+    memset(_schedule_stats.channel_crc_errors, 0, sizeof(_schedule_stats.channel_crc_errors));
+    memset(_schedule_stats.channel_missed, 0, sizeof(_schedule_stats.channel_missed));
+    _schedule_stats.channel_samples = 0;
+}
+
+void _gateway_plan_channel_map(uint64_t asn) {
+    uint64_t unused_channels = _schedule_vars.unused_channels;
+    uint8_t  n_used          = 0;
+    for (uint8_t channel = 0; channel < MARI_N_BLE_REGULAR_CHANNELS; channel++) {
+        n_used += !(unused_channels >> channel & 1);
+    }
+    if (_schedule_stats.channel_samples < MARI_CHANNEL_MAP_SAMPLES * n_used) {
+        return;
+    }
+
+    uint32_t total_failed = 0;
+    for (uint8_t channel = 0; channel < MARI_N_BLE_REGULAR_CHANNELS; channel++) {
+        total_failed += _schedule_stats.channel_crc_errors[channel] + _schedule_stats.channel_missed[channel];
+    }
+
+    // the blacklisted channels are tried again after a while, the interference may be gone
+    for (uint8_t channel = 0; channel < MARI_N_BLE_REGULAR_CHANNELS; channel++) {
+        if (unused_channels >> channel & 1 && --_schedule_vars.channel_blacklist_left[channel] == 0) {
+            unused_channels &= ~((uint64_t)1 << channel);
+            n_used++;
+        }
+    }
+
+    // blacklist the bad channels, the worst first, while enough channels are left
+    while (n_used > MARI_CHANNEL_MAP_MIN_USED) {
+        uint8_t  worst        = MARI_N_BLE_REGULAR_CHANNELS;
+        uint32_t worst_failed = 0;
+        uint32_t worst_n      = 1;
+        for (uint8_t channel = 0; channel < MARI_N_BLE_REGULAR_CHANNELS; channel++) {
+            uint32_t failed = _schedule_stats.channel_crc_errors[channel] + _schedule_stats.channel_missed[channel];
+            uint32_t n      = _schedule_stats.channel_rx_ok[channel] + failed;
+            if (unused_channels >> channel & 1 || n < MARI_CHANNEL_MAP_SAMPLES / 2) {
+                continue;
+            }
+            // compared to all the channels, so that nodes that stopped sending do not make every channel look bad
+            bool bad = failed * 100 >= MARI_CHANNEL_BAD_PERCENT * n && failed * _schedule_stats.channel_samples >= 2 * total_failed * n;
+            if (bad && failed * worst_n > worst_failed * n) {
+                worst        = channel;
+                worst_failed = failed;
+                worst_n      = n;
+            }
+        }
+        if (worst == MARI_N_BLE_REGULAR_CHANNELS) {
             break;
+        }
+        unused_channels |= (uint64_t)1 << worst;
+        _schedule_vars.channel_blacklist_left[worst] = MARI_CHANNEL_BLACKLIST_EVALUATIONS;
+        n_used--;
+    }
+    _reset_channel_stats();
+
+    if (unused_channels == _schedule_vars.unused_channels) {
+        return;
+    }
+    // leave time for the nodes to hear a beacon, as for a schedule switch
+    _schedule_vars.pending_unused_channels = unused_channels;
+    _schedule_vars.channel_map_asn         = asn + MARI_SCHEDULE_SWITCH_LEAD_SLOTFRAMES * _schedule_vars.active_schedule_ptr->n_cells;
+    _schedule_vars.channel_map_pending     = true;
+}
+
+mr_slot_position_t _get_position(uint64_t asn) {
+    mr_slot_position_t position = _schedule_vars.next_position;
+    uint16_t           n_cells  = (_schedule_vars.active_schedule_ptr)->n_cells;
+
+    if (_schedule_vars.next_position_valid && asn >= position.asn && asn - position.asn < n_cells) {
+        // close to the next tick (the common case, with a distance of 0): 32-bit arithmetic only
+        uint32_t distance       = asn - position.asn;
+        position.asn            = asn;
+        position.cell_index     = position.cell_index + distance >= n_cells ? position.cell_index + distance - n_cells : position.cell_index + distance;
+        position.channel        = (position.channel + distance) % MARI_N_BLE_REGULAR_CHANNELS;
+        position.beacon_channel = (position.beacon_channel + distance) % MARI_N_BLE_ADVERTISING_CHANNELS;
+    } else {
+        position.asn            = asn;
+        position.cell_index     = asn % n_cells;
+        position.channel        = asn % MARI_N_BLE_REGULAR_CHANNELS;
+        position.beacon_channel = asn % MARI_N_BLE_ADVERTISING_CHANNELS;
+    }
+    return position;
+}
+
+uint8_t _get_channel(const mr_slot_position_t *position, const mr_slot_entry_t *slot) {
+#if (MARI_FIXED_CHANNEL != 0)
+    (void)position;
+    (void)slot;
+    return MARI_FIXED_CHANNEL;
+#endif
+    if (slot->type == SLOT_TYPE_BEACON) {
+#if (MARI_FIXED_SCAN_CHANNEL != 0)
+        return MARI_FIXED_SCAN_CHANNEL;
+#else
+        return MARI_N_BLE_REGULAR_CHANNELS + position->beacon_channel;
+#endif
     }
+    // same as mr_scheduler_get_channel, both terms being smaller than MARI_N_BLE_REGULAR_CHANNELS
+    uint8_t channel = position->channel + slot->channel_offset;
+    channel         = channel >= MARI_N_BLE_REGULAR_CHANNELS ? channel - MARI_N_BLE_REGULAR_CHANNELS : channel;
+    return _schedule_vars.unused_channels >> channel & 1 ? _schedule_vars.channel_remap[channel] : channel;
 }
@@ -21,6 +21,110 @@
 
 //=========================== defines ==========================================
 
+// account for:
+// - the 4 schedules supporting up to 10, 44, 66 and 102 nodes
+// - the schedule that can be passed by the application during initialization
+#define MARI_N_SCHEDULES 4 + 1
+
+#ifndef MARI_AUTO_SCHEDULE
+#define MARI_AUTO_SCHEDULE 1  // whether the gateway switches to the shortest available schedule that fits its nodes
+#endif
+
+// the gateway moves to a bigger schedule when fewer uplink cells are free, and to a shorter one only if it leaves
+// MARI_AUTO_SCHEDULE_TARGET_FREE cells free for MARI_AUTO_SCHEDULE_DOWN_SLOTFRAMES slotframes in a row
+#define MARI_AUTO_SCHEDULE_MIN_FREE          (1)
+#define MARI_AUTO_SCHEDULE_TARGET_FREE       (2)
+#define MARI_AUTO_SCHEDULE_DOWN_SLOTFRAMES   (32)
+#define MARI_SCHEDULE_SWITCH_LEAD_SLOTFRAMES (4)  // slotframes during which the beacons announce a switch before it happens
+
+#ifndef MARI_CHANNEL_BLACKLISTING
+#define MARI_CHANNEL_BLACKLISTING 1  // whether the gateway stops hopping over the data channels on which its uplink cells fail
+#endif
+
+// the gateway evaluates its data channels once it has MARI_CHANNEL_MAP_SAMPLES uplink cells per used channel, and
+// blacklists those failing at least MARI_CHANNEL_BAD_PERCENT % of the time and twice as often as all of them together,
+// for MARI_CHANNEL_BLACKLIST_EVALUATIONS evaluations, keeping at least MARI_CHANNEL_MAP_MIN_USED channels
+#define MARI_CHANNEL_MAP_SAMPLES           (16)
+#define MARI_CHANNEL_BAD_PERCENT           (50)
+#define MARI_CHANNEL_BLACKLIST_EVALUATIONS (8)
+#define MARI_CHANNEL_MAP_MIN_USED          (8)
+
+// index of the nodes assigned to the cells, see mr_scheduler_gateway_get_node_cell
+#define MARI_NODE_INDEX_BITS 8
+#define MARI_NODE_INDEX_SIZE (1 << MARI_NODE_INDEX_BITS)  // at least twice MARI_N_CELLS_MAX, to keep the probe sequences short
+
+// a cell of the active schedule, as seen by this device
+typedef struct {
+    slot_type_t       type;
+    uint8_t           channel_offset;  // modulo MARI_N_BLE_REGULAR_CHANNELS
+    mr_radio_action_t radio_action;
+    uint8_t           uplink_index;    // position among the uplink cells, where the beacons tell which node has the cell, kept across schedule switches
+    uint8_t           max_frame_len;   // from the max_frame_len of the schedule, or the default for the slot type
+    uint16_t          duration_us;     // MARI_SLOT_DURATION(max_frame_len), or MARI_ACK_SLOT_DURATION for the uplink and downlink cells
+} mr_slot_entry_t;
+
+// where an ASN falls in the active schedule and in the channel hopping sequences
+typedef struct {
+    uint64_t asn;
+    uint16_t cell_index;      // asn % n_cells
+    uint8_t  channel;         // asn % MARI_N_BLE_REGULAR_CHANNELS
+    uint8_t  beacon_channel;  // asn % MARI_N_BLE_ADVERTISING_CHANNELS
+} mr_slot_position_t;
+
+typedef struct {
+    // counters and indexes
+    const schedule_t *active_schedule_ptr;  // pointer to the currently active schedule
+    uint32_t          slotframe_counter;    // used to cycle beacon channels through slotframes (when listening for beacons at uplink slot_durations)
+
+    uint8_t num_assigned_uplink_nodes;  // number of nodes with assigned uplink slots
+
+    size_t current_cell_index;  // index of the current cell
+
+    mr_cell_assignment_t assignments[MARI_N_CELLS_MAX];     // nodes assigned to the cells of the active schedule
+    uint8_t              node_index[MARI_NODE_INDEX_SIZE];  // gateway only: open addressing table of cell_index + 1, keyed by the assigned node id, 0 when empty
+    uint8_t              node_cell;                         // node only: cell_index + 1 of the cell assigned to this node, 0 when none
+
+    // schedule switch announced by the gateway, applied by the gateway and its nodes at the same ASN
+    const schedule_t *pending_schedule_ptr;     // NULL when no switch is pending
+    uint64_t          switch_asn;               // a multiple of the number of cells of the pending schedule, so that it starts with its first cell
+    uint16_t          sparse_slotframes;        // gateway only: slotframes in a row during which a shorter schedule would fit
+
+    // data channels left out of the hopping sequence, announced by the gateway and applied by its nodes at the same ASN
+    uint64_t unused_channels;                                      // bit set for each blacklisted data channel, none by default
+    uint8_t  channel_remap[MARI_N_BLE_REGULAR_CHANNELS];           // used channel taking the place of each unused one
+    uint64_t pending_unused_channels;
+    uint64_t channel_map_asn;                                      // ASN from which pending_unused_channels applies
+    bool     channel_map_pending;
+    uint8_t  channel_blacklist_left[MARI_N_BLE_REGULAR_CHANNELS];  // gateway only: evaluations before each unused channel is tried again
+
+    // precomputed from the active schedule, so that a tick needs no division
+    mr_slot_entry_t    slots[MARI_N_CELLS_MAX];
+    uint8_t            uplink_cells[MARI_N_CELLS_MAX];  // cell index of each uplink index
+    uint32_t           slotframe_duration_us;  // sum of the durations of the cells
+    mr_slot_position_t next_position;          // position of the ASN expected at the next tick
+    bool               next_position_valid;
+
+    // static data
+    const schedule_t *available_schedules[MARI_N_SCHEDULES];
+    size_t            available_schedules_len;
+} mr_scheduler_vars_t;
+
+typedef struct {
+    uint64_t sched_usage[MARI_STATS_SCHED_USAGE_SIZE];
+    uint8_t  uplink_received[MARI_UPLINK_BITMAP_BYTES];           ///< Gateway only: uplink indexes whose frame was received in this slotframe
+    uint8_t  uplink_received_previous[MARI_UPLINK_BITMAP_BYTES];  ///< Same for the previous slotframe, as sent in the beacons
+    uint16_t channel_rx_ok[MARI_N_BLE_REGULAR_CHANNELS];       ///< Gateway only: uplink frames received on each data channel, since the last evaluation
+    uint16_t channel_crc_errors[MARI_N_BLE_REGULAR_CHANNELS];  ///< Same for frames received with an invalid CRC
+    uint16_t channel_missed[MARI_N_BLE_REGULAR_CHANNELS];      ///< Same for the uplink cells of a node where nothing was received
+    uint16_t channel_samples;                                  ///< Sum of the three above
+} mr_scheduler_stats_t;
+
+typedef enum {
+    MARI_RX_OK,
+    MARI_RX_CRC_ERROR,
+    MARI_RX_MISSED,
+} mr_rx_outcome_t;
+
 //=========================== prototypes ==========================================
 
 /**
@@ -30,11 +134,15 @@
  *
  * @param[in] schedule         Schedule to be used.
  */
-void mr_scheduler_init(schedule_t *application_schedule);
+void mr_scheduler_init(const schedule_t *application_schedule);
 
 /**
  * @brief Advances the schedule by one cell/slot.
  *
+ * Runs in constant time when called with consecutive ASNs. After a jump of
+ * the ASN (e.g. when a node synchronizes), the position in the schedule is
+ * computed again.
+ *
  * @return A configuration for the TSCH radio driver to follow in the next slot.
  */
 mr_slot_info_t mr_scheduler_tick(uint64_t asn);
@@ -50,32 +158,177 @@ mr_slot_info_t mr_scheduler_tick(uint64_t asn);
  */
 bool mr_scheduler_set_schedule(uint8_t schedule_id);
 
+/**
+ * @brief Duration of a slotframe of the active schedule, the sum of the durations of its cells.
+ */
 uint32_t mr_scheduler_get_duration_us(void);
 
+/**
+ * @brief Computes the duration of a given slot, which depends on the type of its cell.
+ *
+ * @param[in] asn               Absolute Slot Number
+ *
+ * @return Duration of the slot, in microseconds
+ */
+uint32_t mr_scheduler_get_slot_duration_us(uint64_t asn);
+
+/**
+ * @brief Longest frame sent in the cells of a given type of the active schedule.
+ *
+ * @param[in] slot_type         Type of the cells
+ *
+ * @return Length in bytes, from the schedule or the default for the type
+ */
+uint8_t mr_scheduler_get_max_frame_len(slot_type_t slot_type);
+
 int16_t mr_scheduler_gateway_assign_next_available_uplink_cell(uint64_t node_id, uint64_t asn);
 
-bool mr_scheduler_node_assign_myself_to_cell(uint16_t cell_index);
+/**
+ * @brief Assigns to this node the uplink cell given by the join response of the gateway.
+ *
+ * @param[in] uplink_index      Position of the cell among the uplink cells of the active schedule
+ */
+bool mr_scheduler_node_assign_myself_to_uplink(uint8_t uplink_index);
+
+/**
+ * @brief Follows a schedule switch announced in the beacons of the gateway.
+ *
+ * @param[in] schedule_id       Schedule to use from `switch_asn` on
+ * @param[in] switch_asn        ASN of the first slot of the new schedule
+ *
+ * @return false if the schedule is not available
+ */
+bool mr_scheduler_node_set_pending_switch(uint8_t schedule_id, uint64_t switch_asn);
 
 void mr_scheduler_node_deassign_myself_from_schedule(void);
 
+/**
+ * @brief Position of the cell assigned to this node among the uplink cells of the active schedule.
+ *
+ * @return The uplink index, -1 if the node has no cell
+ */
+int16_t mr_scheduler_node_get_uplink_index(void);
+
 void mr_scheduler_gateway_decrease_nodes_counter(void);
 
+/**
+ * @brief Finds the uplink cell assigned to a node, in constant time.
+ *
+ * @param[in] node_id           ID of the node
+ *
+ * @return Index of the cell in the active schedule, -1 if the node has no cell
+ */
+int16_t mr_scheduler_gateway_get_node_cell(uint64_t node_id);
+
+/**
+ * @brief Position of the cell of a node among the uplink cells, which stays the same when the schedule is switched.
+ *
+ * @return The uplink index, -1 if the node has no cell
+ */
+int16_t mr_scheduler_gateway_get_node_uplink_index(uint64_t node_id);
+
+/**
+ * @return ID of the node assigned to the cell at an uplink index, 0 if none
+ */
+uint64_t mr_scheduler_gateway_get_uplink_node(uint8_t uplink_index);
+
+/**
+ * @return Position of a cell of the active schedule among its uplink cells
+ */
+uint8_t mr_scheduler_get_uplink_index(size_t cell_index);
+
+/**
+ * @brief Frees an uplink cell, when its node left.
+ *
+ * @param[in] cell_index        Index of the cell in the active schedule
+ */
+void mr_scheduler_gateway_deassign_cell(size_t cell_index);
+
 uint8_t mr_scheduler_gateway_remaining_capacity(void);
 
 uint8_t mr_scheduler_gateway_get_nodes_count(void);
 
 uint8_t mr_scheduler_gateway_get_nodes(uint64_t *nodes);
 
-schedule_t *mr_scheduler_get_active_schedule_ptr(void);
+const schedule_t *mr_scheduler_get_active_schedule_ptr(void);
 
 uint8_t mr_scheduler_get_active_schedule_slot_count(void);
 
-cell_t mr_scheduler_node_peek_slot(uint64_t asn);
+/**
+ * @brief Schedule switch announced in the beacons.
+ *
+ * @param[in]  asn              ASN carried by the beacon
+ * @param[out] schedule_id      Schedule used after the switch, or the active one
+ *
+ * @return Slots from `asn` to the switch, 0 when no switch is pending
+ */
+uint16_t mr_scheduler_get_pending_switch(uint64_t asn, uint8_t *schedule_id);
+
+/**
+ * @brief Gives access to the node assigned to a cell of the active schedule.
+ *
+ * @param[in] cell_index        Index of the cell in the active schedule
+ *
+ * @return The assignment of the cell, its node ID is 0 when the cell is free
+ */
+mr_cell_assignment_t *mr_scheduler_get_cell_assignment(size_t cell_index);
+
+/**
+ * @brief Computes what the node will do at a given slot, without advancing the schedule.
+ */
+mr_slot_info_t mr_scheduler_node_peek_slot(uint64_t asn);
 
 void mr_scheduler_stats_register_used_slot(bool used);
 
 uint64_t *mr_scheduler_get_schedule_usage(void);
 
+/**
+ * @brief Gateway only: records that the node of the current uplink cell was received, if it sent the frame.
+ *
+ * @param[in] src               Source of the received frame
+ */
+void mr_scheduler_stats_register_uplink_received(uint64_t src);
+
+/**
+ * @brief Gateway only: gets the uplink indexes whose frame was received in the previous slotframe, for the beacons.
+ *
+ * @return Bitmap of MARI_UPLINK_BITMAP_BYTES bytes, indexed by uplink index
+ */
+const uint8_t *mr_scheduler_get_uplink_received(void);
+
+/**
+ * @brief Gateway only: records how the rx of the current cell went, on the data channel it used.
+ *
+ * Only the uplink cells assigned to a node count, where a frame is always expected.
+ *
+ * @param[in] channel           Channel of the cell
+ * @param[in] outcome           Whether a frame was received, with a valid CRC or not
+ */
+void mr_scheduler_stats_register_rx(uint8_t channel, mr_rx_outcome_t outcome);
+
+/**
+ * @brief Data channels used by the hopping sequence, as announced in the beacons.
+ *
+ * @param[in]  asn              ASN carried by the beacon
+ * @param[out] channel_map      MARI_CHANNEL_MAP_BYTES bytes, bit set for each used channel, the pending map if any
+ *
+ * @return Slots from `asn` to the change of map, 0 when no change is pending
+ */
+uint16_t mr_scheduler_get_pending_channel_map(uint64_t asn, uint8_t *channel_map);
+
+/**
+ * @brief Follows the channel map announced in the beacons of the gateway.
+ *
+ * @param[in] channel_map       MARI_CHANNEL_MAP_BYTES bytes, bit set for each used channel
+ * @param[in] map_asn           ASN from which the map applies
+ */
+void mr_scheduler_node_set_channel_map(const uint8_t *channel_map, uint64_t map_asn);
+
+/**
+ * @return Bit set for each data channel used by the hopping sequence
+ */
+uint64_t mr_scheduler_get_channel_map(void);
+
 /**
  * @brief Computes the channel to be used in a given slot.
  *